@@ -23,13 +23,14 @@
 // Bios.cpp
 // ----------------------------------------------------------------------------
 #include "Bios.h"
+#include "Profile.h"
 #define BIOS_SOURCE "Bios.cpp"
 
-bool bios_enabled = false;
-std::string bios_filename;
+CONTEXT_LOCAL bool bios_enabled = false;
+CONTEXT_LOCAL std::string bios_filename;
 
-static byte* bios_data = NULL;
-static word bios_size = 0;
+static CONTEXT_LOCAL byte* bios_data = NULL;
+static CONTEXT_LOCAL word bios_size = 0;
 
 // ----------------------------------------------------------------------------
 // Load
@@ -109,5 +110,8 @@ void bios_Release( ) {
 void bios_Store( ) {
   if(bios_data != NULL && bios_enabled) {
     memory_WriteROM(65536 - bios_size, bios_size, bios_data);
+#ifdef PROSYSTEM_PROFILE
+    profile_bios = true;
+#endif
   }
 }
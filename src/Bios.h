@@ -26,6 +26,7 @@
 #define BIOS_H
 
 #include <string>
+#include "EmulatorContext.h"
 #include "Memory.h"
 #include "Archive.h"
 #include "Logger.h"
@@ -38,7 +39,7 @@ extern bool bios_Load(std::string filename);
 extern bool bios_IsLoaded( );
 extern void bios_Store( );
 extern void bios_Release( );
-extern std::string bios_filename;
-extern bool bios_enabled;
+extern CONTEXT_LOCAL std::string bios_filename;
+extern CONTEXT_LOCAL bool bios_enabled;
 
 #endif
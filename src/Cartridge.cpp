@@ -23,10 +23,14 @@
 // Cartridge.cpp
 // ----------------------------------------------------------------------------
 #include "Cartridge.h"
+#include "Profile.h"
 #include "Region.h"
+#include "Stats.h"
+#ifdef WII
 #include "wii_app_common.h"
 #include "wii_atari.h"
 #include "wii_app.h"
+#endif
 
 #ifdef WII_NETTRACE
 #include <network.h>
@@ -36,38 +40,40 @@
 #include <string.h>
 #define CARTRIDGE_SOURCE "Cartridge.cpp"
 
-std::string cartridge_title;
-std::string cartridge_description;
-std::string cartridge_year;
-std::string cartridge_maker;
-std::string cartridge_digest;
-std::string cartridge_filename;
-byte cartridge_type;
-byte cartridge_region;
-bool cartridge_pokey;
-bool cartridge_pokey450;
-byte cartridge_controller[2] = {1, 1};
-byte cartridge_bank;
-uint cartridge_flags;
-int cartridge_crosshair_x;
-int cartridge_crosshair_y;
-bool cartridge_dualanalog = false;
-bool cartridge_xm = false;
-bool cartridge_disable_bios = false;
-uint cartridge_hblank = 34;
-byte cartridge_left_switch = 1;
-byte cartridge_right_switch = 0;
-bool cartridge_swap_buttons = false;
-bool cartridge_hsc_enabled = false;
+CONTEXT_LOCAL std::string cartridge_title;
+CONTEXT_LOCAL std::string cartridge_description;
+CONTEXT_LOCAL std::string cartridge_year;
+CONTEXT_LOCAL std::string cartridge_maker;
+CONTEXT_LOCAL std::string cartridge_digest;
+CONTEXT_LOCAL std::string cartridge_filename;
+CONTEXT_LOCAL byte cartridge_type;
+CONTEXT_LOCAL byte cartridge_region;
+CONTEXT_LOCAL bool cartridge_pokey;
+CONTEXT_LOCAL bool cartridge_pokey450;
+CONTEXT_LOCAL byte cartridge_controller[2] = {1, 1};
+CONTEXT_LOCAL byte cartridge_bank;
+// Whether a bank has been stored since the cartridge was last stored
+CONTEXT_LOCAL bool cartridge_banked = false;
+CONTEXT_LOCAL uint cartridge_flags;
+CONTEXT_LOCAL int cartridge_crosshair_x;
+CONTEXT_LOCAL int cartridge_crosshair_y;
+CONTEXT_LOCAL bool cartridge_dualanalog = false;
+CONTEXT_LOCAL bool cartridge_xm = false;
+CONTEXT_LOCAL bool cartridge_disable_bios = false;
+CONTEXT_LOCAL uint cartridge_hblank = 34;
+CONTEXT_LOCAL byte cartridge_left_switch = 1;
+CONTEXT_LOCAL byte cartridge_right_switch = 0;
+CONTEXT_LOCAL bool cartridge_swap_buttons = false;
+CONTEXT_LOCAL bool cartridge_hsc_enabled = false;
 
 // Whether the cartridge has accessed the high score ROM (indicates that the
 // SRAM should be persisted when the cartridge is unloaded)
-bool high_score_set = false;
+CONTEXT_LOCAL bool high_score_set = false;
 // Whether the high score cart has been loaded
-static bool high_score_cart_loaded = false;
+static CONTEXT_LOCAL bool high_score_cart_loaded = false;
 
-static byte* cartridge_buffer = NULL;
-static uint cartridge_size = 0;
+static CONTEXT_LOCAL byte* cartridge_buffer = NULL;
+static CONTEXT_LOCAL uint cartridge_size = 0;
 
 // ----------------------------------------------------------------------------
 // HasHeader
@@ -129,6 +135,7 @@ static void cartridge_WriteBank(word address, byte bank) {
   if(offset < cartridge_size) {
     memory_WriteROM(address, 16384, cartridge_buffer + offset);
     cartridge_bank = bank;
+    cartridge_banked = true;
   }
 }
 
@@ -473,6 +480,31 @@ bool cartridge_Load_buffer(char* rom_buffer, int rom_size) {
 // The size of the high score cartridge SRAM
 #define HS_SRAM_SIZE 2048
 
+#ifdef WII
+#define HS_CART_FILE WII_HIGH_SCORE_CART
+#define HS_SRAM_FILE WII_HIGH_SCORE_CART_SRAM
+#else
+#define HS_CART_FILE "highscore.rom"
+#define HS_SRAM_FILE "highscore.sram"
+#endif
+
+/*
+ * Returns the full path to the specified high score cartridge file
+ *
+ * name     The name of the file
+ * return   The full path to the file
+ */
+static std::string cartridge_GetHighScorePath(const char* name)
+{
+#ifdef WII
+    char path[WII_MAX_PATH] = "";
+    snprintf(path, WII_MAX_PATH, "%s%s", wii_get_fs_prefix(), name);
+    return std::string(path);
+#else
+    return std::string("./") + name;
+#endif
+}
+
 /*
  * Saves the high score cartridge SRAM
  *
@@ -487,10 +519,7 @@ bool cartridge_SaveHighScoreSram()
         return false;
     }
 
-    char sram_file[WII_MAX_PATH] = "";
-    snprintf(sram_file, WII_MAX_PATH, "%s%s", wii_get_fs_prefix(),
-             WII_HIGH_SCORE_CART_SRAM);
-    std::string filename(sram_file);
+    std::string filename = cartridge_GetHighScorePath(HS_SRAM_FILE);
     FILE* file = fopen(filename.c_str(), "wb");
     if( file == NULL ) 
     {
@@ -518,10 +547,7 @@ bool cartridge_SaveHighScoreSram()
  */
 static bool cartridge_LoadHighScoreSram() 
 {    
-    char sram_file[WII_MAX_PATH] = "";
-    snprintf(sram_file, WII_MAX_PATH, "%s%s", wii_get_fs_prefix(),
-             WII_HIGH_SCORE_CART_SRAM);
-    std::string filename( sram_file );
+    std::string filename = cartridge_GetHighScorePath(HS_SRAM_FILE);
     FILE* file = fopen( filename.c_str(), "rb" );
     if( file == NULL ) 
     {
@@ -560,9 +586,7 @@ bool cartridge_LoadHighScoreCart() {
     }
 
     byte* high_score_buffer = NULL;
-    char high_score_cart[WII_MAX_PATH] = "";
-    snprintf(high_score_cart, WII_MAX_PATH, "%s%s", wii_get_fs_prefix(),
-             WII_HIGH_SCORE_CART);
+    std::string high_score_cart = cartridge_GetHighScorePath(HS_CART_FILE);
 
     uint hsSize = cartridge_Read( high_score_cart, &high_score_buffer );
     if( high_score_buffer != NULL )
@@ -599,13 +623,17 @@ bool cartridge_LoadHighScoreCart() {
 // Store
 // ----------------------------------------------------------------------------
 void cartridge_Store( ) {
+#ifdef PROSYSTEM_PROFILE
+  profile_bios = false;
+#endif
+  cartridge_banked = false;
   switch(cartridge_type) {
     case CARTRIDGE_TYPE_NORMAL:
       memory_WriteROM(65536 - cartridge_size, cartridge_size, cartridge_buffer);
       break;
     case CARTRIDGE_TYPE_NORMAL_RAM:
       memory_WriteROM(65536 - cartridge_size, cartridge_size, cartridge_buffer);
-      memory_ClearROM(16384, 16384);      
+      memory_ClearROM(16384, cartridge_GetRAMSize( ));      
       break;
     case CARTRIDGE_TYPE_SUPERCART: {
       uint offset = cartridge_size - 16384;
@@ -624,7 +652,7 @@ void cartridge_Store( ) {
       uint offset = cartridge_size - 16384;
       if(offset < cartridge_size) {
         memory_WriteROM(49152, 16384, cartridge_buffer + offset);
-        memory_ClearROM(16384, 16384);
+        memory_ClearROM(16384, cartridge_GetRAMSize( ));
       }
     } break;
     case CARTRIDGE_TYPE_SUPERCART_ROM: {
@@ -726,6 +754,7 @@ void cartridge_Write(word address, byte data) {
 // StoreBank
 // ----------------------------------------------------------------------------
 void cartridge_StoreBank(byte bank) {
+  STATS_ADD(bank_switches, 1);
   switch(cartridge_type) {
     case CARTRIDGE_TYPE_SUPERCART:
       cartridge_WriteBank(32768, bank);
@@ -748,6 +777,41 @@ void cartridge_StoreBank(byte bank) {
   }  
 }
 
+// ----------------------------------------------------------------------------
+// ClearBank
+// Restores the bank window to its state before the first bank is stored:
+// empty (reading 0) on a SuperCart, the first bank otherwise.
+// ----------------------------------------------------------------------------
+void cartridge_ClearBank( ) {
+  switch(cartridge_type) {
+    case CARTRIDGE_TYPE_SUPERCART:
+    case CARTRIDGE_TYPE_SUPERCART_RAM:
+    case CARTRIDGE_TYPE_SUPERCART_ROM:
+    case CARTRIDGE_TYPE_SUPERCART_LARGE: {
+      static const byte empty[16384] = {0};
+      memory_WriteROM(32768, 16384, empty);
+      cartridge_bank = 0;
+    } break;
+    default:
+      cartridge_StoreBank(0);
+      break;
+  }
+  cartridge_banked = false;
+}
+
+// ----------------------------------------------------------------------------
+// GetRAMSize
+// Returns the size of the RAM the cartridge maps at $4000 (0 if none).
+// ----------------------------------------------------------------------------
+uint cartridge_GetRAMSize( ) {
+  switch(cartridge_type) {
+    case CARTRIDGE_TYPE_NORMAL_RAM:
+    case CARTRIDGE_TYPE_SUPERCART_RAM:
+      return 16384;
+  }
+  return 0;
+}
+
 // ----------------------------------------------------------------------------
 // IsLoaded
 // ----------------------------------------------------------------------------
@@ -781,6 +845,7 @@ void cartridge_Release( ) {
     // Default to joysticks
     memset( cartridge_controller, 1, sizeof( cartridge_controller ) );
     cartridge_bank = 0;
+    cartridge_banked = false;
     cartridge_flags = 0;
     cartridge_disable_bios = false;
     cartridge_crosshair_x = 0;
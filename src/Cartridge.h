@@ -39,6 +39,7 @@
 #define CARTRIDGE_CYCLE_STEALING_MASK 1
 
 #include <stdio.h>
+#include "EmulatorContext.h"
 #include <string>
 #include "Equates.h"
 #include "Memory.h"
@@ -57,38 +58,41 @@ extern bool cartridge_Load(std::string filename);
 extern bool cartridge_Load_buffer(char* rom_buffer, int rom_size);
 extern void cartridge_Store( );
 extern void cartridge_StoreBank(byte bank);
+extern void cartridge_ClearBank( );
+extern uint cartridge_GetRAMSize( );
 extern void cartridge_Write(word address, byte data);
 extern bool cartridge_IsLoaded( );
 extern void cartridge_Release( );
-extern std::string cartridge_digest;
-extern std::string cartridge_title;
-extern std::string cartridge_description;
-extern std::string cartridge_year;
-extern std::string cartridge_maker;
-extern std::string cartridge_filename;
-extern byte cartridge_type;
-extern byte cartridge_region;
-extern bool cartridge_pokey;
-extern bool cartridge_pokey450;
-extern bool cartridge_xm;
-extern byte cartridge_controller[2];
-extern byte cartridge_bank;
-extern uint cartridge_flags;
-extern bool cartridge_disable_bios;
-extern byte cartridge_left_switch;
-extern byte cartridge_right_switch;
-extern bool cartridge_swap_buttons;
+extern CONTEXT_LOCAL std::string cartridge_digest;
+extern CONTEXT_LOCAL std::string cartridge_title;
+extern CONTEXT_LOCAL std::string cartridge_description;
+extern CONTEXT_LOCAL std::string cartridge_year;
+extern CONTEXT_LOCAL std::string cartridge_maker;
+extern CONTEXT_LOCAL std::string cartridge_filename;
+extern CONTEXT_LOCAL byte cartridge_type;
+extern CONTEXT_LOCAL byte cartridge_region;
+extern CONTEXT_LOCAL bool cartridge_pokey;
+extern CONTEXT_LOCAL bool cartridge_pokey450;
+extern CONTEXT_LOCAL bool cartridge_xm;
+extern CONTEXT_LOCAL byte cartridge_controller[2];
+extern CONTEXT_LOCAL byte cartridge_bank;
+extern CONTEXT_LOCAL bool cartridge_banked;
+extern CONTEXT_LOCAL uint cartridge_flags;
+extern CONTEXT_LOCAL bool cartridge_disable_bios;
+extern CONTEXT_LOCAL byte cartridge_left_switch;
+extern CONTEXT_LOCAL byte cartridge_right_switch;
+extern CONTEXT_LOCAL bool cartridge_swap_buttons;
 
 // The x offset for the lightgun crosshair (allows per cartridge adjustments)
-extern int cartridge_crosshair_x;
+extern CONTEXT_LOCAL int cartridge_crosshair_x;
 // The y offset for the lightgun crosshair (allows per cartridge adjustments)
-extern int cartridge_crosshair_y;
+extern CONTEXT_LOCAL int cartridge_crosshair_y;
 // The hblank prior to DMA
-extern uint cartridge_hblank;
+extern CONTEXT_LOCAL uint cartridge_hblank;
 // Whether the cartridge supports dual analog
-extern bool cartridge_dualanalog;
+extern CONTEXT_LOCAL bool cartridge_dualanalog;
 // Whether the high score cart is enabled
-extern bool cartridge_hsc_enabled;
+extern CONTEXT_LOCAL bool cartridge_hsc_enabled;
 
 /*
  * Loads the high score cartridge
@@ -106,6 +110,6 @@ bool cartridge_SaveHighScoreSram();
 
 // Whether the cartridge has accessed the high score ROM (indicates that the
 // SRAM should be persisted when the cartridge is unloaded)
-extern bool high_score_set;
+extern CONTEXT_LOCAL bool high_score_set;
 
 #endif
@@ -24,6 +24,7 @@
 // ----------------------------------------------------------------------------
 #include "Database.h"
 #include "Common.h"
+#include <string.h>
 
 #ifdef WII
 #include "wii_main.h"
@@ -38,7 +39,7 @@
 
 #define DATABASE_SOURCE "Database.cpp"
 
-bool cart_in_db = false;
+CONTEXT_LOCAL bool cart_in_db = false;
 bool database_enabled = true;
 std::string database_filename = "./prosystem.dat";
 
@@ -51,6 +52,81 @@ static std::string database_GetValue(std::string entry) {
 char database_loc[WII_MAX_PATH] = "";
 #endif
 
+// The contents of the database when it has been initialized (shared, read-only
+// once loaded)
+static char* database_data = NULL;
+static uint database_size = 0;
+
+static FILE* database_Open( ) {
+#ifndef WII
+  return fopen(database_filename.c_str( ), "r");
+#else
+  if(database_loc[0] == '\0') {
+    snprintf(database_loc, WII_MAX_PATH, "%s%s", wii_get_fs_prefix( ),
+             WII_PROSYSTEM_DB);
+  }
+  return fopen(database_loc, "r");
+#endif
+}
+
+// Reads the next line from the file, or from the in-memory database when the
+// file is NULL (same semantics as fgets)
+static char* database_ReadLine(char* buffer, int size, FILE* file, uint* offset) {
+  if(file != NULL) {
+    return fgets(buffer, size, file);
+  }
+  if(*offset >= database_size) {
+    return NULL;
+  }
+  int length = 0;
+  while(*offset < database_size && length < size - 1) {
+    char ch = database_data[(*offset)++];
+    buffer[length++] = ch;
+    if(ch == '\n') {
+      break;
+    }
+  }
+  buffer[length] = '\0';
+  return buffer;
+}
+
+// ----------------------------------------------------------------------------
+// Initialize
+// Reads the database into memory so that subsequent loads (from any thread)
+// do not re-read the file.
+// ----------------------------------------------------------------------------
+void database_Initialize( ) {
+  database_Release( );
+  if(!database_enabled) {
+    return;
+  }
+
+  FILE* file = database_Open( );
+  if(file == NULL) {
+    return;
+  }
+
+  if(fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if(size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+      database_data = new char[size];
+      database_size = fread(database_data, 1, size, file);
+    }
+  }
+  fclose(file);
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void database_Release( ) {
+  if(database_data != NULL) {
+    delete [ ] database_data;
+    database_data = NULL;
+    database_size = 0;
+  }
+}
+
 // ----------------------------------------------------------------------------
 // Load
 // ----------------------------------------------------------------------------
@@ -63,17 +139,14 @@ bool database_Load(std::string digest) {
         digest.c_str());
 #endif
 
-#ifndef WII
-      FILE* file = fopen(database_filename.c_str(), "r");
-#else
-      if (database_loc[0] == '\0') {
-          snprintf(database_loc, WII_MAX_PATH, "%s%s", wii_get_fs_prefix(),
-                   WII_PROSYSTEM_DB);
-      }
-      FILE* file = fopen(database_loc, "r");
-#endif
-      if (file == NULL) {
-          return false;
+      // Use the in-memory copy when the database has been initialized
+      FILE* file = NULL;
+      uint offset = 0;
+      if (database_data == NULL) {
+          file = database_Open();
+          if (file == NULL) {
+              return false;
+          }
       }
 
       // max count of items in the database
@@ -81,7 +154,7 @@ bool database_Load(std::string digest) {
 
       bool found = false;
       char buffer[256];
-      while (fgets(buffer, 256, file) != NULL) {
+      while (database_ReadLine(buffer, 256, file, &offset) != NULL) {
           std::string line = buffer;
           if (line.compare(1, 32, digest.c_str()) == 0) {
               found = true;
@@ -89,7 +162,7 @@ bool database_Load(std::string digest) {
               std::string entry[count];
               for (int index = 0; index < count; index++) {
                   buffer[0] = '\0';
-                  fgets(buffer, 256, file);
+                  database_ReadLine(buffer, 256, file, &offset);
                   if (strchr(buffer, '[')) {
                       // Passed the current game in DB
                       break;
@@ -165,11 +238,15 @@ bool database_Load(std::string digest) {
           }
       }
 
+#ifdef WII
       if (wii_debug && !found) {
           fprintf(stderr, "unable to locate cartridge in database.\n");
       }
+#endif
 
-      fclose(file);  
+      if (file != NULL) {
+          fclose(file);
+      }
   }
   return true;
 }
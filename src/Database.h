@@ -25,6 +25,7 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include "EmulatorContext.h"
 #include "Cartridge.h"
 
 typedef unsigned char byte;
@@ -32,9 +33,10 @@ typedef unsigned short word;
 typedef unsigned int uint;
 
 extern void database_Initialize( );
+extern void database_Release( );
 extern bool database_Load(std::string digest);
 extern bool database_enabled;
 extern std::string database_filename;
-extern bool cart_in_db;
+extern CONTEXT_LOCAL bool cart_in_db;
 
 #endif
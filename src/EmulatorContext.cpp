@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// EmulatorContext.cpp
+// ----------------------------------------------------------------------------
+#include "EmulatorContext.h"
+#include "ProSystem.h"
+#include "Database.h"
+
+#define CONTEXT_SOURCE "EmulatorContext.cpp"
+
+static CONTEXT_LOCAL EmulatorContext* context_current = NULL;
+
+// ----------------------------------------------------------------------------
+// IsCurrent
+// ----------------------------------------------------------------------------
+static bool context_IsCurrent(const EmulatorContext* context) {
+  if(context == NULL || context != context_current) {
+    logger_LogError("The emulator context does not belong to the current thread.", CONTEXT_SOURCE);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Create
+// ----------------------------------------------------------------------------
+EmulatorContext* context_Create( ) {
+  if(context_current != NULL) {
+    logger_LogError("An emulator context already exists for the current thread.", CONTEXT_SOURCE);
+    return NULL;
+  }
+  context_current = new EmulatorContext( );
+  context_current->frames = 0;
+  return context_current;
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void context_Release(EmulatorContext* context) {
+  if(!context_IsCurrent(context)) {
+    return;
+  }
+  prosystem_Close( );
+  bios_Release( );
+  delete context_current;
+  context_current = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Load
+// ----------------------------------------------------------------------------
+bool context_Load(EmulatorContext* context, std::string filename) {
+  if(!context_IsCurrent(context)) {
+    return false;
+  }
+  if(!cartridge_Load(filename)) {
+    return false;
+  }
+  database_Load(cartridge_digest);
+  return context_Reset(context);
+}
+
+// ----------------------------------------------------------------------------
+// Reset
+// ----------------------------------------------------------------------------
+bool context_Reset(EmulatorContext* context) {
+  if(!context_IsCurrent(context)) {
+    return false;
+  }
+  prosystem_Reset( );
+  context->frames = 0;
+  return prosystem_active;
+}
+
+// ----------------------------------------------------------------------------
+// ExecuteFrame
+// ----------------------------------------------------------------------------
+bool context_ExecuteFrame(EmulatorContext* context, const byte* input) {
+  if(!context_IsCurrent(context) || !prosystem_active) {
+    return false;
+  }
+  prosystem_ExecuteFrame(input);
+  context->frames++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// SkipFrame
+// ----------------------------------------------------------------------------
+bool context_SkipFrame(EmulatorContext* context, const byte* input) {
+  if(!context_IsCurrent(context) || !prosystem_active) {
+    return false;
+  }
+  prosystem_SkipFrame(input);
+  context->frames++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// RunAhead
+// ----------------------------------------------------------------------------
+bool context_RunAhead(EmulatorContext* context, const byte* input, uint frames) {
+  if(!context_IsCurrent(context) || !prosystem_active) {
+    return false;
+  }
+  return prosystem_RunAhead(input, frames);
+}
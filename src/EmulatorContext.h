@@ -0,0 +1,60 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// EmulatorContext.h
+// ----------------------------------------------------------------------------
+#ifndef EMULATOR_CONTEXT_H
+#define EMULATOR_CONTEXT_H
+
+#include <string>
+
+// Storage class of the machine state (Sally, memory, Maria, TIA, POKEY, RIOT,
+// XM and the cartridge). On the host every thread owns a private copy of the
+// machine, the Wii keeps the state in plain globals.
+#ifdef WII
+#define CONTEXT_LOCAL
+#else
+#define CONTEXT_LOCAL thread_local
+#endif
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+
+// ----------------------------------------------------------------------------
+// EmulatorContext
+// An emulated machine. A context is bound to the thread that created it and
+// only one context may exist per thread at a time: context_Create fails on a
+// thread that has one, and the other calls fail for a context of another
+// thread.
+// ----------------------------------------------------------------------------
+struct EmulatorContext {
+  uint frames;
+};
+
+extern EmulatorContext* context_Create( );
+extern void context_Release(EmulatorContext* context);
+extern bool context_Load(EmulatorContext* context, std::string filename);
+extern bool context_Reset(EmulatorContext* context);
+extern bool context_ExecuteFrame(EmulatorContext* context, const byte* input);
+extern bool context_SkipFrame(EmulatorContext* context, const byte* input);
+extern bool context_RunAhead(EmulatorContext* context, const byte* input, uint frames);
+
+#endif
@@ -39,11 +39,11 @@ if you wanted to. However since the PLD is soldered under the POKEY this needs t
 #include "net_print.h"
 #endif
 
-byte xm_ram[XM_RAM_SIZE] = {0};
-byte xm_reg = 0;
-byte xm_bank = 0;
-bool xm_pokey_enabled = false;
-bool xm_mem_enabled = false;
+CONTEXT_LOCAL byte xm_ram[XM_RAM_SIZE] = {0};
+CONTEXT_LOCAL byte xm_reg = 0;
+CONTEXT_LOCAL byte xm_bank = 0;
+CONTEXT_LOCAL bool xm_pokey_enabled = false;
+CONTEXT_LOCAL bool xm_mem_enabled = false;
 
 void xm_Reset() {
   memset(xm_ram, 0, XM_RAM_SIZE);
@@ -51,6 +51,7 @@ void xm_Reset() {
   xm_reg = 0;
   xm_mem_enabled = false;
   xm_pokey_enabled = false;
+  memory_Map();
 }
 
 byte xm_Read(word address) {
@@ -106,6 +107,7 @@ void xm_Write(word address, byte data) {
         xm_bank = xm_reg & 7;
         xm_pokey_enabled = (xm_reg & 0x10);
         xm_mem_enabled = (xm_reg & 0x08);
+        memory_Map();
 #ifdef WII_NETTRACE            
         net_print_string(NULL, 0, "xm_reg: %d, xm_bank: %d, xm_pokey_enabled: %d, xm_mem_enabled: %d\n", 
             xm_reg, xm_bank, xm_pokey_enabled, xm_mem_enabled);
@@ -1,16 +1,17 @@
 #ifndef EXPANSIONMODULE_H
 #define EXPANSIONMODULE_H
 
+#include "EmulatorContext.h"
 #include "Cartridge.h"
 #include "Memory.h"
 
 #define XM_RAM_SIZE 0x20000
 
-extern byte xm_ram[XM_RAM_SIZE];
-extern bool xm_pokey_enabled;
-extern bool xm_mem_enabled;
-extern byte xm_reg;
-extern byte xm_bank;
+extern CONTEXT_LOCAL byte xm_ram[XM_RAM_SIZE];
+extern CONTEXT_LOCAL bool xm_pokey_enabled;
+extern CONTEXT_LOCAL bool xm_mem_enabled;
+extern CONTEXT_LOCAL byte xm_reg;
+extern CONTEXT_LOCAL byte xm_bank;
 
 
 void xm_Reset();
@@ -24,7 +24,9 @@
 // ----------------------------------------------------------------------------
 #include "Hash.h"
 
+#ifdef WII
 #include "wii_atari.h"
+#endif
 #include <string.h>
 #include <stdio.h>
 
@@ -0,0 +1,1305 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Jit.cpp
+// ----------------------------------------------------------------------------
+#include "Jit.h"
+
+#ifdef PROSYSTEM_JIT
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "Cartridge.h"
+#include "Equates.h"
+#include "Logger.h"
+#include "ProSystem.h"
+#include "Riot.h"
+#include "Sally.h"
+#include "Stats.h"
+
+#define JIT_SOURCE "Jit.cpp"
+
+// The size of the buffer of translated code
+#define JIT_CODE_SIZE (8 * 1024 * 1024)
+// The count of blocks translated before the translations are discarded
+#define JIT_BLOCKS 32768
+// The maximum count of instructions in a block
+#define JIT_BLOCK_LENGTH 64
+// The space reserved for translating a block (the worst case)
+#define JIT_BLOCK_SPACE (JIT_BLOCK_LENGTH * 384)
+
+// ----------------------------------------------------------------------------
+// Opcodes
+// The operation and the addressing mode of each opcode. BRK, RTI, JMP
+// (indirect) and the illegal opcodes are left to the interpreter.
+// ----------------------------------------------------------------------------
+enum {
+  JIT_NONE, JIT_ADC, JIT_AND, JIT_ASL, JIT_BCC, JIT_BCS, JIT_BEQ, JIT_BIT,
+  JIT_BMI, JIT_BNE, JIT_BPL, JIT_BVC, JIT_BVS, JIT_CLC, JIT_CLD, JIT_CLI,
+  JIT_CLV, JIT_CMP, JIT_CPX, JIT_CPY, JIT_DEC, JIT_DEX, JIT_DEY, JIT_EOR,
+  JIT_INC, JIT_INX, JIT_INY, JIT_JMP, JIT_JSR, JIT_LDA, JIT_LDX, JIT_LDY,
+  JIT_LSR, JIT_NOP, JIT_ORA, JIT_PHA, JIT_PHP, JIT_PLA, JIT_PLP, JIT_ROL,
+  JIT_ROR, JIT_RTS, JIT_SBC, JIT_SEC, JIT_SED, JIT_SEI, JIT_STA, JIT_STX,
+  JIT_STY, JIT_TAX, JIT_TAY, JIT_TSX, JIT_TXA, JIT_TXS, JIT_TYA
+};
+
+enum {
+  JIT_IMP, JIT_IMM, JIT_ZPG, JIT_ZPX, JIT_ZPY, JIT_ABS, JIT_ABX, JIT_ABY,
+  JIT_IZX, JIT_IZY, JIT_REL
+};
+
+typedef struct {
+  byte operation;
+  byte mode;
+} jit_opcode;
+
+static const jit_opcode JIT_OPCODES[256] = {
+  {JIT_NONE, JIT_IMP}, {JIT_ORA, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x00
+  {JIT_NONE, JIT_IMP}, {JIT_ORA, JIT_ZPG}, {JIT_ASL, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0x04
+  {JIT_PHP, JIT_IMP}, {JIT_ORA, JIT_IMM}, {JIT_ASL, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x08
+  {JIT_NONE, JIT_IMP}, {JIT_ORA, JIT_ABS}, {JIT_ASL, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0x0c
+  {JIT_BPL, JIT_REL}, {JIT_ORA, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x10
+  {JIT_NONE, JIT_IMP}, {JIT_ORA, JIT_ZPX}, {JIT_ASL, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0x14
+  {JIT_CLC, JIT_IMP}, {JIT_ORA, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x18
+  {JIT_NONE, JIT_IMP}, {JIT_ORA, JIT_ABX}, {JIT_ASL, JIT_ABX}, {JIT_NONE, JIT_IMP}, // 0x1c
+  {JIT_JSR, JIT_ABS}, {JIT_AND, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x20
+  {JIT_BIT, JIT_ZPG}, {JIT_AND, JIT_ZPG}, {JIT_ROL, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0x24
+  {JIT_PLP, JIT_IMP}, {JIT_AND, JIT_IMM}, {JIT_ROL, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x28
+  {JIT_BIT, JIT_ABS}, {JIT_AND, JIT_ABS}, {JIT_ROL, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0x2c
+  {JIT_BMI, JIT_REL}, {JIT_AND, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x30
+  {JIT_NONE, JIT_IMP}, {JIT_AND, JIT_ZPX}, {JIT_ROL, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0x34
+  {JIT_SEC, JIT_IMP}, {JIT_AND, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x38
+  {JIT_NONE, JIT_IMP}, {JIT_AND, JIT_ABX}, {JIT_ROL, JIT_ABX}, {JIT_NONE, JIT_IMP}, // 0x3c
+  {JIT_NONE, JIT_IMP}, {JIT_EOR, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x40
+  {JIT_NONE, JIT_IMP}, {JIT_EOR, JIT_ZPG}, {JIT_LSR, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0x44
+  {JIT_PHA, JIT_IMP}, {JIT_EOR, JIT_IMM}, {JIT_LSR, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x48
+  {JIT_JMP, JIT_ABS}, {JIT_EOR, JIT_ABS}, {JIT_LSR, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0x4c
+  {JIT_BVC, JIT_REL}, {JIT_EOR, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x50
+  {JIT_NONE, JIT_IMP}, {JIT_EOR, JIT_ZPX}, {JIT_LSR, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0x54
+  {JIT_CLI, JIT_IMP}, {JIT_EOR, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x58
+  {JIT_NONE, JIT_IMP}, {JIT_EOR, JIT_ABX}, {JIT_LSR, JIT_ABX}, {JIT_NONE, JIT_IMP}, // 0x5c
+  {JIT_RTS, JIT_IMP}, {JIT_ADC, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x60
+  {JIT_NONE, JIT_IMP}, {JIT_ADC, JIT_ZPG}, {JIT_ROR, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0x64
+  {JIT_PLA, JIT_IMP}, {JIT_ADC, JIT_IMM}, {JIT_ROR, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x68
+  {JIT_NONE, JIT_IMP}, {JIT_ADC, JIT_ABS}, {JIT_ROR, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0x6c
+  {JIT_BVS, JIT_REL}, {JIT_ADC, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x70
+  {JIT_NONE, JIT_IMP}, {JIT_ADC, JIT_ZPX}, {JIT_ROR, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0x74
+  {JIT_SEI, JIT_IMP}, {JIT_ADC, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x78
+  {JIT_NONE, JIT_IMP}, {JIT_ADC, JIT_ABX}, {JIT_ROR, JIT_ABX}, {JIT_NONE, JIT_IMP}, // 0x7c
+  {JIT_NONE, JIT_IMP}, {JIT_STA, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x80
+  {JIT_STY, JIT_ZPG}, {JIT_STA, JIT_ZPG}, {JIT_STX, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0x84
+  {JIT_DEY, JIT_IMP}, {JIT_NONE, JIT_IMP}, {JIT_TXA, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x88
+  {JIT_STY, JIT_ABS}, {JIT_STA, JIT_ABS}, {JIT_STX, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0x8c
+  {JIT_BCC, JIT_REL}, {JIT_STA, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x90
+  {JIT_STY, JIT_ZPX}, {JIT_STA, JIT_ZPX}, {JIT_STX, JIT_ZPY}, {JIT_NONE, JIT_IMP}, // 0x94
+  {JIT_TYA, JIT_IMP}, {JIT_STA, JIT_ABY}, {JIT_TXS, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x98
+  {JIT_NONE, JIT_IMP}, {JIT_STA, JIT_ABX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0x9c
+  {JIT_LDY, JIT_IMM}, {JIT_LDA, JIT_IZX}, {JIT_LDX, JIT_IMM}, {JIT_NONE, JIT_IMP}, // 0xa0
+  {JIT_LDY, JIT_ZPG}, {JIT_LDA, JIT_ZPG}, {JIT_LDX, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0xa4
+  {JIT_TAY, JIT_IMP}, {JIT_LDA, JIT_IMM}, {JIT_TAX, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xa8
+  {JIT_LDY, JIT_ABS}, {JIT_LDA, JIT_ABS}, {JIT_LDX, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0xac
+  {JIT_BCS, JIT_REL}, {JIT_LDA, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xb0
+  {JIT_LDY, JIT_ZPX}, {JIT_LDA, JIT_ZPX}, {JIT_LDX, JIT_ZPY}, {JIT_NONE, JIT_IMP}, // 0xb4
+  {JIT_CLV, JIT_IMP}, {JIT_LDA, JIT_ABY}, {JIT_TSX, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xb8
+  {JIT_LDY, JIT_ABX}, {JIT_LDA, JIT_ABX}, {JIT_LDX, JIT_ABY}, {JIT_NONE, JIT_IMP}, // 0xbc
+  {JIT_CPY, JIT_IMM}, {JIT_CMP, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xc0
+  {JIT_CPY, JIT_ZPG}, {JIT_CMP, JIT_ZPG}, {JIT_DEC, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0xc4
+  {JIT_INY, JIT_IMP}, {JIT_CMP, JIT_IMM}, {JIT_DEX, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xc8
+  {JIT_CPY, JIT_ABS}, {JIT_CMP, JIT_ABS}, {JIT_DEC, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0xcc
+  {JIT_BNE, JIT_REL}, {JIT_CMP, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xd0
+  {JIT_NONE, JIT_IMP}, {JIT_CMP, JIT_ZPX}, {JIT_DEC, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0xd4
+  {JIT_CLD, JIT_IMP}, {JIT_CMP, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xd8
+  {JIT_NONE, JIT_IMP}, {JIT_CMP, JIT_ABX}, {JIT_DEC, JIT_ABX}, {JIT_NONE, JIT_IMP}, // 0xdc
+  {JIT_CPX, JIT_IMM}, {JIT_SBC, JIT_IZX}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xe0
+  {JIT_CPX, JIT_ZPG}, {JIT_SBC, JIT_ZPG}, {JIT_INC, JIT_ZPG}, {JIT_NONE, JIT_IMP}, // 0xe4
+  {JIT_INX, JIT_IMP}, {JIT_SBC, JIT_IMM}, {JIT_NOP, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xe8
+  {JIT_CPX, JIT_ABS}, {JIT_SBC, JIT_ABS}, {JIT_INC, JIT_ABS}, {JIT_NONE, JIT_IMP}, // 0xec
+  {JIT_BEQ, JIT_REL}, {JIT_SBC, JIT_IZY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xf0
+  {JIT_NONE, JIT_IMP}, {JIT_SBC, JIT_ZPX}, {JIT_INC, JIT_ZPX}, {JIT_NONE, JIT_IMP}, // 0xf4
+  {JIT_SED, JIT_IMP}, {JIT_SBC, JIT_ABY}, {JIT_NONE, JIT_IMP}, {JIT_NONE, JIT_IMP}, // 0xf8
+  {JIT_NONE, JIT_IMP}, {JIT_SBC, JIT_ABX}, {JIT_INC, JIT_ABX}, {JIT_NONE, JIT_IMP} // 0xfc
+};
+
+// ----------------------------------------------------------------------------
+// State
+// While the translated code runs, rbx points to the state, ebp holds P, r12d
+// holds A, r13 and r14 point to prosystem_event and prosystem_cycles and r15
+// points to memory_ram. X, Y, S and the PC are kept in the state.
+// ----------------------------------------------------------------------------
+typedef struct {
+  byte a;
+  byte x;
+  byte y;
+  byte p;
+  byte s;
+  word pc;
+  uint instructions;
+  byte* ram;
+  uint* cycles;
+  uint* event;
+  byte flags[256];
+} jit_state;
+
+#define JIT_A offsetof(jit_state, a)
+#define JIT_X offsetof(jit_state, x)
+#define JIT_Y offsetof(jit_state, y)
+#define JIT_P offsetof(jit_state, p)
+#define JIT_S offsetof(jit_state, s)
+#define JIT_PC offsetof(jit_state, pc)
+#define JIT_INSTRUCTIONS offsetof(jit_state, instructions)
+#define JIT_RAM offsetof(jit_state, ram)
+#define JIT_CYCLES offsetof(jit_state, cycles)
+#define JIT_EVENT offsetof(jit_state, event)
+#define JIT_FLAGS offsetof(jit_state, flags)
+
+// The flags of P
+#define JIT_FLAG_C 0x01
+#define JIT_FLAG_Z 0x02
+#define JIT_FLAG_D 0x08
+#define JIT_FLAG_V 0x40
+#define JIT_FLAG_N 0x80
+
+// A translated block, its code is NULL when its first instruction is left
+// to the interpreter
+typedef struct {
+  uint generation;
+  const byte* code;
+} jit_block;
+
+typedef struct {
+  word pc;
+  byte* code;
+} jit_label;
+
+typedef struct {
+  word pc;
+  bool exit;
+  byte* patch;
+} jit_fixup;
+
+typedef void (*jit_entry)(jit_state* state, const byte* code);
+
+// The profiler instruments the interpreter
+#ifdef PROSYSTEM_PROFILE
+bool jit_enabled = false;
+#else
+bool jit_enabled = true;
+#endif
+
+static CONTEXT_LOCAL jit_state jit_registers;
+static CONTEXT_LOCAL byte* jit_buffer = NULL;
+static CONTEXT_LOCAL byte* jit_start = NULL;
+static CONTEXT_LOCAL byte* jit_code = NULL;
+static CONTEXT_LOCAL byte* jit_exit = NULL;
+static CONTEXT_LOCAL jit_entry jit_enter = NULL;
+static CONTEXT_LOCAL jit_block** jit_blocks = NULL;
+static CONTEXT_LOCAL jit_block* jit_pool = NULL;
+static CONTEXT_LOCAL uint jit_count = 0;
+static CONTEXT_LOCAL bool jit_failed = false;
+
+// The block being translated
+static CONTEXT_LOCAL uint jit_page;
+static CONTEXT_LOCAL uint jit_generation;
+static CONTEXT_LOCAL jit_label jit_labels[JIT_BLOCK_LENGTH];
+static CONTEXT_LOCAL uint jit_label_count;
+static CONTEXT_LOCAL jit_fixup jit_fixups[JIT_BLOCK_LENGTH * 4 + 1];
+static CONTEXT_LOCAL uint jit_fixup_count;
+
+// ----------------------------------------------------------------------------
+// Encoding
+// The subset of x86-64 used by the translated code. Memory operands always
+// use a 32-bit displacement.
+// ----------------------------------------------------------------------------
+enum {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// The operations of op r/m, r (opcode << 3) and op r/m, imm (/digit)
+enum {
+  X86_ADD, X86_OR, X86_ADC, X86_SBB, X86_AND, X86_SUB, X86_XOR, X86_CMP
+};
+
+// The rotations and shifts of D0 /digit
+enum {
+  X86_ROL, X86_ROR, X86_RCL, X86_RCR, X86_SHL, X86_SHR
+};
+
+// The conditions of jcc and setcc
+enum {
+  X86_O = 0x0, X86_C = 0x2, X86_NC = 0x3, X86_Z = 0x4, X86_NZ = 0x5
+};
+
+#define JIT_WIDE 1
+#define JIT_BYTE 2
+
+static inline void jit_Byte(uint data) {
+  *jit_code++ = (byte)data;
+}
+
+static inline void jit_Word(uint data) {
+  word value = data;
+  memcpy(jit_code, &value, 2);
+  jit_code += 2;
+}
+
+static inline void jit_Dword(uint data) {
+  memcpy(jit_code, &data, 4);
+  jit_code += 4;
+}
+
+static inline void jit_Qword(ullong data) {
+  memcpy(jit_code, &data, 8);
+  jit_code += 8;
+}
+
+// The REX prefix, which is also required to address spl, bpl, sil and dil
+static void jit_Prefix(uint flags, int reg, int index, int base, bool direct) {
+  uint rex = ((flags & JIT_WIDE)? 8: 0) | ((reg & 8)? 4: 0) | 
+             ((index & 8)? 2: 0) | ((base & 8)? 1: 0);
+  if(rex || ((flags & JIT_BYTE) && ((reg >= RSP && reg <= RDI) || 
+     (direct && base >= RSP && base <= RDI)))) {
+    jit_Byte(0x40 | rex);
+  }
+}
+
+static void jit_Opcode(uint opcode) {
+  if(opcode > 0xff) {
+    jit_Byte(opcode >> 8);
+  }
+  jit_Byte(opcode);
+}
+
+// op reg, [base + index + disp] (no index when negative)
+static void jit_Memory(uint opcode, int reg, int base, int index, int disp, uint flags) {
+  jit_Prefix(flags, reg, (index < 0)? 0: index, base, false);
+  jit_Opcode(opcode);
+  if(index < 0 && (base & 7) != RSP) {
+    jit_Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+  }
+  else {
+    jit_Byte(0x84 | ((reg & 7) << 3));
+    jit_Byte(((((index < 0)? RSP: index) & 7) << 3) | (base & 7));
+  }
+  jit_Dword(disp);
+}
+
+// op reg, rm
+static void jit_Register(uint opcode, int reg, int rm, uint flags) {
+  jit_Prefix(flags, reg, 0, rm, true);
+  jit_Opcode(opcode);
+  jit_Byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// movzx reg, byte [base + index + disp]
+static void jit_Load(int reg, int base, int index, int disp) {
+  jit_Memory(0x0fb6, reg, base, index, disp, 0);
+}
+
+// mov byte [base + index + disp], reg
+static void jit_Store(int reg, int base, int index, int disp) {
+  jit_Memory(0x88, reg, base, index, disp, JIT_BYTE);
+}
+
+// movzx reg, rm (byte)
+static void jit_Extend(int reg, int rm) {
+  jit_Register(0x0fb6, reg, rm, JIT_BYTE);
+}
+
+// mov reg, rm
+static void jit_Move(int reg, int rm) {
+  jit_Register(0x8b, reg, rm, 0);
+}
+
+// mov reg, imm32
+static void jit_Immediate(int reg, uint value) {
+  if(reg & 8) {
+    jit_Byte(0x41);
+  }
+  jit_Byte(0xb8 | (reg & 7));
+  jit_Dword(value);
+}
+
+// op rm, reg (bytes)
+static void jit_Alu8(uint alu, int rm, int reg) {
+  jit_Register(alu << 3, reg, rm, JIT_BYTE);
+}
+
+// op rm, imm8 (bytes)
+static void jit_Alu8Immediate(uint alu, int rm, uint value) {
+  jit_Register(0x80, alu, rm, JIT_BYTE);
+  jit_Byte(value);
+}
+
+// op rm, reg
+static void jit_Alu32(uint alu, int rm, int reg) {
+  jit_Register((alu << 3) | 1, reg, rm, 0);
+}
+
+// op rm, imm8 (sign extended)
+static void jit_Alu32Immediate(uint alu, int rm, int value) {
+  jit_Register(0x83, alu, rm, 0);
+  jit_Byte(value);
+}
+
+// op reg, byte [base + index + disp]
+static void jit_AluMemory8(uint alu, int reg, int base, int index, int disp) {
+  jit_Memory((alu << 3) | 2, reg, base, index, disp, JIT_BYTE);
+}
+
+// op dword [base + disp], imm8 (sign extended)
+static void jit_AluMemory32(uint alu, int base, int disp, int value) {
+  jit_Memory(0x83, alu, base, -1, disp, 0);
+  jit_Byte(value);
+}
+
+// inc (0) or dec (1) of rm (byte)
+static void jit_Unary8(uint digit, int rm) {
+  jit_Register(0xfe, digit, rm, JIT_BYTE);
+}
+
+// inc (0) or dec (1) of byte [base + disp]
+static void jit_UnaryMemory8(uint digit, int base, int disp) {
+  jit_Memory(0xfe, digit, base, -1, disp, 0);
+}
+
+// rotation or shift of rm by one (byte)
+static void jit_Shift(uint digit, int rm) {
+  jit_Register(0xd0, digit, rm, JIT_BYTE);
+}
+
+// shl rm, count
+static void jit_Shl32(int rm, uint count) {
+  jit_Register(0xc1, 4, rm, 0);
+  jit_Byte(count);
+}
+
+// setcc rm
+static void jit_Set(uint condition, int rm) {
+  jit_Register(0x0f90 | condition, 0, rm, JIT_BYTE);
+}
+
+// test rm, imm8 (byte)
+static void jit_Test8(int rm, uint value) {
+  jit_Register(0xf6, 0, rm, JIT_BYTE);
+  jit_Byte(value);
+}
+
+// mov rax, function; call rax
+static void jit_Call(const void* function) {
+  jit_Byte(0x48);
+  jit_Byte(0xb8);
+  jit_Qword((ullong)function);
+  jit_Byte(0xff);
+  jit_Byte(0xd0);
+}
+
+// jcc rel32 (jmp when the condition is negative), returns the displacement
+static byte* jit_Jump(int condition) {
+  if(condition < 0) {
+    jit_Byte(0xe9);
+  }
+  else {
+    jit_Byte(0x0f);
+    jit_Byte(0x80 | condition);
+  }
+  jit_Dword(0);
+  return jit_code - 4;
+}
+
+static void jit_Patch(byte* patch, const byte* target) {
+  int displacement = target - (patch + 4);
+  memcpy(patch, &displacement, 4);
+}
+
+// jcc rel8 (jmp when the condition is negative) to the next jit_Land
+static byte* jit_Skip(int condition) {
+  jit_Byte((condition < 0)? 0xeb: 0x70 | condition);
+  jit_Byte(0);
+  return jit_code - 1;
+}
+
+static void jit_Land(byte* patch) {
+  *patch = (byte)(jit_code - (patch + 1));
+}
+
+// ----------------------------------------------------------------------------
+// AddDecimal
+// ADC in decimal mode (see sally_ADC)
+// ----------------------------------------------------------------------------
+static void jit_AddDecimal(jit_state* state, byte data) {
+  byte a = state->a;
+  byte p = state->p;
+  word al = (a & 15) + (data & 15) + (p & JIT_FLAG_C);
+  word ah = (a >> 4) + (data >> 4);
+
+  if(al > 9) {
+    al += 6;
+    ah++;
+  }
+
+  p &= ~(JIT_FLAG_N | JIT_FLAG_V | JIT_FLAG_Z | JIT_FLAG_C);
+  if(!(a + data + (state->p & JIT_FLAG_C))) {
+    p |= JIT_FLAG_Z;
+  }
+  if((ah & 8) != 0) {
+    p |= JIT_FLAG_N;
+  }
+  if(~(a ^ data) & ((ah << 4) ^ a) & 128) {
+    p |= JIT_FLAG_V;
+  }
+  if(ah > 9) {
+    ah += 6;
+  }
+  if(ah > 15) {
+    p |= JIT_FLAG_C;
+  }
+
+  state->a = (ah << 4) | (al & 15);
+  state->p = p;
+}
+
+// ----------------------------------------------------------------------------
+// SubtractDecimal
+// SBC in decimal mode (see sally_SBC)
+// ----------------------------------------------------------------------------
+static void jit_SubtractDecimal(jit_state* state, byte data) {
+  byte a = state->a;
+  byte p = state->p;
+  word al = (a & 15) - (data & 15) - !(p & JIT_FLAG_C);
+  word ah = (a >> 4) - (data >> 4);
+
+  if(al > 9) {
+    al -= 6;
+    ah--;
+  }
+  if(ah > 9) {
+    ah -= 6;
+  }
+
+  pair temp;
+  temp.w = a - data - !(p & JIT_FLAG_C);
+
+  p &= ~(JIT_FLAG_N | JIT_FLAG_V | JIT_FLAG_Z | JIT_FLAG_C);
+  if(!temp.b.h) {
+    p |= JIT_FLAG_C;
+  }
+  if((a ^ data) & (a ^ temp.b.l) & 128) {
+    p |= JIT_FLAG_V;
+  }
+
+  state->a = (ah << 4) | (al & 15);
+  state->p = p | state->flags[temp.b.l];
+}
+
+// ----------------------------------------------------------------------------
+// IsPlain
+// Returns whether memory_Read of the address only reads memory_ram
+// ----------------------------------------------------------------------------
+static bool jit_IsPlain(uint address) {
+  address &= 0xffff;
+  if(address >= INTIM && address <= (INTFLG | 2)) {
+    return false;
+  }
+  if(cartridge_xm && ((address >= 0x0450 && address < 0x0480) || 
+     (address >= 0x4000 && address < 0x8000))) {
+    return false;
+  }
+  if(cartridge_pokey && (cartridge_pokey450? 
+     (address >= 0x0450 && address < 0x0470): 
+     (address >= 0x4000 && address <= 0x400f))) {
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// IsWritable
+// Returns whether memory_Write of the address only writes the RAM (and its
+// mirror, which is the address itself when there is none)
+// ----------------------------------------------------------------------------
+static bool jit_IsWritable(uint address, uint* mirror) {
+  if((address >= 64 && address <= 255) || (address >= 320 && address <= 511)) {
+    *mirror = address + 8192;
+  }
+  else if((address >= 8256 && address <= 8447) || (address >= 8512 && address <= 8702)) {
+    *mirror = address - 8192;
+  }
+  else if(address >= 6144 && address < 10240) {
+    *mirror = address;
+  }
+  else {
+    return false;
+  }
+  return !memory_rom[address] && !memory_rom[*mirror];
+}
+
+// ----------------------------------------------------------------------------
+// Fixup
+// Records a jump to the instruction at the PC, within the block or through
+// an exit. Exits always leave the block.
+// ----------------------------------------------------------------------------
+static void jit_Fixup(byte* patch, word pc, bool exit) {
+  jit_fixups[jit_fixup_count].pc = pc;
+  jit_fixups[jit_fixup_count].exit = exit;
+  jit_fixups[jit_fixup_count].patch = patch;
+  jit_fixup_count++;
+}
+
+// ----------------------------------------------------------------------------
+// Address
+// Emits the address of an indexed or indirect operand to eax (uses edx)
+// ----------------------------------------------------------------------------
+static void jit_Address(byte mode, word operand) {
+  switch(mode) {
+    case JIT_ZPX:
+    case JIT_ZPY:
+      jit_Load(RAX, RBX, -1, (mode == JIT_ZPX)? JIT_X: JIT_Y);
+      jit_Alu8Immediate(X86_ADD, RAX, operand);
+      jit_Extend(RAX, RAX);
+      break;
+    case JIT_ABX:
+    case JIT_ABY:
+      jit_Load(RAX, RBX, -1, (mode == JIT_ABX)? JIT_X: JIT_Y);
+      jit_Register(0x81, X86_ADD, RAX, 0);
+      jit_Dword(operand);
+      jit_Register(0x0fb7, RAX, RAX, 0);
+      break;
+    case JIT_IZX:
+      jit_Load(RAX, RBX, -1, JIT_X);
+      jit_Alu8Immediate(X86_ADD, RAX, operand);
+      jit_Extend(RAX, RAX);
+      jit_Load(RDX, R15, RAX, 1);
+      jit_Load(RAX, R15, RAX, 0);
+      jit_Shl32(RDX, 8);
+      jit_Alu32(X86_OR, RAX, RDX);
+      break;
+    case JIT_IZY:
+      jit_Load(RAX, R15, -1, operand);
+      jit_Load(RDX, R15, -1, operand + 1);
+      jit_Shl32(RDX, 8);
+      jit_Alu32(X86_OR, RAX, RDX);
+      jit_Load(RDX, RBX, -1, JIT_Y);
+      jit_Alu32(X86_ADD, RAX, RDX);
+      jit_Register(0x0fb7, RAX, RAX, 0);
+      break;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Read
+// Emits the read of the operand to ecx. When delayed, a cycle is added when
+// the indexing crosses a page (see sally_Delay).
+// ----------------------------------------------------------------------------
+static void jit_Read(byte mode, word operand, bool delayed) {
+  switch(mode) {
+    case JIT_IMM:
+      jit_Immediate(RCX, operand);
+      break;
+    case JIT_ZPG:
+    case JIT_ABS:
+      if(jit_IsPlain(operand)) {
+        jit_Load(RCX, R15, -1, operand);
+      }
+      else {
+        jit_Immediate(RDI, operand);
+        jit_Call((const void*)memory_Read);
+        jit_Extend(RCX, RAX);
+      }
+      break;
+    case JIT_ZPX:
+    case JIT_ZPY:
+      jit_Address(mode, operand);
+      jit_Load(RCX, R15, RAX, 0);
+      break;
+    default:
+      jit_Address(mode, operand);
+      bool plain = (mode == JIT_ABX || mode == JIT_ABY);
+      for(uint index = 0; plain && index < 256; index++) {
+        plain = jit_IsPlain(operand + index);
+      }
+      if(plain) {
+        jit_Load(RCX, R15, RAX, 0);
+      }
+      else {
+        jit_Move(RDI, RAX);
+        jit_Call((const void*)memory_Read);
+        jit_Extend(RCX, RAX);
+      }
+      break;
+  }
+
+  if(delayed && (mode == JIT_ABX || mode == JIT_ABY || mode == JIT_IZY)) {
+    if(mode == JIT_IZY) {
+      jit_Load(RAX, RBX, -1, JIT_Y);
+      jit_AluMemory8(X86_ADD, RAX, R15, -1, operand);
+    }
+    else {
+      jit_Load(RAX, RBX, -1, (mode == JIT_ABX)? JIT_X: JIT_Y);
+      jit_Alu8Immediate(X86_ADD, RAX, operand & 0xff);
+    }
+    byte* same = jit_Skip(X86_NC);
+    jit_AluMemory32(X86_ADD, R14, 0, 4);
+    jit_Land(same);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Write
+// Emits the write of the byte in reg to the operand. Returns whether
+// memory_Write is called, which may switch the banks.
+// ----------------------------------------------------------------------------
+static bool jit_Write(byte mode, word operand, int reg) {
+  uint mirror;
+  if(mode == JIT_ZPG || mode == JIT_ABS) {
+    if(jit_IsWritable(operand, &mirror)) {
+      jit_Store(reg, R15, -1, operand);
+      if(mirror != operand) {
+        jit_Store(reg, R15, -1, mirror);
+      }
+      return false;
+    }
+    jit_Immediate(RDI, operand);
+  }
+  else {
+    jit_Address(mode, operand);
+    jit_Move(RDI, RAX);
+  }
+  jit_Extend(RSI, reg);
+  jit_Call((const void*)memory_Write);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Flags
+// Emits the N and Z flags of the byte in reg (cleared first when clear)
+// ----------------------------------------------------------------------------
+static void jit_Flags(int reg, bool clear) {
+  if(clear) {
+    jit_Alu32Immediate(X86_AND, RBP, ~(JIT_FLAG_N | JIT_FLAG_Z));
+  }
+  jit_Extend(RAX, reg);
+  jit_AluMemory8(X86_OR, RBP, RBX, RAX, JIT_FLAGS);
+}
+
+// ----------------------------------------------------------------------------
+// Carry
+// Emits the N, Z and C flags of the byte in reg, C being the x86 carry
+// ----------------------------------------------------------------------------
+static void jit_Carry(int reg, uint condition) {
+  jit_Set(condition, RDX);
+  jit_Extend(RDX, RDX);
+  jit_Alu32Immediate(X86_AND, RBP, ~(JIT_FLAG_N | JIT_FLAG_Z | JIT_FLAG_C));
+  jit_Alu32(X86_OR, RBP, RDX);
+  jit_Flags(reg, false);
+}
+
+// ----------------------------------------------------------------------------
+// Arithmetic
+// Emits ADC or SBC of ecx, the decimal mode is left to a helper
+// ----------------------------------------------------------------------------
+static void jit_Arithmetic(bool subtract) {
+  jit_Test8(RBP, JIT_FLAG_D);
+  byte* binary = jit_Skip(X86_Z);
+  jit_Store(R12, RBX, -1, JIT_A);
+  jit_Store(RBP, RBX, -1, JIT_P);
+  jit_Register(0x89, RBX, RDI, JIT_WIDE);
+  jit_Move(RSI, RCX);
+  jit_Call(subtract? (const void*)jit_SubtractDecimal: (const void*)jit_AddDecimal);
+  jit_Load(R12, RBX, -1, JIT_A);
+  jit_Load(RBP, RBX, -1, JIT_P);
+  byte* done = jit_Skip(-1);
+
+  // The x86 carry is the borrow of SBB, the overflow matches V
+  jit_Land(binary);
+  jit_Register(0x0fba, 4, RBP, 0);
+  jit_Byte(0);
+  if(subtract) {
+    jit_Byte(0xf5);
+    jit_Alu8(X86_SBB, R12, RCX);
+    jit_Set(X86_NC, RDX);
+  }
+  else {
+    jit_Alu8(X86_ADC, R12, RCX);
+    jit_Set(X86_C, RDX);
+  }
+  jit_Set(X86_O, RAX);
+  jit_Alu32Immediate(X86_AND, RBP, ~(JIT_FLAG_N | JIT_FLAG_V | JIT_FLAG_Z | JIT_FLAG_C));
+  jit_Extend(RDX, RDX);
+  jit_Alu32(X86_OR, RBP, RDX);
+  jit_Extend(RAX, RAX);
+  jit_Shl32(RAX, 6);
+  jit_Alu32(X86_OR, RBP, RAX);
+  jit_Flags(R12, false);
+  jit_Land(done);
+}
+
+// ----------------------------------------------------------------------------
+// Compare
+// Emits CMP, CPX or CPY of eax with ecx
+// ----------------------------------------------------------------------------
+static void jit_Compare( ) {
+  jit_Alu32(X86_XOR, RDX, RDX);
+  jit_Alu8(X86_CMP, RAX, RCX);
+  jit_Set(X86_NC, RDX);
+  jit_Alu8(X86_SUB, RAX, RCX);
+  jit_Alu32Immediate(X86_AND, RBP, ~(JIT_FLAG_N | JIT_FLAG_Z | JIT_FLAG_C));
+  jit_Alu32(X86_OR, RBP, RDX);
+  jit_Flags(RAX, false);
+}
+
+// ----------------------------------------------------------------------------
+// Push
+// Emits the push of the byte in reg, the stack is RAM (see jit_Translate)
+// ----------------------------------------------------------------------------
+static void jit_Push(int reg) {
+  jit_Load(RAX, RBX, -1, JIT_S);
+  jit_Store(reg, R15, RAX, 256);
+  jit_Alu8Immediate(X86_CMP, RAX, 64);
+  byte* unmirrored = jit_Skip(X86_C);
+  jit_Store(reg, R15, RAX, 8448);
+  jit_Land(unmirrored);
+  jit_UnaryMemory8(1, RBX, JIT_S);
+}
+
+// ----------------------------------------------------------------------------
+// Pop
+// Emits the pop of a byte to reg
+// ----------------------------------------------------------------------------
+static void jit_Pop(int reg) {
+  jit_UnaryMemory8(0, RBX, JIT_S);
+  jit_Load(RAX, RBX, -1, JIT_S);
+  jit_Load(reg, R15, RAX, 256);
+}
+
+// ----------------------------------------------------------------------------
+// End
+// Emits the end of an instruction: its cycles, the exit when a write changed
+// the code of the block and the exit when the event is reached.
+// ----------------------------------------------------------------------------
+static void jit_End(uint cycles, word next, bool written) {
+  jit_AluMemory32(X86_ADD, R14, 0, cycles << 2);
+#ifdef PROSYSTEM_STATS
+  jit_AluMemory32(X86_ADD, RBX, JIT_INSTRUCTIONS, 1);
+#endif
+  if(written) {
+    jit_Byte(0x48);
+    jit_Byte(0xb8);
+    jit_Qword((ullong)&sally_pages[jit_page]);
+    jit_Memory(0x81, X86_CMP, RAX, -1, 0, 0);
+    jit_Dword(jit_generation);
+    jit_Fixup(jit_Jump(X86_NZ), next, true);
+  }
+  jit_Memory(0x8b, RAX, R14, -1, 0, 0);
+  jit_Memory(0x3b, RAX, R13, -1, 0, 0);
+  jit_Fixup(jit_Jump(X86_NC), next, true);
+}
+
+// ----------------------------------------------------------------------------
+// Instruction
+// Translates an instruction, returns whether the block goes on past it
+// ----------------------------------------------------------------------------
+static bool jit_Instruction(byte opcode, word operand, word pc, word next) {
+  byte operation = JIT_OPCODES[opcode].operation;
+  byte mode = JIT_OPCODES[opcode].mode;
+  uint cycles = SALLY_CYCLES[opcode];
+  bool written = false;
+  uint mask = 0;
+  bool set = false;
+
+  switch(operation) {
+    case JIT_LDA:
+      jit_Read(mode, operand, true);
+      jit_Move(R12, RCX);
+      jit_Flags(R12, true);
+      break;
+    case JIT_LDX:
+    case JIT_LDY:
+      jit_Read(mode, operand, true);
+      jit_Store(RCX, RBX, -1, (operation == JIT_LDX)? JIT_X: JIT_Y);
+      jit_Flags(RCX, true);
+      break;
+    case JIT_STA:
+      written = jit_Write(mode, operand, R12);
+      break;
+    case JIT_STX:
+    case JIT_STY:
+      jit_Load(RCX, RBX, -1, (operation == JIT_STX)? JIT_X: JIT_Y);
+      written = jit_Write(mode, operand, RCX);
+      break;
+    case JIT_AND:
+    case JIT_ORA:
+    case JIT_EOR:
+      jit_Read(mode, operand, true);
+      jit_Alu8((operation == JIT_AND)? X86_AND: (operation == JIT_ORA)? X86_OR: X86_XOR, R12, RCX);
+      jit_Flags(R12, true);
+      break;
+    case JIT_ADC:
+    case JIT_SBC:
+      jit_Read(mode, operand, true);
+      jit_Arithmetic(operation == JIT_SBC);
+      break;
+    case JIT_CMP:
+      jit_Read(mode, operand, true);
+      jit_Move(RAX, R12);
+      jit_Compare( );
+      break;
+    case JIT_CPX:
+    case JIT_CPY:
+      jit_Read(mode, operand, false);
+      jit_Load(RAX, RBX, -1, (operation == JIT_CPX)? JIT_X: JIT_Y);
+      jit_Compare( );
+      break;
+    case JIT_BIT: {
+      jit_Read(mode, operand, false);
+      jit_Alu32Immediate(X86_AND, RBP, ~(JIT_FLAG_N | JIT_FLAG_V | JIT_FLAG_Z));
+      jit_Move(RAX, RCX);
+      jit_Alu32Immediate(X86_AND, RAX, JIT_FLAG_N | JIT_FLAG_V);
+      jit_Alu32(X86_OR, RBP, RAX);
+      jit_Register(0x84, RCX, R12, JIT_BYTE);
+      byte* nonzero = jit_Skip(X86_NZ);
+      jit_Alu32Immediate(X86_OR, RBP, JIT_FLAG_Z);
+      jit_Land(nonzero);
+
+      // The half cycle of reading INPT4 (see sally_Run)
+      if(mode == JIT_ZPG && operand == INPT4) {
+        jit_AluMemory32(X86_ADD, R14, 0, 2);
+        jit_Byte(0x48);
+        jit_Byte(0xb8);
+        jit_Qword((ullong)&riot_half_cycles);
+        jit_Memory(0xff, 0, RAX, -1, 0, 0);
+      }
+      break;
+    }
+    case JIT_ASL:
+    case JIT_LSR:
+    case JIT_ROL:
+    case JIT_ROR: {
+      uint digit = (operation == JIT_ASL)? X86_SHL: (operation == JIT_LSR)? X86_SHR: 
+                   (operation == JIT_ROL)? X86_RCL: X86_RCR;
+      int reg = (mode == JIT_IMP)? R12: RCX;
+      if(mode != JIT_IMP) {
+        jit_Read(mode, operand, false);
+      }
+      if(operation == JIT_ROL || operation == JIT_ROR) {
+        jit_Register(0x0fba, 4, RBP, 0);
+        jit_Byte(0);
+      }
+      jit_Shift(digit, reg);
+      jit_Carry(reg, X86_C);
+      if(mode != JIT_IMP) {
+        written = jit_Write(mode, operand, RCX);
+      }
+      break;
+    }
+    case JIT_INC:
+    case JIT_DEC:
+      jit_Read(mode, operand, false);
+      jit_Unary8((operation == JIT_INC)? 0: 1, RCX);
+      jit_Flags(RCX, true);
+      written = jit_Write(mode, operand, RCX);
+      break;
+    case JIT_INX:
+    case JIT_INY:
+    case JIT_DEX:
+    case JIT_DEY: {
+      int disp = (operation == JIT_INX || operation == JIT_DEX)? JIT_X: JIT_Y;
+      jit_UnaryMemory8((operation == JIT_INX || operation == JIT_INY)? 0: 1, RBX, disp);
+      jit_Load(RAX, RBX, -1, disp);
+      jit_Flags(RAX, true);
+      break;
+    }
+    case JIT_TAX:
+    case JIT_TAY:
+      jit_Store(R12, RBX, -1, (operation == JIT_TAX)? JIT_X: JIT_Y);
+      jit_Flags(R12, true);
+      break;
+    case JIT_TXA:
+    case JIT_TYA:
+      jit_Load(R12, RBX, -1, (operation == JIT_TXA)? JIT_X: JIT_Y);
+      jit_Flags(R12, true);
+      break;
+    case JIT_TSX:
+      jit_Load(RCX, RBX, -1, JIT_S);
+      jit_Store(RCX, RBX, -1, JIT_X);
+      jit_Flags(RCX, true);
+      break;
+    case JIT_TXS:
+      jit_Load(RCX, RBX, -1, JIT_X);
+      jit_Store(RCX, RBX, -1, JIT_S);
+      break;
+    case JIT_CLC:
+      jit_Alu32Immediate(X86_AND, RBP, ~JIT_FLAG_C);
+      break;
+    case JIT_SEC:
+      jit_Alu32Immediate(X86_OR, RBP, JIT_FLAG_C);
+      break;
+    case JIT_CLD:
+      jit_Alu32Immediate(X86_AND, RBP, ~JIT_FLAG_D);
+      break;
+    case JIT_SED:
+      jit_Alu32Immediate(X86_OR, RBP, JIT_FLAG_D);
+      break;
+    case JIT_CLI:
+      jit_Alu32Immediate(X86_AND, RBP, ~0x04);
+      break;
+    case JIT_SEI:
+      jit_Alu32Immediate(X86_OR, RBP, 0x04);
+      break;
+    case JIT_CLV:
+      jit_Alu32Immediate(X86_AND, RBP, ~JIT_FLAG_V);
+      break;
+    case JIT_NOP:
+      break;
+    case JIT_PHA:
+      jit_Push(R12);
+      break;
+    case JIT_PHP:
+      jit_Push(RBP);
+      break;
+    case JIT_PLA:
+      jit_Pop(R12);
+      jit_Flags(R12, true);
+      break;
+    case JIT_PLP:
+      jit_Pop(RBP);
+      break;
+    case JIT_JSR:
+      jit_Immediate(RCX, (word)(pc + 2) >> 8);
+      jit_Push(RCX);
+      jit_Immediate(RCX, (pc + 2) & 0xff);
+      jit_Push(RCX);
+      jit_End(cycles, operand, false);
+      jit_Fixup(jit_Jump(-1), operand, false);
+      return false;
+    case JIT_JMP:
+      jit_End(cycles, operand, false);
+      jit_Fixup(jit_Jump(-1), operand, false);
+      return false;
+    case JIT_RTS:
+      jit_Pop(RCX);
+      jit_Pop(RDX);
+      jit_Shl32(RDX, 8);
+      jit_Alu32(X86_OR, RCX, RDX);
+      jit_Register(0xff, 0, RCX, 0);
+      jit_Byte(0x66);
+      jit_Memory(0x89, RCX, RBX, -1, JIT_PC, 0);
+      jit_AluMemory32(X86_ADD, R14, 0, cycles << 2);
+#ifdef PROSYSTEM_STATS
+      jit_AluMemory32(X86_ADD, RBX, JIT_INSTRUCTIONS, 1);
+#endif
+      jit_Patch(jit_Jump(-1), jit_exit);
+      return false;
+    case JIT_BPL:
+    case JIT_BMI:
+      mask = JIT_FLAG_N;
+      set = (operation == JIT_BMI);
+      break;
+    case JIT_BVC:
+    case JIT_BVS:
+      mask = JIT_FLAG_V;
+      set = (operation == JIT_BVS);
+      break;
+    case JIT_BCC:
+    case JIT_BCS:
+      mask = JIT_FLAG_C;
+      set = (operation == JIT_BCS);
+      break;
+    case JIT_BNE:
+    case JIT_BEQ:
+      mask = JIT_FLAG_Z;
+      set = (operation == JIT_BEQ);
+      break;
+  }
+
+  // A branch taken costs a cycle, two when it crosses a page
+  if(mask) {
+    word target = next + (signed char)operand;
+    jit_Test8(RBP, mask);
+    byte* untaken = jit_Jump(set? X86_Z: X86_NZ);
+    jit_End(cycles + (((target ^ next) & 0xff00)? 2: 1), target, false);
+    jit_Fixup(jit_Jump(-1), target, false);
+    jit_Patch(untaken, jit_code);
+  }
+
+  jit_End(cycles, next, written);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Flush
+// Discards the translated code
+// ----------------------------------------------------------------------------
+void jit_Flush( ) {
+  if(jit_buffer != NULL) {
+    memset(jit_blocks, 0, MEMORY_SIZE * sizeof(jit_block*));
+    jit_count = 0;
+    jit_code = jit_start;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Translate
+// Translates the block starting at the address. A block ends at the first
+// jump, at the end of the page or before an instruction left to the
+// interpreter.
+// ----------------------------------------------------------------------------
+static jit_block* jit_Translate(word address) {
+  if(jit_count == JIT_BLOCKS || jit_code + JIT_BLOCK_SPACE > jit_buffer + JIT_CODE_SIZE) {
+    jit_Flush( );
+  }
+
+  jit_page = address >> 8;
+  jit_generation = sally_pages[jit_page];
+  jit_block* block = &jit_pool[jit_count++];
+  block->generation = jit_generation;
+  block->code = NULL;
+  jit_blocks[address] = block;
+
+  // The stack is accessed directly unless it has been mapped to a cartridge
+  bool stack = memchr(memory_rom + 256, 1, 256) == NULL && memchr(memory_rom + 8448, 1, 256) == NULL;
+
+  byte* start = jit_code;
+  jit_label_count = 0;
+  jit_fixup_count = 0;
+  word pc = address;
+  bool open = true;
+  while(open && jit_label_count < JIT_BLOCK_LENGTH && (pc >> 8) == jit_page) {
+    byte opcode = memory_ram[pc];
+    byte operation = JIT_OPCODES[opcode].operation;
+    uint length = SALLY_LENGTHS[opcode];
+    if(operation == JIT_NONE || (pc & 0xff) + length > 256) {
+      break;
+    }
+    word operand = 0;
+    if(length > 1) {
+      operand = memory_ram[pc + 1];
+    }
+    if(length > 2) {
+      operand |= memory_ram[pc + 2] << 8;
+    }
+    if(!stack && (operation == JIT_PHA || operation == JIT_PHP || operation == JIT_PLA || 
+       operation == JIT_PLP || operation == JIT_JSR || operation == JIT_RTS)) {
+      break;
+    }
+
+    // The entry points of the high score ROM are checked by the interpreter
+    if((operation == JIT_JMP || operation == JIT_JSR) && (operand == 0x3fcf || operand == 0x3ffd)) {
+      break;
+    }
+
+    jit_labels[jit_label_count].pc = pc;
+    jit_labels[jit_label_count].code = jit_code;
+    jit_label_count++;
+    word next = pc + length;
+    open = jit_Instruction(opcode, operand, pc, next);
+    pc = next;
+  }
+
+  if(jit_label_count == 0) {
+    return block;
+  }
+  if(open) {
+    jit_Fixup(jit_Jump(-1), pc, true);
+  }
+
+  // Jumps within the block go to the instruction, others to an exit that
+  // stores the PC (one per PC)
+  jit_label exits[JIT_BLOCK_LENGTH * 4 + 1];
+  uint exit_count = 0;
+  for(uint index = 0; index < jit_fixup_count; index++) {
+    const jit_fixup* fixup = &jit_fixups[index];
+    const byte* target = NULL;
+    for(uint label = 0; !fixup->exit && label < jit_label_count; label++) {
+      if(jit_labels[label].pc == fixup->pc) {
+        target = jit_labels[label].code;
+      }
+    }
+    for(uint exit = 0; target == NULL && exit < exit_count; exit++) {
+      if(exits[exit].pc == fixup->pc) {
+        target = exits[exit].code;
+      }
+    }
+    if(target == NULL) {
+      exits[exit_count].pc = fixup->pc;
+      exits[exit_count].code = jit_code;
+      exit_count++;
+      target = jit_code;
+      jit_Byte(0x66);
+      jit_Memory(0xc7, 0, RBX, -1, JIT_PC, 0);
+      jit_Word(fixup->pc);
+      jit_Patch(jit_Jump(-1), jit_exit);
+    }
+    jit_Patch(fixup->patch, target);
+  }
+
+  block->code = start;
+  return block;
+}
+
+// ----------------------------------------------------------------------------
+// Initialize
+// Allocates the code buffer and emits the entry of the translated code,
+// which loads the registers and jumps to the block, and its exit.
+// ----------------------------------------------------------------------------
+static bool jit_Initialize( ) {
+  if(jit_buffer != NULL) {
+    return true;
+  }
+  if(jit_failed) {
+    return false;
+  }
+
+  void* buffer = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, 
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  jit_blocks = (jit_block**)calloc(MEMORY_SIZE, sizeof(jit_block*));
+  jit_pool = (jit_block*)malloc(JIT_BLOCKS * sizeof(jit_block));
+  if(buffer == MAP_FAILED || jit_blocks == NULL || jit_pool == NULL) {
+    logger_LogError("Failed to allocate the translated code buffers.", JIT_SOURCE);
+    if(buffer != MAP_FAILED) {
+      munmap(buffer, JIT_CODE_SIZE);
+    }
+    free(jit_blocks);
+    free(jit_pool);
+    jit_blocks = NULL;
+    jit_pool = NULL;
+    jit_failed = true;
+    return false;
+  }
+  jit_buffer = (byte*)buffer;
+  jit_code = jit_buffer;
+
+  static const int saved[ ] = {RBX, RBP, R12, R13, R14, R15};
+  jit_enter = (jit_entry)jit_code;
+  for(uint index = 0; index < 6; index++) {
+    if(saved[index] & 8) {
+      jit_Byte(0x41);
+    }
+    jit_Byte(0x50 | (saved[index] & 7));
+  }
+  jit_Register(0x83, X86_SUB, RSP, JIT_WIDE);
+  jit_Byte(8);
+  jit_Register(0x89, RDI, RBX, JIT_WIDE);
+  jit_Memory(0x8b, R15, RBX, -1, JIT_RAM, JIT_WIDE);
+  jit_Memory(0x8b, R14, RBX, -1, JIT_CYCLES, JIT_WIDE);
+  jit_Memory(0x8b, R13, RBX, -1, JIT_EVENT, JIT_WIDE);
+  jit_Load(R12, RBX, -1, JIT_A);
+  jit_Load(RBP, RBX, -1, JIT_P);
+  jit_Register(0xff, 4, RSI, 0);
+
+  jit_exit = jit_code;
+  jit_Store(R12, RBX, -1, JIT_A);
+  jit_Store(RBP, RBX, -1, JIT_P);
+  jit_Register(0x83, X86_ADD, RSP, JIT_WIDE);
+  jit_Byte(8);
+  for(int index = 5; index >= 0; index--) {
+    if(saved[index] & 8) {
+      jit_Byte(0x41);
+    }
+    jit_Byte(0x58 | (saved[index] & 7));
+  }
+  jit_Byte(0xc3);
+  jit_start = jit_code;
+
+  for(uint value = 0; value < 256; value++) {
+    jit_registers.flags[value] = (value & JIT_FLAG_N) | (value? 0: JIT_FLAG_Z);
+  }
+  jit_registers.instructions = 0;
+  jit_registers.ram = memory_ram;
+  jit_registers.cycles = &prosystem_cycles;
+  jit_registers.event = &prosystem_event;
+  jit_count = 0;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Lookup
+// Returns the block at the address, translating it when needed, or NULL
+// when the interpreter executes the instruction.
+// ----------------------------------------------------------------------------
+static inline const jit_block* jit_Lookup(word address) {
+  uint generation = sally_pages[address >> 8];
+  if(generation == SALLY_PAGE_UNCACHED) {
+    return NULL;
+  }
+  const jit_block* block = jit_blocks[address];
+  if(block == NULL || block->generation != generation) {
+    block = jit_Translate(address);
+  }
+  return (block->code != NULL)? block: NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Execute
+// Runs the translated blocks from the PC until the event (see prosystem_Run)
+// is reached. Returns false, without running anything, when there is no
+// block at the PC.
+// ----------------------------------------------------------------------------
+bool jit_Execute( ) {
+  if(!jit_enabled || !jit_Initialize( )) {
+    return false;
+  }
+  const jit_block* block = jit_Lookup(sally_pc.w);
+  if(block == NULL) {
+    return false;
+  }
+
+  jit_registers.a = sally_a;
+  jit_registers.x = sally_x;
+  jit_registers.y = sally_y;
+  jit_registers.p = sally_GetP( );
+  jit_registers.s = sally_s;
+  jit_registers.pc = sally_pc.w;
+  do {
+    jit_enter(&jit_registers, block->code);
+  } while(prosystem_cycles < prosystem_event && 
+          (block = jit_Lookup(jit_registers.pc)) != NULL);
+  sally_a = jit_registers.a;
+  sally_x = jit_registers.x;
+  sally_y = jit_registers.y;
+  sally_SetP(jit_registers.p);
+  sally_s = jit_registers.s;
+  sally_pc.w = jit_registers.pc;
+
+  STATS_ADD(instructions, jit_registers.instructions);
+  jit_registers.instructions = 0;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void jit_Release( ) {
+  if(jit_buffer != NULL) {
+    munmap(jit_buffer, JIT_CODE_SIZE);
+    free(jit_blocks);
+    free(jit_pool);
+  }
+  jit_buffer = NULL;
+  jit_start = NULL;
+  jit_code = NULL;
+  jit_exit = NULL;
+  jit_enter = NULL;
+  jit_blocks = NULL;
+  jit_pool = NULL;
+  jit_count = 0;
+  jit_failed = false;
+}
+#endif
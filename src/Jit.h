@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Jit.h
+// Translation of the ROM-resident 6502 code to x86-64 code for the headless
+// host tools. When built with PROSYSTEM_JIT, the basic blocks of the ROM pages
+// are translated on first use and run in place of the interpreter, which
+// still executes the code of the RAM, the unsupported opcodes and every
+// instruction when the JIT is disabled. Otherwise nothing is translated.
+// ----------------------------------------------------------------------------
+#ifndef JIT_H
+#define JIT_H
+
+#include "EmulatorContext.h"
+
+#ifdef PROSYSTEM_JIT
+#if !defined(__x86_64__)
+#error "PROSYSTEM_JIT requires an x86-64 host"
+#endif
+
+// Whether the translated code is run (set prior to creating the contexts)
+extern bool jit_enabled;
+
+extern bool jit_Execute( );
+extern void jit_Flush( );
+extern void jit_Release( );
+#endif
+
+#endif
@@ -23,6 +23,16 @@
 // Maria.c
 // ----------------------------------------------------------------------------
 #include "Maria.h"
+#include "State.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MARIA_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MARIA_NEON
+#endif
 
 #ifdef WII_NETTRACE
 #include <network.h>
@@ -33,24 +43,24 @@
 
 extern unsigned char* wii_sdl_get_blit_addr();
 extern unsigned int wii_lightgun_flash;
-extern bool lightgun_enabled;
+extern CONTEXT_LOCAL bool lightgun_enabled;
 
-rect maria_displayArea = {0, 16, 319, 258};
-rect maria_visibleArea = {0, 26, 319, 248};
-byte* maria_surface = 0;
-word  maria_scanline = 1;
+CONTEXT_LOCAL rect maria_displayArea = {0, 16, 319, 258};
+CONTEXT_LOCAL rect maria_visibleArea = {0, 26, 319, 248};
+CONTEXT_LOCAL byte* maria_surface = 0;
+CONTEXT_LOCAL word  maria_scanline = 1;
 
-static byte maria_lineRAM[MARIA_LINERAM_SIZE];
-static uint maria_cycles;
-static pair maria_dpp;
-static pair maria_dp;
-static pair maria_pp;
-static byte maria_horizontal;
-static byte maria_palette;
-static signed char maria_offset;
-static byte maria_h08;
-static byte maria_h16;
-static byte maria_wmode;
+static CONTEXT_LOCAL byte maria_lineRAM[MARIA_LINERAM_SIZE];
+static CONTEXT_LOCAL uint maria_cycles;
+static CONTEXT_LOCAL pair maria_dpp;
+static CONTEXT_LOCAL pair maria_dp;
+static CONTEXT_LOCAL pair maria_pp;
+static CONTEXT_LOCAL byte maria_horizontal;
+static CONTEXT_LOCAL byte maria_palette;
+static CONTEXT_LOCAL signed char maria_offset;
+static CONTEXT_LOCAL byte maria_h08;
+static CONTEXT_LOCAL byte maria_h16;
+static CONTEXT_LOCAL byte maria_wmode;
 
 // ----------------------------------------------------------------------------
 // StoreCell
@@ -105,7 +115,7 @@ static inline bool maria_IsHolyDMA( ) {
 // ----------------------------------------------------------------------------
 // GetColor
 // ----------------------------------------------------------------------------
-extern byte atari_pal8[256];
+extern CONTEXT_LOCAL byte atari_pal8[256];
 
 static inline byte maria_GetColor(byte data) {  
   if(data & 3) {
@@ -154,66 +164,161 @@ static inline void maria_StoreGraphic( ) {
   maria_pp.w++;
 }
 
+// ----------------------------------------------------------------------------
+// Expand
+// Writes the two pixels of each line RAM entry, looked up in the tables of
+// the left and right pixel of its 32 values (see WriteLineRAM).
+// ----------------------------------------------------------------------------
+typedef void (*maria_expandFunction)(byte* buffer, const byte* left, const byte* right);
+
+static void maria_Expand(byte* buffer, const byte* left, const byte* right) {
+  for(int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+    byte data = maria_lineRAM[index] & 31;
+    buffer[(index << 1) + 0] = left[data];
+    buffer[(index << 1) + 1] = right[data];
+  }
+}
+
+#ifdef MARIA_X86
+// ----------------------------------------------------------------------------
+// ExpandSSSE3
+// Looks up 16 entries at a time in the two halves of each table
+// ----------------------------------------------------------------------------
+__attribute__((target("ssse3")))
+static void maria_ExpandSSSE3(byte* buffer, const byte* left, const byte* right) {
+  const __m128i left0 = _mm_loadu_si128((const __m128i*)left);
+  const __m128i left1 = _mm_loadu_si128((const __m128i*)(left + 16));
+  const __m128i right0 = _mm_loadu_si128((const __m128i*)right);
+  const __m128i right1 = _mm_loadu_si128((const __m128i*)(right + 16));
+  const __m128i mask = _mm_set1_epi8(31);
+  const __m128i half = _mm_set1_epi8(16);
+  for(int index = 0; index < MARIA_LINERAM_SIZE; index += 16) {
+    __m128i data = _mm_and_si128(_mm_loadu_si128((const __m128i*)(maria_lineRAM + index)), mask);
+    __m128i high = _mm_cmpeq_epi8(_mm_and_si128(data, half), half);
+    __m128i l = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(left0, data)),
+                             _mm_and_si128(high, _mm_shuffle_epi8(left1, data)));
+    __m128i r = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(right0, data)),
+                             _mm_and_si128(high, _mm_shuffle_epi8(right1, data)));
+    _mm_storeu_si128((__m128i*)(buffer + (index << 1)), _mm_unpacklo_epi8(l, r));
+    _mm_storeu_si128((__m128i*)(buffer + (index << 1) + 16), _mm_unpackhi_epi8(l, r));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// ExpandAVX2
+// Looks up 32 entries at a time, the shuffles work within each 128-bit lane
+// ----------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static void maria_ExpandAVX2(byte* buffer, const byte* left, const byte* right) {
+  const __m256i left0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)left));
+  const __m256i left1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(left + 16)));
+  const __m256i right0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)right));
+  const __m256i right1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(right + 16)));
+  const __m256i mask = _mm256_set1_epi8(31);
+  const __m256i half = _mm256_set1_epi8(16);
+  for(int index = 0; index < MARIA_LINERAM_SIZE; index += 32) {
+    __m256i data = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(maria_lineRAM + index)), mask);
+    __m256i high = _mm256_cmpeq_epi8(_mm256_and_si256(data, half), half);
+    __m256i l = _mm256_blendv_epi8(_mm256_shuffle_epi8(left0, data), _mm256_shuffle_epi8(left1, data), high);
+    __m256i r = _mm256_blendv_epi8(_mm256_shuffle_epi8(right0, data), _mm256_shuffle_epi8(right1, data), high);
+    __m256i low = _mm256_unpacklo_epi8(l, r);
+    __m256i upper = _mm256_unpackhi_epi8(l, r);
+    _mm256_storeu_si256((__m256i*)(buffer + (index << 1)), _mm256_permute2x128_si256(low, upper, 0x20));
+    _mm256_storeu_si256((__m256i*)(buffer + (index << 1) + 32), _mm256_permute2x128_si256(low, upper, 0x31));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// SelectExpand
+// ----------------------------------------------------------------------------
+static maria_expandFunction maria_SelectExpand( ) {
+  __builtin_cpu_init( );
+  if(__builtin_cpu_supports("avx2")) {
+    return maria_ExpandAVX2;
+  }
+  if(__builtin_cpu_supports("ssse3")) {
+    return maria_ExpandSSSE3;
+  }
+  return maria_Expand;
+}
+#endif
+
+#ifdef MARIA_NEON
+// ----------------------------------------------------------------------------
+// ExpandNEON
+// Looks up 16 entries at a time in the 32 byte tables, storing the pixels
+// interleaved
+// ----------------------------------------------------------------------------
+static void maria_ExpandNEON(byte* buffer, const byte* left, const byte* right) {
+  const uint8x16x2_t lefts = {{vld1q_u8(left), vld1q_u8(left + 16)}};
+  const uint8x16x2_t rights = {{vld1q_u8(right), vld1q_u8(right + 16)}};
+  const uint8x16_t mask = vdupq_n_u8(31);
+  for(int index = 0; index < MARIA_LINERAM_SIZE; index += 16) {
+    uint8x16_t data = vandq_u8(vld1q_u8(maria_lineRAM + index), mask);
+    uint8x16x2_t pixels = {{vqtbl2q_u8(lefts, data), vqtbl2q_u8(rights, data)}};
+    vst2q_u8(buffer + (index << 1), pixels);
+  }
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // WriteLineRAM
+// Builds the colors of the 32 values of the line RAM from the palette
+// registers and, for the read mode, the colors of the left and right pixel
+// each value is displayed as, then expands the line RAM with them.
 // ----------------------------------------------------------------------------
 static inline void maria_WriteLineRAM(byte* buffer) {
   byte rmode = memory_ram[CTRL] & 3;
+  if(rmode == 1) {
+    return;
+  }
+
+  byte colors[32];
+  byte left[32];
+  byte right[32];
+  for(int data = 0; data < 32; data++) {
+    colors[data] = maria_GetColor(data);
+  }
   if(rmode == 0) {
     // 160A/B
-    int pixel = 0;
-    for(int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-      word color;
-      color = maria_GetColor(maria_lineRAM[index + 0]);
-      buffer[pixel++] = color;
-      buffer[pixel++] = color;
-      color = maria_GetColor(maria_lineRAM[index + 1]);
-      buffer[pixel++] = color;
-      buffer[pixel++] = color;
-      color = maria_GetColor(maria_lineRAM[index + 2]);
-      buffer[pixel++] = color;
-      buffer[pixel++] = color;
-      color = maria_GetColor(maria_lineRAM[index + 3]);
-      buffer[pixel++] = color;
-      buffer[pixel++] = color;
-    }
+    memcpy(left, colors, sizeof(colors));
+    memcpy(right, colors, sizeof(colors));
   }
-  else if(rmode == 2) { 
+  else if(rmode == 2) {
     // 320B/D
-    int pixel = 0;
-    for(int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 16) | ((maria_lineRAM[index + 0] & 8) >> 3) | ((maria_lineRAM[index + 0] & 2)));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 16) | ((maria_lineRAM[index + 0] & 4) >> 2) | ((maria_lineRAM[index + 0] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 16) | ((maria_lineRAM[index + 1] & 8) >> 3) | ((maria_lineRAM[index + 1] & 2)));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 16) | ((maria_lineRAM[index + 1] & 4) >> 2) | ((maria_lineRAM[index + 1] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 16) | ((maria_lineRAM[index + 2] & 8) >> 3) | ((maria_lineRAM[index + 2] & 2)));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 16) | ((maria_lineRAM[index + 2] & 4) >> 2) | ((maria_lineRAM[index + 2] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 16) | ((maria_lineRAM[index + 3] & 8) >> 3) | ((maria_lineRAM[index + 3] & 2)));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 16) | ((maria_lineRAM[index + 3] & 4) >> 2) | ((maria_lineRAM[index + 3] & 1) << 1));
+    for(int data = 0; data < 32; data++) {
+      left[data] = colors[(data & 16) | ((data & 8) >> 3) | (data & 2)];
+      right[data] = colors[(data & 16) | ((data & 4) >> 2) | ((data & 1) << 1)];
     }
   }
-  else if(rmode == 3) {
+  else {
     // 320A/C
-    int pixel = 0;
-    for(int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 30));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 28) | ((maria_lineRAM[index + 0] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 30));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 28) | ((maria_lineRAM[index + 1] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 30));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 28) | ((maria_lineRAM[index + 2] & 1) << 1));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 30));
-      buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 28) | ((maria_lineRAM[index + 3] & 1) << 1));
+    for(int data = 0; data < 32; data++) {
+      left[data] = colors[data & 30];
+      right[data] = colors[(data & 28) | ((data & 1) << 1)];
     }
   }
+
+#if defined(MARIA_X86)
+  static const maria_expandFunction expand = maria_SelectExpand( );
+  expand(buffer, left, right);
+#elif defined(MARIA_NEON)
+  maria_ExpandNEON(buffer, left, right);
+#else
+  maria_Expand(buffer, left, right);
+#endif
 }
 
 // ----------------------------------------------------------------------------
 // StoreLineRAM
+// When not rendering, the display list is walked for the DMA cycle counts
+// only (the line RAM is left untouched).
 // ----------------------------------------------------------------------------
-static inline void maria_StoreLineRAM( ) {
-  for(int index = 0; index < MARIA_LINERAM_SIZE; index++) {
-    maria_lineRAM[index] = 0;
+static inline void maria_StoreLineRAM(bool render) {
+  if(render) {
+    for(int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+      maria_lineRAM[index] = 0;
+    }
   }
   
   byte mode = memory_ram[maria_dp.w + 1];
@@ -243,7 +348,13 @@ static inline void maria_StoreLineRAM( ) {
       maria_dp.w += 5;
     }
 
-    if(!indirect) {
+    if(!render) {
+      maria_cycles += 3 * width; // Maria cycles (Direct graphic read)
+      if(indirect) {
+        maria_cycles += (memory_ram[CTRL] & 16)? 6 * width: 3 * width;
+      }
+    }
+    else if(!indirect) {
       maria_pp.b.h += maria_offset;
       for(int index = 0; index < width; index++) {
         maria_cycles += 3; // Maria cycles (Direct graphic read)
@@ -299,14 +410,17 @@ void maria_Reset( ) {
 
 // ----------------------------------------------------------------------------
 // RenderScanline
+// Performs the DMA for the current scanline and returns the Maria cycles.
+// The surface is only written when rendering, the cycle counts (and NMIs)
+// are identical either way.
 // ----------------------------------------------------------------------------
-uint maria_RenderScanline( ) {
+uint maria_RenderScanline(bool render) {
   maria_cycles = 0;
 
   //
   // Displays the background color when Maria is disabled (if applicable)
   //
-  if( ( ( memory_ram[CTRL] & 96 ) != 64 ) &&
+  if( render && ( ( memory_ram[CTRL] & 96 ) != 64 ) &&
       maria_scanline >= maria_visibleArea.top && 
       maria_scanline <= maria_visibleArea.bottom &&
       ( !lightgun_enabled || wii_lightgun_flash ) ) {
@@ -334,13 +448,13 @@ uint maria_RenderScanline( ) {
         sally_ExecuteNMI( );
       }
     }
-    else if(maria_scanline >= maria_visibleArea.top && maria_scanline <= maria_visibleArea.bottom) {
+    else if(render && maria_scanline >= maria_visibleArea.top && maria_scanline <= maria_visibleArea.bottom) {
       maria_WriteLineRAM(maria_surface + ((maria_scanline - maria_displayArea.top) * maria_displayArea.GetLength( )));
     }
     if(maria_scanline != maria_displayArea.bottom) {
       maria_dp.b.l = memory_ram[maria_dpp.w + 2];
       maria_dp.b.h = memory_ram[maria_dpp.w + 1];
-      maria_StoreLineRAM( );
+      maria_StoreLineRAM(render);
       maria_offset--;
       if(maria_offset < 0) {        
         maria_cycles += 10; // Maria cycles (Last line of zone) ( /*20*/ 
@@ -372,3 +486,38 @@ void maria_Clear( ) {
   }
 }
 
+// ----------------------------------------------------------------------------
+// SaveState
+// ----------------------------------------------------------------------------
+void maria_SaveState(byte* buffer, uint& offset) {
+  state_WriteBlock(buffer, offset, maria_lineRAM, MARIA_LINERAM_SIZE);
+  state_WriteUint(buffer, offset, maria_cycles);
+  state_WriteWord(buffer, offset, maria_dpp.w);
+  state_WriteWord(buffer, offset, maria_dp.w);
+  state_WriteWord(buffer, offset, maria_pp.w);
+  state_WriteByte(buffer, offset, maria_horizontal);
+  state_WriteByte(buffer, offset, maria_palette);
+  state_WriteByte(buffer, offset, maria_offset);
+  state_WriteByte(buffer, offset, maria_h08);
+  state_WriteByte(buffer, offset, maria_h16);
+  state_WriteByte(buffer, offset, maria_wmode);
+  state_WriteWord(buffer, offset, maria_scanline);
+}
+
+// ----------------------------------------------------------------------------
+// LoadState
+// ----------------------------------------------------------------------------
+void maria_LoadState(const byte* buffer, uint& offset) {
+  state_ReadBlock(buffer, offset, maria_lineRAM, MARIA_LINERAM_SIZE);
+  maria_cycles = state_ReadUint(buffer, offset);
+  maria_dpp.w = state_ReadWord(buffer, offset);
+  maria_dp.w = state_ReadWord(buffer, offset);
+  maria_pp.w = state_ReadWord(buffer, offset);
+  maria_horizontal = state_ReadByte(buffer, offset);
+  maria_palette = state_ReadByte(buffer, offset);
+  maria_offset = (signed char)state_ReadByte(buffer, offset);
+  maria_h08 = state_ReadByte(buffer, offset);
+  maria_h16 = state_ReadByte(buffer, offset);
+  maria_wmode = state_ReadByte(buffer, offset);
+  maria_scanline = state_ReadWord(buffer, offset);
+}
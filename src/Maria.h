@@ -29,8 +29,10 @@
 # else
 #define MARIA_SURFACE_SIZE 77440
 # endif
+#define MARIA_STATE_SIZE 178
 
 #include "Equates.h"
+#include "EmulatorContext.h"
 #include "Pair.h"
 #include "Memory.h"
 #include "Rect.h"
@@ -41,12 +43,14 @@ typedef unsigned short word;
 typedef unsigned int uint;
 
 extern void maria_Reset( );
-extern uint maria_RenderScanline( );
+extern uint maria_RenderScanline(bool render);
 extern void maria_Clear( );
-extern rect maria_displayArea;
-extern rect maria_visibleArea;
+extern void maria_SaveState(byte* buffer, uint& offset);
+extern void maria_LoadState(const byte* buffer, uint& offset);
+extern CONTEXT_LOCAL rect maria_displayArea;
+extern CONTEXT_LOCAL rect maria_visibleArea;
 //extern word* maria_surface;
-extern byte* maria_surface;
-extern word maria_scanline;
+extern CONTEXT_LOCAL byte* maria_surface;
+extern CONTEXT_LOCAL word maria_scanline;
 
 #endif
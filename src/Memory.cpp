@@ -23,19 +23,25 @@
 // Memory.cpp
 // ----------------------------------------------------------------------------
 
+#ifdef WII
 #include "wii_main.h"
+#endif
+#include <string.h>
 #include "Memory.h"
 #include "ExpansionModule.h"
+#include "ProSystem.h"
+#include "Stats.h"
 
 #ifdef WII_NETTRACE
 #include <network.h>
 #include "net_print.h"
 #endif
 
-byte memory_ram[MEMORY_SIZE] = {0};
-byte memory_rom[MEMORY_SIZE] = {0};
-
-int hs_sram_write_count = 0; // Debug, number of writes to High Score SRAM
+CONTEXT_LOCAL byte memory_ram[MEMORY_SIZE] = {0};
+CONTEXT_LOCAL byte memory_rom[MEMORY_SIZE] = {0};
+CONTEXT_LOCAL const byte* memory_readPages[256] = {0};
+CONTEXT_LOCAL byte* memory_writePages[256] = {0};
+CONTEXT_LOCAL memory_handler memory_writeHandlers[256] = {0};
 
 // ----------------------------------------------------------------------------
 // Reset
@@ -49,14 +55,96 @@ void memory_Reset( ) {
   for(index = 0; index < 16384; index++) {
     memory_rom[index] = 0;
   }
+  sally_InvalidateCache(0, MEMORY_SIZE);
+  memory_Map( );
+}
+
+// ----------------------------------------------------------------------------
+// WriteMirrored
+// Writes the pages of the RAM mirrored at 64-255 and 8256-8447, and at
+// 320-511 and 8512-8702
+// ----------------------------------------------------------------------------
+static void memory_WriteMirrored(word address, byte data) {
+  if((address & 255) < 64 || address == 8703) {
+    memory_WriteRegister(address, data);
+  }
+  else {
+    memory_ram[address] = data;
+    memory_ram[address ^ 8192] = data;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// MapPage
+// Maps a page for reading and writing. The pages that hold registers, the
+// mirrored RAM or the ROM are given to their handlers, which are the range
+// checks of ReadRegister and WriteRegister unless the whole page is alike.
+// ----------------------------------------------------------------------------
+static void memory_MapPage(uint page) {
+  byte* memory = memory_ram + (page << 8);
+  bool xm_mapped = cartridge_xm && xm_mem_enabled && page >= 0x40 && page < 0x80;
+  bool registers = (page == (INTIM >> 8)) ||
+                   (page == (0x0450 >> 8) && (cartridge_xm || (cartridge_pokey && cartridge_pokey450))) ||
+                   (page == (0x4000 >> 8) && cartridge_pokey && !cartridge_pokey450 && !xm_mapped);
+
+  memory_readPages[page] = memory;
+  memory_writePages[page] = NULL;
+  memory_writeHandlers[page] = memory_WriteRegister;
+
+  if(registers) {
+    memory_readPages[page] = NULL;
+  }
+  else if(xm_mapped) {
+    memory = xm_ram + (xm_bank * 0x4000) + ((page - 0x40) << 8);
+    memory_readPages[page] = memory;
+    memory_writePages[page] = memory;
+  }
+  else if(memchr(memory_rom + (page << 8), 1, 256) != NULL) {
+    if(memchr(memory_rom + (page << 8), 0, 256) == NULL) {
+      memory_writeHandlers[page] = cartridge_Write;
+    }
+  }
+  else if(page == 0x00 || page == 0x01 || page == 0x20 || page == 0x21) {
+    memory_writeHandlers[page] = memory_WriteMirrored;
+  }
+#ifdef PROSYSTEM_STATS
+  else if(page >= (0x1000 >> 8) && page <= (0x17FF >> 8)) {
+    // Left to WriteRegister, which tracks the high score SRAM writes
+  }
+#endif
+  else {
+    memory_writePages[page] = memory;
+  }
+}
 
-  // Debug, reset write count to High Score SRAM
-  hs_sram_write_count = 0;
+// ----------------------------------------------------------------------------
+// MapPages
+// Maps the pages of a range whose ROM changed
+// ----------------------------------------------------------------------------
+static void memory_MapPages(uint address, uint size) {
+  if(size != 0) {
+    for(uint page = address >> 8; page <= (address + size - 1) >> 8; page++) {
+      memory_MapPage(page);
+    }
+  }
 }
+
+// ----------------------------------------------------------------------------
+// Map
+// Maps every page for the current cartridge and expansion module
+// configuration. Must be called whenever the configuration changes.
 // ----------------------------------------------------------------------------
-// Read
+void memory_Map( ) {
+  for(uint page = 0; page < 256; page++) {
+    memory_MapPage(page);
+  }
+}
+
 // ----------------------------------------------------------------------------
-byte memory_Read(word address) {
+// ReadRegister
+// Reads the pages that are not mapped (see Map)
+// ----------------------------------------------------------------------------
+byte memory_ReadRegister(word address) {
 #if 0  
   net_print_string(NULL, 0, "Memory read: %d\n", address);    
 #endif  
@@ -80,11 +168,13 @@ byte memory_Read(word address) {
   switch ( address ) {
   case INTIM:
   case INTIM | 0x2:
+    riot_UpdateTimer( );
 	memory_ram[INTFLG] &= 0x7f;
     return memory_ram[INTIM];
 	break;
   case INTFLG:
   case INTFLG | 0x2:
+     riot_Sync( );
 	 tmp_byte = memory_ram[INTFLG];
 	 memory_ram[INTFLG] &= 0x7f;
 	 return tmp_byte; 
@@ -96,9 +186,10 @@ byte memory_Read(word address) {
 }
 
 // ----------------------------------------------------------------------------
-// Write
+// WriteRegister
+// Writes the pages that are not mapped (see Map)
 // ----------------------------------------------------------------------------
-void memory_Write(word address, byte data) {
+void memory_WriteRegister(word address, byte data) {
 #if 0  
   net_print_string(NULL, 0, "Memory write: %d, %d\n", address, data);  
 #endif  
@@ -121,18 +212,21 @@ void memory_Write(word address, byte data) {
 
   if(!memory_rom[address]) {
 
-#if 1
-// Debug, track writes to high score SRAM
-if( address >= 0x1000 && address <= 0x17FF )
-{
-  hs_sram_write_count++;
-}
+#ifdef PROSYSTEM_STATS
+    // Track the writes to the high score SRAM
+    if(address >= 0x1000 && address <= 0x17FF) {
+      STATS_ADD(hs_sram_writes, 1);
+    }
 #endif
 
     switch(address) {
       case WSYNC:
         if(!(cartridge_flags & 128)) {
           memory_ram[WSYNC] = true;
+          if(!(cartridge_flags & CARTRIDGE_WSYNC_MASK)) {
+            // End the current CPU run
+            prosystem_event = 0;
+          }
         }
         break;
       case INPTCTRL:
@@ -230,6 +324,8 @@ void memory_WriteROM(word address, uint size, const byte* data) {
       memory_ram[address + index] = data[index];
       memory_rom[address + index] = 1;
     }
+    sally_InvalidateCache(address, size);
+    memory_MapPages(address, size);
   }
 }
 
@@ -242,6 +338,8 @@ void memory_ClearROM(word address, uint size) {
       memory_ram[address + index] = 0;
       memory_rom[address + index] = 0;
     }
+    sally_InvalidateCache(address, size);
+    memory_MapPages(address, size);
   }
 }
 
@@ -27,6 +27,7 @@
 #define MEMORY_SIZE 65536
 
 #include "Equates.h"
+#include "EmulatorContext.h"
 #include "Bios.h"
 #include "Cartridge.h"
 #include "Tia.h"
@@ -37,13 +38,48 @@ typedef unsigned short word;
 typedef unsigned int uint;
 
 extern void memory_Reset( );
-extern byte memory_Read(word address);
-extern void memory_Write(word address, byte data);
+extern void memory_Map( );
+extern byte memory_ReadRegister(word address);
+extern void memory_WriteRegister(word address, byte data);
 extern void memory_WriteROM(word address, uint size, const byte* data);
 extern void memory_ClearROM(word address, uint size);
-extern byte memory_ram[MEMORY_SIZE];
-extern byte memory_rom[MEMORY_SIZE];
+extern CONTEXT_LOCAL byte memory_ram[MEMORY_SIZE];
+extern CONTEXT_LOCAL byte memory_rom[MEMORY_SIZE];
+
+// The memory each page is read from, NULL for the pages holding registers
+// (see memory_Map)
+extern CONTEXT_LOCAL const byte* memory_readPages[256];
+
+// The memory each page is written to, NULL for the pages written by their
+// handler (the mirrored RAM, the ROM and the registers)
+typedef void (*memory_handler)(word address, byte data);
+extern CONTEXT_LOCAL byte* memory_writePages[256];
+extern CONTEXT_LOCAL memory_handler memory_writeHandlers[256];
 
 extern "C" byte* get_memory_ram();
 
+// ----------------------------------------------------------------------------
+// Read
+// ----------------------------------------------------------------------------
+static inline byte memory_Read(word address) {
+  const byte* page = memory_readPages[address >> 8];
+  if(page != NULL) {
+    return page[address & 255];
+  }
+  return memory_ReadRegister(address);
+}
+
+// ----------------------------------------------------------------------------
+// Write
+// ----------------------------------------------------------------------------
+static inline void memory_Write(word address, byte data) {
+  byte* page = memory_writePages[address >> 8];
+  if(page != NULL) {
+    page[address & 255] = data;
+  }
+  else {
+    memory_writeHandlers[address >> 8](address, data);
+  }
+}
+
 #endif
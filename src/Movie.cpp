@@ -0,0 +1,440 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Movie.cpp
+// Records the input of each frame, run-length encoded, along with a state of
+// the machine (a keyframe) every interval frames. The first keyframe is the
+// state the recording started from, playback restores it and replays the
+// input, which reproduces the recording exactly. Seeking restores the nearest
+// keyframe and emulates the remaining frames without rendering (the sound
+// generators still run, so that the audio matches).
+//
+// The file holds a header, the digest of the cartridge, the interval, the
+// length (frames), the runs (count and input) and the keyframes (frame, size
+// and state), all values big-endian.
+// ----------------------------------------------------------------------------
+#include <malloc.h>
+#include <string.h>
+#include "Movie.h"
+#include "ProSystem.h"
+#include "State.h"
+
+#define MOVIE_SOURCE "Movie.cpp"
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 53
+#define MOVIE_RUN_SIZE (4 + MOVIE_INPUT_SIZE)
+
+typedef struct {
+  uint count;
+  byte input[MOVIE_INPUT_SIZE];
+} movie_run;
+
+typedef struct {
+  uint frame;
+  uint size;
+  byte* state;
+} movie_keyframe;
+
+CONTEXT_LOCAL byte movie_mode = MOVIE_MODE_NONE;
+CONTEXT_LOCAL uint movie_frame = 0;
+CONTEXT_LOCAL uint movie_length = 0;
+
+static CONTEXT_LOCAL movie_run* movie_runs = NULL;
+static CONTEXT_LOCAL uint movie_runCount = 0;
+static CONTEXT_LOCAL uint movie_runMax = 0;
+static CONTEXT_LOCAL movie_keyframe* movie_keyframes = NULL;
+static CONTEXT_LOCAL uint movie_keyframeCount = 0;
+static CONTEXT_LOCAL uint movie_keyframeMax = 0;
+static CONTEXT_LOCAL uint movie_interval = MOVIE_DEFAULT_INTERVAL;
+static CONTEXT_LOCAL std::string movie_digest;
+
+// The position of playback within the runs
+static CONTEXT_LOCAL uint movie_cursor = 0;
+static CONTEXT_LOCAL uint movie_cursorFrame = 0;
+
+// ----------------------------------------------------------------------------
+// AddRun
+// ----------------------------------------------------------------------------
+static bool movie_AddRun(uint count, const byte* input) {
+  if(movie_runCount == movie_runMax) {
+    uint max = movie_runMax? movie_runMax * 2: 256;
+    movie_run* runs = (movie_run*)realloc(movie_runs, max * sizeof(movie_run));
+    if(runs == NULL) {
+      logger_LogError("Failed to allocate the movie input.", MOVIE_SOURCE);
+      return false;
+    }
+    movie_runs = runs;
+    movie_runMax = max;
+  }
+  movie_runs[movie_runCount].count = count;
+  memcpy(movie_runs[movie_runCount].input, input, MOVIE_INPUT_SIZE);
+  movie_runCount++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// AddKeyframe
+// Adds a keyframe of the specified size (bytes), the state is copied from the
+// buffer or, when it is NULL, saved from the machine.
+// ----------------------------------------------------------------------------
+static bool movie_AddKeyframe(uint frame, const byte* buffer, uint size) {
+  if(movie_keyframeCount == movie_keyframeMax) {
+    uint max = movie_keyframeMax? movie_keyframeMax * 2: 16;
+    movie_keyframe* keyframes = (movie_keyframe*)realloc(movie_keyframes, max * sizeof(movie_keyframe));
+    if(keyframes == NULL) {
+      logger_LogError("Failed to allocate the movie keyframes.", MOVIE_SOURCE);
+      return false;
+    }
+    movie_keyframes = keyframes;
+    movie_keyframeMax = max;
+  }
+
+  byte* state = (byte*)malloc(size);
+  if(state == NULL) {
+    logger_LogError("Failed to allocate the movie keyframe.", MOVIE_SOURCE);
+    return false;
+  }
+  if(buffer != NULL) {
+    memcpy(state, buffer, size);
+  }
+  else if(!prosystem_SaveToBuffer(state, size)) {
+    free(state);
+    return false;
+  }
+
+  movie_keyframe* keyframe = &movie_keyframes[movie_keyframeCount++];
+  keyframe->frame = frame;
+  keyframe->size = size;
+  keyframe->state = state;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void movie_Release( ) {
+  for(uint index = 0; index < movie_keyframeCount; index++) {
+    free(movie_keyframes[index].state);
+  }
+  free(movie_keyframes);
+  free(movie_runs);
+  movie_keyframes = NULL;
+  movie_keyframeCount = 0;
+  movie_keyframeMax = 0;
+  movie_runs = NULL;
+  movie_runCount = 0;
+  movie_runMax = 0;
+  movie_mode = MOVIE_MODE_NONE;
+  movie_frame = 0;
+  movie_length = 0;
+  movie_cursor = 0;
+  movie_cursorFrame = 0;
+  movie_digest = "";
+}
+
+// ----------------------------------------------------------------------------
+// Record
+// Starts recording from the current state of the machine, with a keyframe
+// every interval frames.
+// ----------------------------------------------------------------------------
+bool movie_Record(uint interval) {
+  movie_Release( );
+  movie_interval = interval? interval: MOVIE_DEFAULT_INTERVAL;
+  movie_digest = cartridge_digest;
+  if(!movie_AddKeyframe(0, NULL, prosystem_GetStateSize( ))) {
+    movie_Release( );
+    return false;
+  }
+  movie_mode = MOVIE_MODE_RECORD;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Play
+// Plays the movie from the start.
+// ----------------------------------------------------------------------------
+bool movie_Play( ) {
+  return movie_Seek(0);
+}
+
+// ----------------------------------------------------------------------------
+// Seek
+// Restores the machine to the start of the specified frame and plays the
+// movie from there.
+// ----------------------------------------------------------------------------
+bool movie_Seek(uint frame) {
+  if(movie_keyframeCount == 0 || frame > movie_length) {
+    logger_LogError("Movie frame is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+  if(movie_digest != cartridge_digest) {
+    logger_LogError("Movie was recorded with another cartridge.", MOVIE_SOURCE);
+    return false;
+  }
+
+  uint index = movie_keyframeCount - 1;
+  while(movie_keyframes[index].frame > frame) {
+    index--;
+  }
+  const movie_keyframe* keyframe = &movie_keyframes[index];
+  if(!prosystem_LoadFromBuffer(keyframe->state, keyframe->size)) {
+    return false;
+  }
+
+  movie_mode = MOVIE_MODE_PLAY;
+  movie_frame = 0;
+  movie_cursor = 0;
+  movie_cursorFrame = 0;
+  while(movie_cursor < movie_runCount && movie_frame + movie_runs[movie_cursor].count <= keyframe->frame) {
+    movie_frame += movie_runs[movie_cursor++].count;
+  }
+  movie_cursorFrame = keyframe->frame - movie_frame;
+  movie_frame = keyframe->frame;
+
+  byte input[MOVIE_INPUT_SIZE];
+  while(movie_frame < frame) {
+    movie_Input(input);
+    prosystem_SeekFrame(input);
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Input
+// Called prior to each frame with its input. When recording, the input is
+// stored. When playing, it is replaced with the recorded input; false is
+// returned (and playback stops) at the end of the movie.
+// ----------------------------------------------------------------------------
+bool movie_Input(byte* input) {
+  if(movie_mode == MOVIE_MODE_RECORD) {
+    if(movie_frame && movie_frame % movie_interval == 0) {
+      if(!movie_AddKeyframe(movie_frame, NULL, movie_keyframes[0].size)) {
+        movie_mode = MOVIE_MODE_NONE;
+        return false;
+      }
+    }
+    movie_run* last = movie_runCount? &movie_runs[movie_runCount - 1]: NULL;
+    if(last != NULL && !memcmp(last->input, input, MOVIE_INPUT_SIZE)) {
+      last->count++;
+    }
+    else if(!movie_AddRun(1, input)) {
+      movie_mode = MOVIE_MODE_NONE;
+      return false;
+    }
+    movie_length = ++movie_frame;
+    return true;
+  }
+
+  if(movie_mode == MOVIE_MODE_PLAY) {
+    if(movie_frame >= movie_length) {
+      movie_mode = MOVIE_MODE_NONE;
+      return false;
+    }
+    memcpy(input, movie_runs[movie_cursor].input, MOVIE_INPUT_SIZE);
+    if(++movie_cursorFrame == movie_runs[movie_cursor].count) {
+      movie_cursor++;
+      movie_cursorFrame = 0;
+    }
+    movie_frame++;
+    return true;
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Stop
+// Stops recording or playback, the movie is kept.
+// ----------------------------------------------------------------------------
+void movie_Stop( ) {
+  movie_mode = MOVIE_MODE_NONE;
+}
+
+// ----------------------------------------------------------------------------
+// Save
+// ----------------------------------------------------------------------------
+bool movie_Save(std::string filename) {
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+  if(movie_keyframeCount == 0) {
+    logger_LogError("No movie has been recorded.", MOVIE_SOURCE);
+    return false;
+  }
+
+  uint size = MOVIE_HEADER_SIZE + 16 + movie_runCount * MOVIE_RUN_SIZE;
+  for(uint index = 0; index < movie_keyframeCount; index++) {
+    size += 8 + movie_keyframes[index].size;
+  }
+  byte* buffer = (byte*)malloc(size);
+  if(buffer == NULL) {
+    logger_LogError("Failed to allocate the movie buffer.", MOVIE_SOURCE);
+    return false;
+  }
+
+  uint offset = 0;
+  state_WriteBlock(buffer, offset, "PRO-SYSTEM MOVIE", 16);
+  state_WriteByte(buffer, offset, MOVIE_VERSION);
+  byte digest[32] = {0};
+  memcpy(digest, movie_digest.c_str( ), movie_digest.length( ) < 32? movie_digest.length( ): 32);
+  state_WriteBlock(buffer, offset, digest, 32);
+  state_WriteUint(buffer, offset, movie_interval);
+  state_WriteUint(buffer, offset, movie_length);
+  state_WriteUint(buffer, offset, movie_runCount);
+  for(uint index = 0; index < movie_runCount; index++) {
+    state_WriteUint(buffer, offset, movie_runs[index].count);
+    state_WriteBlock(buffer, offset, movie_runs[index].input, MOVIE_INPUT_SIZE);
+  }
+  state_WriteUint(buffer, offset, movie_keyframeCount);
+  for(uint index = 0; index < movie_keyframeCount; index++) {
+    state_WriteUint(buffer, offset, movie_keyframes[index].frame);
+    state_WriteUint(buffer, offset, movie_keyframes[index].size);
+    state_WriteBlock(buffer, offset, movie_keyframes[index].state, movie_keyframes[index].size);
+  }
+
+  logger_LogInfo("Saving movie to file " + filename + ".");
+  FILE* file = fopen(filename.c_str( ), "wb");
+  if(file == NULL) {
+    free(buffer);
+    logger_LogError("Failed to open the file " + filename + " for writing.", MOVIE_SOURCE);
+    return false;
+  }
+  bool written = (fwrite(buffer, 1, size, file) == size);
+  fclose(file);
+  free(buffer);
+  if(!written) {
+    logger_LogError("Failed to write the movie data to the file " + filename + ".", MOVIE_SOURCE);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Parse
+// ----------------------------------------------------------------------------
+static bool movie_Parse(const byte* buffer, uint size) {
+  uint offset = 0;
+  if(size < MOVIE_HEADER_SIZE + 12 || memcmp(buffer, "PRO-SYSTEM MOVIE", 16)) {
+    logger_LogError("Movie file is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+  offset += 16;
+  if(state_ReadByte(buffer, offset) != MOVIE_VERSION) {
+    logger_LogError("Movie file version is not supported.", MOVIE_SOURCE);
+    return false;
+  }
+  char digest[33] = {0};
+  state_ReadBlock(buffer, offset, digest, 32);
+  movie_digest = digest;
+  movie_interval = state_ReadUint(buffer, offset);
+  movie_length = state_ReadUint(buffer, offset);
+
+  uint runCount = state_ReadUint(buffer, offset);
+  if(runCount > (size - offset) / MOVIE_RUN_SIZE) {
+    logger_LogError("Movie input is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+  uint frames = 0;
+  for(uint index = 0; index < runCount; index++) {
+    uint count = state_ReadUint(buffer, offset);
+    if(count == 0 || !movie_AddRun(count, buffer + offset)) {
+      logger_LogError("Movie input is invalid.", MOVIE_SOURCE);
+      return false;
+    }
+    offset += MOVIE_INPUT_SIZE;
+    frames += count;
+  }
+  if(frames != movie_length || size - offset < 4) {
+    logger_LogError("Movie input is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+
+  uint keyframeCount = state_ReadUint(buffer, offset);
+  for(uint index = 0; index < keyframeCount; index++) {
+    if(size - offset < 8) {
+      logger_LogError("Movie keyframe is invalid.", MOVIE_SOURCE);
+      return false;
+    }
+    uint frame = state_ReadUint(buffer, offset);
+    uint length = state_ReadUint(buffer, offset);
+    bool ordered = (index == 0)? frame == 0: frame > movie_keyframes[index - 1].frame;
+    if(!ordered || frame > movie_length || length > size - offset || !movie_AddKeyframe(frame, buffer + offset, length)) {
+      logger_LogError("Movie keyframe is invalid.", MOVIE_SOURCE);
+      return false;
+    }
+    offset += length;
+  }
+  if(keyframeCount == 0) {
+    logger_LogError("Movie has no keyframes.", MOVIE_SOURCE);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Load
+// Loads a movie, playback is started with movie_Play.
+// ----------------------------------------------------------------------------
+bool movie_Load(std::string filename) {
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", MOVIE_SOURCE);
+    return false;
+  }
+  movie_Release( );
+
+  logger_LogInfo("Loading movie from file " + filename + ".");
+  FILE* file = fopen(filename.c_str( ), "rb");
+  if(file == NULL) {
+    logger_LogError("Failed to open the file " + filename + " for reading.", MOVIE_SOURCE);
+    return false;
+  }
+  if(fseek(file, 0, SEEK_END)) {
+    fclose(file);
+    logger_LogError("Failed to find the end of the file.", MOVIE_SOURCE);
+    return false;
+  }
+  long size = ftell(file);
+  if(size <= 0 || fseek(file, 0, SEEK_SET)) {
+    fclose(file);
+    logger_LogError("Failed to find the size of the file.", MOVIE_SOURCE);
+    return false;
+  }
+
+  byte* buffer = (byte*)malloc(size);
+  if(buffer == NULL) {
+    fclose(file);
+    logger_LogError("Failed to allocate the movie buffer.", MOVIE_SOURCE);
+    return false;
+  }
+  if(fread(buffer, 1, size, file) != (size_t)size) {
+    fclose(file);
+    free(buffer);
+    logger_LogError("Failed to read the file data.", MOVIE_SOURCE);
+    return false;
+  }
+  fclose(file);
+
+  bool parsed = movie_Parse(buffer, size);
+  free(buffer);
+  if(!parsed) {
+    movie_Release( );
+  }
+  return parsed;
+}
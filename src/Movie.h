@@ -0,0 +1,55 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Movie.h
+// ----------------------------------------------------------------------------
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <string>
+#include "EmulatorContext.h"
+#include "Logger.h"
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+
+// The size of the input of a frame (see riot_SetInput)
+#define MOVIE_INPUT_SIZE 19
+// The default count of frames between keyframes
+#define MOVIE_DEFAULT_INTERVAL 600
+
+#define MOVIE_MODE_NONE 0
+#define MOVIE_MODE_RECORD 1
+#define MOVIE_MODE_PLAY 2
+
+extern bool movie_Record(uint interval);
+extern bool movie_Play( );
+extern bool movie_Seek(uint frame);
+extern bool movie_Input(byte* input);
+extern void movie_Stop( );
+extern bool movie_Save(std::string filename);
+extern bool movie_Load(std::string filename);
+extern void movie_Release( );
+extern CONTEXT_LOCAL byte movie_mode;
+extern CONTEXT_LOCAL uint movie_frame;
+extern CONTEXT_LOCAL uint movie_length;
+
+#endif
@@ -45,9 +45,14 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#ifdef WII
 #include <SDL.h>
+#endif
 #include "Pokey.h"
 #include "ProSystem.h"
+#include "State.h"
+#include "Stats.h"
 #define POKEY_NOTPOLY5 0x80
 #define POKEY_POLY4 0x40
 #define POKEY_PURE 0x20
@@ -67,6 +72,7 @@
 #define POKEY_POLY5_SIZE 0x001f
 #define POKEY_POLY9_SIZE 0x01ff
 #define POKEY_POLY17_SIZE 0x0001ffff
+#define POKEY_POLY17_SEED 1
 #define POKEY_CHANNEL1 0
 #define POKEY_CHANNEL2 1
 #define POKEY_CHANNEL3 2
@@ -75,47 +81,47 @@
 
 #define SK_RESET	0x03
 
-byte pokey_buffer[POKEY_BUFFER_SIZE] = {0};
-uint pokey_size = (POKEY_BUFFER_SIZE - 512); // 524
-
-static uint pokey_frequency = 1787520;
-static uint pokey_sampleRate = 31440;
-static uint pokey_soundCntr = 0;
-static byte pokey_audf[4];
-static byte pokey_audc[4];
-static byte pokey_audctl;
-static byte pokey_output[4];
-static byte pokey_outVol[4];
+CONTEXT_LOCAL byte pokey_buffer[POKEY_BUFFER_SIZE] = {0};
+CONTEXT_LOCAL uint pokey_size = (POKEY_BUFFER_SIZE - 512); // 524
+
+static CONTEXT_LOCAL uint pokey_frequency = 1787520;
+static CONTEXT_LOCAL uint pokey_sampleRate = 31440;
+static CONTEXT_LOCAL uint pokey_soundCntr = 0;
+static CONTEXT_LOCAL byte pokey_audf[4];
+static CONTEXT_LOCAL byte pokey_audc[4];
+static CONTEXT_LOCAL byte pokey_audctl;
+static CONTEXT_LOCAL byte pokey_output[4];
+static CONTEXT_LOCAL byte pokey_outVol[4];
 static byte pokey_poly04[POKEY_POLY4_SIZE] = {1,1,0,1,1,1,0,0,0,0,1,0,1,0,0};
 static byte pokey_poly05[POKEY_POLY5_SIZE] = {0,0,1,1,0,0,0,1,1,1,1,0,0,1,0,1,0,1,1,0,1,1,1,0,1,0,0,0,0,0,1};
-static byte pokey_poly17[POKEY_POLY17_SIZE];
-static uint pokey_poly17Size;
-static uint pokey_polyAdjust;
-static uint pokey_poly04Cntr;
-static uint pokey_poly05Cntr;
-static uint pokey_poly17Cntr;
-static uint pokey_divideMax[4];
-static uint pokey_divideCount[4];
-static uint pokey_sampleMax;
-static uint pokey_sampleCount[2];
-static uint pokey_baseMultiplier;
-
-static byte rand9[0x1ff];
-static byte rand17[0x1ffff];
-static uint r9;
-static uint r17;
-static byte SKCTL;
-byte RANDOM;
+static CONTEXT_LOCAL byte pokey_poly17[POKEY_POLY17_SIZE];
+static CONTEXT_LOCAL uint pokey_poly17Size;
+static CONTEXT_LOCAL uint pokey_polyAdjust;
+static CONTEXT_LOCAL uint pokey_poly04Cntr;
+static CONTEXT_LOCAL uint pokey_poly05Cntr;
+static CONTEXT_LOCAL uint pokey_poly17Cntr;
+static CONTEXT_LOCAL uint pokey_divideMax[4];
+static CONTEXT_LOCAL uint pokey_divideCount[4];
+static CONTEXT_LOCAL uint pokey_sampleMax;
+static CONTEXT_LOCAL uint pokey_sampleCount[2];
+static CONTEXT_LOCAL uint pokey_baseMultiplier;
+
+static CONTEXT_LOCAL byte rand9[0x1ff];
+static CONTEXT_LOCAL byte rand17[0x1ffff];
+static CONTEXT_LOCAL uint r9;
+static CONTEXT_LOCAL uint r17;
+static CONTEXT_LOCAL byte SKCTL;
+CONTEXT_LOCAL byte RANDOM;
 
 #ifdef WII_NETTRACE
 int pokey_debug_count = 100;
 #endif
 
-byte POT_input[8] = {228, 228, 228, 228, 228, 228, 228, 228};
-static int pot_scanline;
+CONTEXT_LOCAL byte POT_input[8] = {228, 228, 228, 228, 228, 228, 228, 228};
+static CONTEXT_LOCAL int pot_scanline;
 
-static ullong random_scanline_counter;
-static ullong prev_random_scanline_counter;
+static CONTEXT_LOCAL ullong random_scanline_counter;
+static CONTEXT_LOCAL ullong prev_random_scanline_counter;
 
 static void rand_init(byte *rng, int size, int left, int right, int add)
 {
@@ -149,9 +155,19 @@ void pokey_Reset( ) {
 	pot_scanline = 0;
   pokey_soundCntr = 0;
 
+#ifdef WII
+  // The Wii runs a single machine, it keeps the noise it always had
   for(int index = 0; index < POKEY_POLY17_SIZE; index++) {
     pokey_poly17[index] = rand( ) & 1;
   }
+#else
+  // Fixed seed, rand( ) is shared between threads and differs per platform
+  uint seed = POKEY_POLY17_SEED;
+  for(int index = 0; index < POKEY_POLY17_SIZE; index++) {
+    seed = seed * 1103515245 + 12345;
+    pokey_poly17[index] = (seed >> 16) & 1;
+  }
+#endif
   pokey_polyAdjust = 0;
   pokey_poly04Cntr = 0;
   pokey_poly05Cntr = 0;
@@ -272,6 +288,7 @@ void pokey_SetRegister(word address, byte value) {
 #endif
 
 	byte channelMask;
+  STATS_ADD(pokey_writes, 1);
   switch(address) {
     case POKEY_POTGO:
       if (!(SKCTL & 4))
@@ -534,3 +551,71 @@ void pokey_Clear( ) {
   pokey_soundCntr = 0;
   memset(pokey_buffer, 0, POKEY_BUFFER_SIZE);
 }
+
+// ----------------------------------------------------------------------------
+// SaveState
+// ----------------------------------------------------------------------------
+void pokey_SaveState(byte* buffer, uint& offset) {
+  for(int channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
+    state_WriteByte(buffer, offset, pokey_audf[channel]);
+    state_WriteByte(buffer, offset, pokey_audc[channel]);
+    state_WriteByte(buffer, offset, pokey_output[channel]);
+    state_WriteByte(buffer, offset, pokey_outVol[channel]);
+    state_WriteUint(buffer, offset, pokey_divideMax[channel]);
+    state_WriteUint(buffer, offset, pokey_divideCount[channel]);
+  }
+  state_WriteByte(buffer, offset, pokey_audctl);
+  state_WriteUint(buffer, offset, pokey_poly17Size);
+  state_WriteUint(buffer, offset, pokey_polyAdjust);
+  state_WriteUint(buffer, offset, pokey_poly04Cntr);
+  state_WriteUint(buffer, offset, pokey_poly05Cntr);
+  state_WriteUint(buffer, offset, pokey_poly17Cntr);
+  state_WriteUint(buffer, offset, pokey_sampleMax);
+  state_WriteUint(buffer, offset, pokey_sampleCount[0]);
+  state_WriteUint(buffer, offset, pokey_sampleCount[1]);
+  state_WriteUint(buffer, offset, pokey_baseMultiplier);
+  state_WriteUint(buffer, offset, r9);
+  state_WriteUint(buffer, offset, r17);
+  state_WriteByte(buffer, offset, SKCTL);
+  state_WriteByte(buffer, offset, RANDOM);
+  state_WriteUint(buffer, offset, pot_scanline);
+  state_WriteUint(buffer, offset, random_scanline_counter >> 32);
+  state_WriteUint(buffer, offset, random_scanline_counter);
+  state_WriteUint(buffer, offset, prev_random_scanline_counter >> 32);
+  state_WriteUint(buffer, offset, prev_random_scanline_counter);
+  state_WriteUint(buffer, offset, pokey_soundCntr);
+}
+
+// ----------------------------------------------------------------------------
+// LoadState
+// ----------------------------------------------------------------------------
+void pokey_LoadState(const byte* buffer, uint& offset) {
+  for(int channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
+    pokey_audf[channel] = state_ReadByte(buffer, offset);
+    pokey_audc[channel] = state_ReadByte(buffer, offset);
+    pokey_output[channel] = state_ReadByte(buffer, offset);
+    pokey_outVol[channel] = state_ReadByte(buffer, offset);
+    pokey_divideMax[channel] = state_ReadUint(buffer, offset);
+    pokey_divideCount[channel] = state_ReadUint(buffer, offset);
+  }
+  pokey_audctl = state_ReadByte(buffer, offset);
+  pokey_poly17Size = state_ReadUint(buffer, offset);
+  pokey_polyAdjust = state_ReadUint(buffer, offset);
+  pokey_poly04Cntr = state_ReadUint(buffer, offset);
+  pokey_poly05Cntr = state_ReadUint(buffer, offset);
+  pokey_poly17Cntr = state_ReadUint(buffer, offset);
+  pokey_sampleMax = state_ReadUint(buffer, offset);
+  pokey_sampleCount[0] = state_ReadUint(buffer, offset);
+  pokey_sampleCount[1] = state_ReadUint(buffer, offset);
+  pokey_baseMultiplier = state_ReadUint(buffer, offset);
+  r9 = state_ReadUint(buffer, offset) % 0x1ff;
+  r17 = state_ReadUint(buffer, offset) % 0x1ffff;
+  SKCTL = state_ReadByte(buffer, offset);
+  RANDOM = state_ReadByte(buffer, offset);
+  pot_scanline = (int)state_ReadUint(buffer, offset);
+  random_scanline_counter = (ullong)state_ReadUint(buffer, offset) << 32;
+  random_scanline_counter |= state_ReadUint(buffer, offset);
+  prev_random_scanline_counter = (ullong)state_ReadUint(buffer, offset) << 32;
+  prev_random_scanline_counter |= state_ReadUint(buffer, offset);
+  pokey_soundCntr = state_ReadUint(buffer, offset) % pokey_size;
+}
@@ -42,6 +42,7 @@
 #define POKEY_H
 //#define POKEY_BUFFER_SIZE 624
 #define POKEY_BUFFER_SIZE 2048 // WII
+#define POKEY_STATE_SIZE 119
 #define POKEY_AUDF1 0x4000
 #define POKEY_AUDC1 0x4001
 #define POKEY_AUDF2 0x4002
@@ -74,6 +75,8 @@
 #define POKEY_SKSTAT 0x400f
 
 
+#include "EmulatorContext.h"
+
 typedef unsigned char byte;
 typedef unsigned short word;
 typedef unsigned int uint;
@@ -83,11 +86,13 @@ extern void pokey_SetRegister(word address, byte value);
 extern byte pokey_GetRegister(word address);
 extern void pokey_Process(uint length);
 extern void pokey_Clear( );
-extern byte pokey_buffer[POKEY_BUFFER_SIZE];
-extern uint pokey_size;
+extern CONTEXT_LOCAL byte pokey_buffer[POKEY_BUFFER_SIZE];
+extern CONTEXT_LOCAL uint pokey_size;
 
 extern void pokey_Frame(); 
 extern void pokey_Scanline();
 extern void pokey_setSampleRate( uint rate );
+extern void pokey_SaveState(byte* buffer, uint& offset);
+extern void pokey_LoadState(const byte* buffer, uint& offset);
 
 #endif
@@ -23,14 +23,25 @@
 // ProSystem.cpp
 // ----------------------------------------------------------------------------
 #include <malloc.h>
+#include <string.h>
 #include "ProSystem.h"
 #include "Sound.h"
 #include "Riot.h"
 #include "Pokey.h"
+#include "Jit.h"
+#include "Profile.h"
+#include "State.h"
+#include "Stats.h"
 
+#ifdef WII
 #include "wii_main.h"
 #include "wii_sdl.h"
 #include "wii_atari.h"
+#else
+extern CONTEXT_LOCAL int lightgun_scanline;
+extern CONTEXT_LOCAL float lightgun_cycle;
+extern CONTEXT_LOCAL bool lightgun_enabled;
+#endif
 
 #ifdef WII_NETTRACE
 #include <network.h>
@@ -40,16 +51,12 @@
 #define PRO_SYSTEM_SOURCE "ProSystem.cpp"
 #define PRO_SYSTEM_STATE_HEADER "PRO-SYSTEM STATE"
 
-bool prosystem_active = false;
-bool prosystem_paused = false;
-word prosystem_frequency = 60;
-byte prosystem_frame = 0;
-word prosystem_scanlines = 262;
-uint prosystem_cycles = 0;
-
-// Whether the last CPU operation resulted in a half cycle (need to take it
-// into consideration)
-extern bool half_cycle;
+CONTEXT_LOCAL bool prosystem_active = false;
+CONTEXT_LOCAL bool prosystem_paused = false;
+CONTEXT_LOCAL word prosystem_frequency = 60;
+CONTEXT_LOCAL byte prosystem_frame = 0;
+CONTEXT_LOCAL word prosystem_scanlines = 262;
+CONTEXT_LOCAL uint prosystem_cycles = 0;
 
 #ifdef LOWTRACE
 static char msg[512];
@@ -82,6 +89,8 @@ void prosystem_Reset( ) {
     }
     // Load the high score cartridge
     cartridge_LoadHighScoreCart();
+    stats_Reset( );
+    profile_Reset( );
     prosystem_cycles = sally_ExecuteRES( );
     prosystem_active = true;
   }
@@ -104,46 +113,103 @@ static void prosystem_FireLightGun()
     }      
 }
 
-uint prosystem_extra_cycles = 0;
-uint dbg_saved_cycles = 0;
-uint dbg_wsync_count = 0;
-uint dbg_maria_cycles = 0;
-uint dbg_p6502_cycles = 0;
-bool dbg_wsync;
-bool dbg_cycle_stealing;
+CONTEXT_LOCAL uint prosystem_extra_cycles = 0;
 
 // ----------------------------------------------------------------------------
-// ExecuteFrame
+// Run
+// Runs the CPU until the cycle count reaches the specified cycle. Rather than
+// polling after every instruction, the CPU runs uninterrupted up to the next
+// event: the specified cycle (end of HBLANK/start of Maria DMA or end of the
+// scanline), the RIOT timer expiry or the lightgun hit window. A write to
+// WSYNC ends the run early (see memory_Write). Returns whether a WSYNC was
+// performed. Instantiated for the features of the frame (see Frame).
 // ----------------------------------------------------------------------------
+CONTEXT_LOCAL uint prosystem_event = 0;
 
-#if 0
-extern float wii_orient_roll;
+template<bool wsync, bool lightgun>
+static inline bool prosystem_Run(uint cycle)
+{
+    STATS_START(cpu_start);
+    while( prosystem_cycles < cycle ) 
+    {
+#ifdef PROSYSTEM_STATS
+        uint start = prosystem_cycles;
 #endif
 
-void prosystem_ExecuteFrame(const byte* input) 
-{
-    // Is WSYNC enabled for the current frame?
-    bool wsync = !( cartridge_flags & CARTRIDGE_WSYNC_MASK );
-    dbg_wsync = wsync;
+        prosystem_event = cycle;
 
-    // Is Maria cycle stealing enabled for the current frame?
-    bool cycle_stealing = !( cartridge_flags & CARTRIDGE_CYCLE_STEALING_MASK );
-    dbg_cycle_stealing = cycle_stealing;
+        uint event = riot_GetEvent( );
+        if( event < prosystem_event ) 
+        {
+            prosystem_event = event;
+        }
 
-    // Is the lightgun enabled for the current frame?
-    bool lightgun = 
-        ( lightgun_enabled && ( memory_ram[CTRL] & 96 ) != 64 );
+        // The lightgun fires once the cycle threshold is reached within the
+        // scanline window (it is reset at the start of each scanline)
+        if( lightgun && ( memory_ram[INPT4] & 0x80 ) &&
+            ( maria_scanline >= lightgun_scanline ) && 
+            ( maria_scanline <= ( lightgun_scanline + 3 ) ) )
+        {
+            event = ((int)lightgun_cycle ) - 1;
+            if( event < prosystem_event ) 
+            {
+                prosystem_event = event;
+            }
+        }
 
-    riot_SetInput(input);
+        // Always execute at least one instruction
+        if( prosystem_event <= prosystem_cycles ) 
+        {
+            prosystem_event = prosystem_cycles + 1;
+        }
 
-    prosystem_extra_cycles = 0;
-    dbg_saved_cycles = 0; // debug
-    dbg_wsync_count = 0;  // debug
-    dbg_maria_cycles = 0; // debug
-    dbg_p6502_cycles = 0; // debug    
+#ifdef PROSYSTEM_JIT
+        // The translated code runs up to the event, the interpreter
+        // executes what it can't translate
+        while( prosystem_cycles < prosystem_event ) 
+        {
+            if( !jit_Execute( ) ) 
+            {
+                sally_Run( true );
+            }
+        }
+#else
+        sally_Run( false );
+#endif
+
+        STATS_ADD(cpu_cycles, prosystem_cycles - start);
+
+        if( riot_timing ) riot_Sync( );
+
+        // If lightgun is enabled, check to see if it should be fired
+        if( lightgun ) prosystem_FireLightGun();
+
+        if( memory_ram[WSYNC] && wsync ) 
+        {
+            STATS_ADD(wsync_count, 1);
+            STATS_STOP(cpu_ns, cpu_start);
+            memory_ram[WSYNC] = false;
+            return true;
+        }      
+    }
+    STATS_STOP(cpu_ns, cpu_start);
+    return false;
+}
 
-    if( cartridge_pokey || cartridge_xm ) pokey_Frame();
+// ----------------------------------------------------------------------------
+// Scanlines
+// Emulates the scanlines of a frame. Instantiated for each combination of
+// the features that are fixed for a frame, so that the frames without them
+// don't test for them on every scanline and CPU run.
+// ----------------------------------------------------------------------------
+
+#if 0
+extern float wii_orient_roll;
+#endif
 
+template<bool wsync, bool cycle_stealing, bool lightgun, bool pokey>
+static void prosystem_Scanlines(bool video, bool audio) 
+{
     for( maria_scanline = 1; maria_scanline <= prosystem_scanlines; maria_scanline++ ) 
     {
 #if 0      
@@ -178,193 +244,599 @@ void prosystem_ExecuteFrame(const byte* input)
         else
         {
             prosystem_extra_cycles = ( prosystem_cycles % CYCLES_PER_SCANLINE );
-            dbg_saved_cycles += prosystem_extra_cycles;            
+            STATS_ADD(saved_cycles, prosystem_extra_cycles);
 
             // Some fudge for Maria cycles. Unfortunately Maria cycle counting
             // isn't exact (This adds some extra cycles).
             prosystem_cycles = 0;        
         }
+        riot_Rebase( );
 
         // If lightgun is enabled, check to see if it should be fired
         if( lightgun ) prosystem_FireLightGun();
 
-        while( prosystem_cycles < cartridge_hblank ) 
-        {
-            cycles = sally_ExecuteInstruction( );
-            prosystem_cycles += (cycles << 2 );
-            if( half_cycle ) prosystem_cycles += 2;
-
-            dbg_p6502_cycles += ( cycles << 2 ); // debug
+        // Run until the end of HBLANK (start of Maria DMA)
+        wsync_scanline = prosystem_Run<wsync, lightgun>( cartridge_hblank );
 
-            if( riot_timing ) 
-            {
-                riot_UpdateTimer( cycles );
-            }
-
-            // If lightgun is enabled, check to see if it should be fired
-            if( lightgun ) prosystem_FireLightGun();
-
-            if( memory_ram[WSYNC] && wsync ) 
-            {
-                dbg_wsync_count++; // debug
-                memory_ram[WSYNC] = false;
-                wsync_scanline = true;
-                break;
-            }      
-        }    
-
-        cycles = maria_RenderScanline();    
+        STATS_START(maria_start);
+        cycles = maria_RenderScanline(video);    
+        STATS_STOP(maria_ns, maria_start);
 
         if( cycle_stealing ) 
         {
+            riot_Sync( );
             prosystem_cycles += cycles;            
-            dbg_maria_cycles += cycles; // debug
-
-            if( riot_timing ) 
-            {
-                riot_UpdateTimer( cycles >> 2 );
-            }
+            STATS_ADD(maria_cycles, cycles);
+            riot_Advance( (byte)( cycles >> 2 ) );
         }
 
-        while( !wsync_scanline && prosystem_cycles < CYCLES_PER_SCANLINE ) 
+        // Run until the end of the scanline
+        if( !wsync_scanline ) 
         {
-            cycles = sally_ExecuteInstruction( );            
-            prosystem_cycles += ( cycles << 2 );
-            if( half_cycle ) prosystem_cycles += 2;
-
-            dbg_p6502_cycles += ( cycles << 2 ); // debug
-
-            // If lightgun is enabled, check to see if it should be fired
-            if( lightgun ) prosystem_FireLightGun();            
-
-            if( riot_timing ) 
-            {
-                riot_UpdateTimer( cycles );
-            }
-
-            if( memory_ram[WSYNC] && wsync ) 
-            {
-                dbg_wsync_count++; // debug
-                memory_ram[WSYNC] = false;
-                wsync_scanline = true;
-                break;
-            }      
+            wsync_scanline = 
+                prosystem_Run<wsync, lightgun>( CYCLES_PER_SCANLINE );
         }
 
         // If a WSYNC was performed and the current cycle count is less than
         // the cycles per scanline, add those cycles to current timers.
+        riot_Sync( );
         if( wsync_scanline && prosystem_cycles < CYCLES_PER_SCANLINE )
         {
-            if( riot_timing ) 
-            {
-                riot_UpdateTimer( ( CYCLES_PER_SCANLINE - prosystem_cycles ) >> 2 );
-            }
+            cycles = ( CYCLES_PER_SCANLINE - prosystem_cycles ) >> 2;
             prosystem_cycles = CYCLES_PER_SCANLINE;            
+            riot_Advance( cycles );
         }
 
         // If lightgun is enabled, check to see if it should be fired
         if( lightgun ) prosystem_FireLightGun();
 
-        tia_Process(2);
-        if( cartridge_pokey || cartridge_xm ) 
+        if( audio )
         {
-            pokey_Process(2);
+            STATS_START(audio_start);
+            tia_Process(2);
+            if( pokey ) 
+            {
+                pokey_Process(2);
+            }
+            STATS_STOP(audio_ns, audio_start);
         }
 
-        if( cartridge_pokey || cartridge_xm ) pokey_Scanline();
+        if( pokey ) pokey_Scanline();
     }  
+}
+
+// The instances of Scanlines, indexed by the features of the frame (WSYNC,
+// cycle stealing, lightgun and POKEY, from the highest bit)
+typedef void (*prosystem_scanlinesFunction)(bool video, bool audio);
+
+static const prosystem_scanlinesFunction PROSYSTEM_SCANLINES[16] = {
+    prosystem_Scanlines<false, false, false, false>,
+    prosystem_Scanlines<false, false, false, true>,
+    prosystem_Scanlines<false, false, true, false>,
+    prosystem_Scanlines<false, false, true, true>,
+    prosystem_Scanlines<false, true, false, false>,
+    prosystem_Scanlines<false, true, false, true>,
+    prosystem_Scanlines<false, true, true, false>,
+    prosystem_Scanlines<false, true, true, true>,
+    prosystem_Scanlines<true, false, false, false>,
+    prosystem_Scanlines<true, false, false, true>,
+    prosystem_Scanlines<true, false, true, false>,
+    prosystem_Scanlines<true, false, true, true>,
+    prosystem_Scanlines<true, true, false, false>,
+    prosystem_Scanlines<true, true, false, true>,
+    prosystem_Scanlines<true, true, true, false>,
+    prosystem_Scanlines<true, true, true, true>
+};
+
+// ----------------------------------------------------------------------------
+// Frame
+// Emulates a frame. Without video the surface is not written, without audio
+// no samples are synthesized; the CPU, RIOT and Maria timing are unaffected.
+// A frame run ahead is flagged as such in the performance counters.
+// ----------------------------------------------------------------------------
+static inline void prosystem_Frame(const byte* input, bool video, bool audio, bool ahead) 
+{
+#ifdef PROSYSTEM_STATS
+    stats_BeginFrame( video, audio, ahead );
+#endif
+
+    // Is WSYNC enabled for the current frame?
+    bool wsync = !( cartridge_flags & CARTRIDGE_WSYNC_MASK );
+    STATS_SET(wsync, wsync);
+
+    // Is Maria cycle stealing enabled for the current frame?
+    bool cycle_stealing = !( cartridge_flags & CARTRIDGE_CYCLE_STEALING_MASK );
+    STATS_SET(cycle_stealing, cycle_stealing);
+
+    // Is the lightgun enabled for the current frame?
+    bool lightgun = 
+        ( lightgun_enabled && ( memory_ram[CTRL] & 96 ) != 64 );
+
+    bool pokey = cartridge_pokey || cartridge_xm;
+
+    riot_SetInput(input);
+
+    prosystem_extra_cycles = 0;
+
+    if( pokey ) pokey_Frame();
+
+    PROSYSTEM_SCANLINES[( wsync << 3 ) | ( cycle_stealing << 2 ) | 
+                        ( lightgun << 1 ) | pokey]( video, audio );
 
     prosystem_frame++;
     if( prosystem_frame >= prosystem_frequency ) 
     {
         prosystem_frame = 0;
     }
+
+#ifdef PROSYSTEM_STATS
+    stats_EndFrame( );
+#endif
 }
 
-byte *loc_buffer = 0;
+// ----------------------------------------------------------------------------
+// ExecuteFrame
+// ----------------------------------------------------------------------------
+void prosystem_ExecuteFrame(const byte* input) 
+{
+    prosystem_Frame( input, true, true, false );
+}
 
 // ----------------------------------------------------------------------------
-// Save
+// SkipFrame
+// Executes a frame without producing video or audio (fast-forward). The
+// surface keeps the contents of the last rendered frame.
 // ----------------------------------------------------------------------------
-bool prosystem_Save(std::string filename, bool compress) 
+void prosystem_SkipFrame(const byte* input) 
 {
+    prosystem_Frame( input, false, false, false );
+}
 
-  if(filename.empty( ) || filename.length( ) == 0) {
-    logger_LogError("Filename is invalid.", PRO_SYSTEM_SOURCE);
-    return false;
+// ----------------------------------------------------------------------------
+// SeekFrame
+// Executes a frame without producing video. The sound generators still run
+// so that the audio of the frames that follow matches normal playback.
+// ----------------------------------------------------------------------------
+void prosystem_SeekFrame(const byte* input) 
+{
+    prosystem_Frame( input, false, true, false );
+}
+
+CONTEXT_LOCAL byte *loc_buffer = 0;
+// The state restored after running ahead
+static CONTEXT_LOCAL byte *prosystem_aheadBuffer = 0;
+
+// ----------------------------------------------------------------------------
+// Save state format
+// +----------+----------------------------------------------------------------
+// | Size     | Contents
+// +----------+----------------------------------------------------------------
+// | 16       | "PRO-SYSTEM STATE"
+// | 1        | Version
+// | 4        | Date (unused)
+// | 32       | Cartridge digest
+// | ...      | Chunks: a 4 character id, the size of the data (4 bytes) and
+// |          | the data of a component (big-endian)
+// +----------+----------------------------------------------------------------
+// Version 1 states (a fixed layout of the CPU, RAM, RIOT and XM, sniffed by
+// size) are still loaded, but require the machine to have been running for
+// the components they don't capture.
+// ----------------------------------------------------------------------------
+#define PRO_SYSTEM_STATE_VERSION 3
+#define PRO_SYSTEM_STATE_HEADER_SIZE 53
+#define PRO_SYSTEM_STATE_CHUNK_SIZE 8
+#define PRO_SYSTEM_STATE_SYS_SIZE 9
+#define PRO_SYSTEM_STATE_CPU_SIZE 7
+#define PRO_SYSTEM_STATE_RAM_SIZE 16384
+#define PRO_SYSTEM_STATE_XM_SIZE (4 + XM_RAM_SIZE)
+#define PRO_SYSTEM_STATE_MAX_SIZE \
+  (PRO_SYSTEM_STATE_HEADER_SIZE + 8 * PRO_SYSTEM_STATE_CHUNK_SIZE + \
+   PRO_SYSTEM_STATE_SYS_SIZE + PRO_SYSTEM_STATE_CPU_SIZE + \
+   2 + 2 * PRO_SYSTEM_STATE_RAM_SIZE + RIOT_STATE_SIZE + MARIA_STATE_SIZE + \
+   TIA_STATE_SIZE + POKEY_STATE_SIZE + PRO_SYSTEM_STATE_XM_SIZE)
+
+// The chunks of the state, all but the XM chunk are required
+enum {
+  STATE_CHUNK_SYS,
+  STATE_CHUNK_CPU,
+  STATE_CHUNK_MEM,
+  STATE_CHUNK_RIOT,
+  STATE_CHUNK_MARIA,
+  STATE_CHUNK_TIA,
+  STATE_CHUNK_POKEY,
+  STATE_CHUNK_XM,
+  STATE_CHUNK_COUNT
+};
+
+static const char* PRO_SYSTEM_STATE_CHUNKS[STATE_CHUNK_COUNT] = {
+  "SYS ", "CPU ", "MEM ", "RIOT", "MARI", "TIA ", "POKY", "XM  "
+};
+
+// ----------------------------------------------------------------------------
+// GetChunkSize
+// Returns the size of the data of a chunk for the loaded cartridge (0 if the
+// cartridge doesn't have the component).
+// ----------------------------------------------------------------------------
+static uint prosystem_GetChunkSize(int chunk) {
+  switch(chunk) {
+    case STATE_CHUNK_SYS:
+      return PRO_SYSTEM_STATE_SYS_SIZE;
+    case STATE_CHUNK_CPU:
+      return PRO_SYSTEM_STATE_CPU_SIZE;
+    case STATE_CHUNK_MEM:
+      // The RAM mapped by the cartridge follows the RAM of the machine
+      return 2 + PRO_SYSTEM_STATE_RAM_SIZE + cartridge_GetRAMSize( );
+    case STATE_CHUNK_RIOT:
+      return RIOT_STATE_SIZE;
+    case STATE_CHUNK_MARIA:
+      return MARIA_STATE_SIZE;
+    case STATE_CHUNK_TIA:
+      return TIA_STATE_SIZE;
+    case STATE_CHUNK_POKEY:
+      return POKEY_STATE_SIZE;
+    case STATE_CHUNK_XM:
+      return cartridge_xm? PRO_SYSTEM_STATE_XM_SIZE: 0;
   }
-                                                
-  if (!loc_buffer) loc_buffer = (byte *)malloc((33000 + XM_RAM_SIZE + 4) * sizeof(byte));
+  return 0;
+}
 
-  logger_LogInfo("Saving game state to file " + filename + ".");
-  
-  uint size = 0;
-  
-  uint index;
-  for(index = 0; index < 16; index++) {
-    loc_buffer[size + index] = PRO_SYSTEM_STATE_HEADER[index];
+// ----------------------------------------------------------------------------
+// GetStateSize
+// Returns the size of the save state of the loaded cartridge.
+// ----------------------------------------------------------------------------
+uint prosystem_GetStateSize( ) {
+  uint size = PRO_SYSTEM_STATE_HEADER_SIZE;
+  for(int chunk = 0; chunk < STATE_CHUNK_COUNT; chunk++) {
+    uint chunkSize = prosystem_GetChunkSize(chunk);
+    if(chunkSize) {
+      size += PRO_SYSTEM_STATE_CHUNK_SIZE + chunkSize;
+    }
+  }
+  return size;
+}
+
+// ----------------------------------------------------------------------------
+// WriteChunk
+// ----------------------------------------------------------------------------
+static void prosystem_WriteChunk(byte* buffer, uint& offset, int chunk) {
+  state_WriteBlock(buffer, offset, PRO_SYSTEM_STATE_CHUNKS[chunk], 4);
+  state_WriteUint(buffer, offset, prosystem_GetChunkSize(chunk));
+
+  switch(chunk) {
+    case STATE_CHUNK_SYS:
+      state_WriteUint(buffer, offset, prosystem_cycles);
+      state_WriteUint(buffer, offset, prosystem_extra_cycles);
+      state_WriteByte(buffer, offset, prosystem_frame);
+      break;
+    case STATE_CHUNK_CPU:
+      state_WriteByte(buffer, offset, sally_a);
+      state_WriteByte(buffer, offset, sally_x);
+      state_WriteByte(buffer, offset, sally_y);
+      state_WriteByte(buffer, offset, sally_GetP( ));
+      state_WriteByte(buffer, offset, sally_s);
+      state_WriteWord(buffer, offset, sally_pc.w);
+      break;
+    case STATE_CHUNK_MEM:
+      state_WriteByte(buffer, offset, cartridge_bank);
+      state_WriteByte(buffer, offset, cartridge_banked);
+      state_WriteBlock(buffer, offset, memory_ram, 
+        prosystem_GetChunkSize(chunk) - 2);
+      break;
+    case STATE_CHUNK_RIOT:
+      riot_SaveState(buffer, offset);
+      break;
+    case STATE_CHUNK_MARIA:
+      maria_SaveState(buffer, offset);
+      break;
+    case STATE_CHUNK_TIA:
+      tia_SaveState(buffer, offset);
+      break;
+    case STATE_CHUNK_POKEY:
+      pokey_SaveState(buffer, offset);
+      break;
+    case STATE_CHUNK_XM:
+      state_WriteByte(buffer, offset, xm_reg);
+      state_WriteByte(buffer, offset, xm_bank);
+      state_WriteByte(buffer, offset, xm_pokey_enabled);
+      state_WriteByte(buffer, offset, xm_mem_enabled);
+      state_WriteBlock(buffer, offset, xm_ram, XM_RAM_SIZE);
+      break;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// ReadChunk
+// ----------------------------------------------------------------------------
+static void prosystem_ReadChunk(const byte* buffer, uint offset, int chunk) {
+  switch(chunk) {
+    case STATE_CHUNK_SYS:
+      prosystem_cycles = state_ReadUint(buffer, offset);
+      prosystem_extra_cycles = state_ReadUint(buffer, offset);
+      prosystem_frame = state_ReadByte(buffer, offset);
+      break;
+    case STATE_CHUNK_CPU:
+      sally_a = state_ReadByte(buffer, offset);
+      sally_x = state_ReadByte(buffer, offset);
+      sally_y = state_ReadByte(buffer, offset);
+      sally_SetP(state_ReadByte(buffer, offset));
+      sally_s = state_ReadByte(buffer, offset);
+      sally_pc.w = state_ReadWord(buffer, offset);
+      break;
+    case STATE_CHUNK_MEM: {
+      byte bank = state_ReadByte(buffer, offset);
+      bool banked = state_ReadByte(buffer, offset) != 0;
+      // Storing a bank copies it and drops the predecoded code of the window,
+      // the restores of run-ahead and rewind mostly find it already there
+      if(banked && (!cartridge_banked || bank != cartridge_bank)) {
+        cartridge_StoreBank(bank);
+      }
+      else if(!banked && cartridge_banked) {
+        cartridge_ClearBank( );
+      }
+      state_ReadBlock(buffer, offset, memory_ram, 
+        prosystem_GetChunkSize(chunk) - 2);
+    } break;
+    case STATE_CHUNK_RIOT:
+      riot_LoadState(buffer, offset);
+      break;
+    case STATE_CHUNK_MARIA:
+      maria_LoadState(buffer, offset);
+      break;
+    case STATE_CHUNK_TIA:
+      tia_LoadState(buffer, offset);
+      break;
+    case STATE_CHUNK_POKEY:
+      pokey_LoadState(buffer, offset);
+      break;
+    case STATE_CHUNK_XM:
+      xm_reg = state_ReadByte(buffer, offset);
+      xm_bank = state_ReadByte(buffer, offset);
+      xm_pokey_enabled = state_ReadByte(buffer, offset);
+      xm_mem_enabled = state_ReadByte(buffer, offset);
+      state_ReadBlock(buffer, offset, xm_ram, XM_RAM_SIZE);
+      memory_Map( );
+      break;
   }
-  size += 16;
+}
+
+// ----------------------------------------------------------------------------
+// WriteState
+// Writes the state of the machine to the buffer, returns its size.
+// ----------------------------------------------------------------------------
+static uint prosystem_WriteState(byte* buffer) {
+  uint offset = 0;
   
-  loc_buffer[size++] = 1;
-  for(index = 0; index < 4; index++) {
-    loc_buffer[size + index] = 0;
+  state_WriteBlock(buffer, offset, PRO_SYSTEM_STATE_HEADER, 16);
+  state_WriteByte(buffer, offset, PRO_SYSTEM_STATE_VERSION);
+  state_WriteUint(buffer, offset, 0);
+  for(uint index = 0; index < 32; index++) {
+    state_WriteByte(buffer, offset, cartridge_digest[index]);
   }
-  size += 4;
 
-  for(index = 0; index < 32; index++) {
-    loc_buffer[size + index] = cartridge_digest[index];
+  // INTIM is computed lazily
+  riot_UpdateTimer( );
+
+  for(int chunk = 0; chunk < STATE_CHUNK_COUNT; chunk++) {
+    if(prosystem_GetChunkSize(chunk)) {
+      prosystem_WriteChunk(buffer, offset, chunk);
+    }
   }
-  size += 32;
 
-  loc_buffer[size++] = sally_a;
-  loc_buffer[size++] = sally_x;
-  loc_buffer[size++] = sally_y;
-  loc_buffer[size++] = sally_p;
-  loc_buffer[size++] = sally_s;
-  loc_buffer[size++] = sally_pc.b.l;
-  loc_buffer[size++] = sally_pc.b.h;
-  loc_buffer[size++] = cartridge_bank;
+  return offset;
+}
+
+// ----------------------------------------------------------------------------
+// ReadHeader
+// Validates the header of a state, returns its version (0 if invalid).
+// ----------------------------------------------------------------------------
+static byte prosystem_ReadHeader(const byte* buffer, uint size) {
+  if(size < PRO_SYSTEM_STATE_HEADER_SIZE) {
+    logger_LogError("Save state file has an invalid size.", PRO_SYSTEM_SOURCE);
+    return 0;
+  }
+  for(uint index = 0; index < 16; index++) {
+    if(buffer[index] != PRO_SYSTEM_STATE_HEADER[index]) {
+      logger_LogError("File is not a valid ProSystem save state.", PRO_SYSTEM_SOURCE);
+      return 0;
+    }
+  }
+  byte version = buffer[16];
+  if(version != 1 && version != PRO_SYSTEM_STATE_VERSION) {
+    logger_LogError("Save state version is not supported.", PRO_SYSTEM_SOURCE);
+    return 0;
+  }
+  return version;
+}
 
-  for(index = 0; index < 16384; index++) {
-    loc_buffer[size + index] = memory_ram[index];
+// ----------------------------------------------------------------------------
+// CheckDigest
+// ----------------------------------------------------------------------------
+static bool prosystem_CheckDigest(const byte* buffer) {
+  char digest[33] = {0};
+  for(uint index = 0; index < 32; index++) {
+    digest[index] = buffer[21 + index];
   }
-  size += 16384;
+  if(cartridge_digest != std::string(digest)) {
+    logger_LogError("Load state digest [" + std::string(digest) + "] does not match loaded cartridge digest [" + cartridge_digest + "].", PRO_SYSTEM_SOURCE);
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// ReadState
+// Restores the state of the machine from a chunked state. The chunks are
+// validated before any of them is restored; unknown chunks are skipped.
+// ----------------------------------------------------------------------------
+static bool prosystem_ReadState(const byte* buffer, uint size) {
+  if(!prosystem_CheckDigest(buffer)) {
+    return false;
+  }
+
+  uint offsets[STATE_CHUNK_COUNT] = {0};
+  uint offset = PRO_SYSTEM_STATE_HEADER_SIZE;
+  while(offset < size) {
+    if(size - offset < PRO_SYSTEM_STATE_CHUNK_SIZE) {
+      logger_LogError("Save state is truncated.", PRO_SYSTEM_SOURCE);
+      return false;
+    }
+    const byte* id = buffer + offset;
+    offset += 4;
+    uint length = state_ReadUint(buffer, offset);
+    if(length > size - offset) {
+      logger_LogError("Save state is truncated.", PRO_SYSTEM_SOURCE);
+      return false;
+    }
+    for(int chunk = 0; chunk < STATE_CHUNK_COUNT; chunk++) {
+      if(!memcmp(id, PRO_SYSTEM_STATE_CHUNKS[chunk], 4)) {
+        if(length != prosystem_GetChunkSize(chunk)) {
+          logger_LogError("Save state chunk " + std::string((const char*)id, 4) + " has an invalid size.", PRO_SYSTEM_SOURCE);
+          return false;
+        }
+        offsets[chunk] = offset;
+      }
+    }
+    offset += length;
+  }
+
+  for(int chunk = 0; chunk < STATE_CHUNK_COUNT; chunk++) {
+    if(prosystem_GetChunkSize(chunk) && !offsets[chunk]) {
+      logger_LogError("Save state is missing the " + std::string(PRO_SYSTEM_STATE_CHUNKS[chunk], 4) + " chunk.", PRO_SYSTEM_SOURCE);
+      return false;
+    }
+  }
+
+  for(int chunk = 0; chunk < STATE_CHUNK_COUNT; chunk++) {
+    if(offsets[chunk]) {
+      prosystem_ReadChunk(buffer, offsets[chunk], chunk);
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// ReadLegacyState
+// Restores the state of the machine from a version 1 state. The machine is
+// reset first when specified (the state doesn't capture the complete
+// machine).
+// ----------------------------------------------------------------------------
+static bool prosystem_ReadLegacyState(const byte* buffer, uint size, bool reset) {
+  if( size != 16445 && size != 32829 &&     /* no RIOT */ 
+      size != 16453 && size != 32837 &&     /* with RIOT */ 
+      size != (16453 + 4 + XM_RAM_SIZE) &&  /* XM without supercart ram */ 
+      size != (32837 + 4 + XM_RAM_SIZE))    /* XM with supercart ram */ 
+  {
+    logger_LogError("Save state file has an invalid size.", PRO_SYSTEM_SOURCE);
+    return false;
+  }
+
+  if(reset) {
+    prosystem_Reset( );
+  }
+  
+  if(!prosystem_CheckDigest(buffer)) {
+    return false;
+  }
+  uint offset = PRO_SYSTEM_STATE_HEADER_SIZE;
+  
+  sally_a = buffer[offset++];
+  sally_x = buffer[offset++];
+  sally_y = buffer[offset++];
+  sally_SetP(buffer[offset++]);
+  sally_s = buffer[offset++];
+  sally_pc.b.l = buffer[offset++];
+  sally_pc.b.h = buffer[offset++];
   
+  cartridge_StoreBank(buffer[offset++]);
+
+  memcpy(memory_ram, buffer + offset, 16384);
+  offset += 16384;
+
   if(cartridge_type == CARTRIDGE_TYPE_SUPERCART_RAM) {
-    for(index = 0; index < 16384; index++) {
-      loc_buffer[size + index] = memory_ram[16384 + index];
-    } 
-    size += 16384;
+      if (size != 32829 && /* no RIOT */
+          size != 32837 && /* with RIOT */
+          size != (32837 + 4 + XM_RAM_SIZE)) /* XM */ {
+          logger_LogError("Save state file has an invalid size.",
+                          PRO_SYSTEM_SOURCE);
+          return false;
+      }
+      memcpy(memory_ram + 16384, buffer + offset, 16384);
+      offset += 16384; 
   }
 
-  // RIOT state
-  loc_buffer[size++] = riot_dra;
-  loc_buffer[size++] = riot_drb;
-  loc_buffer[size++] = riot_timing;
-  loc_buffer[size++] = (0xff & (riot_timer >> 8));
-  loc_buffer[size++] = (0xff & riot_timer);
-  loc_buffer[size++] = riot_intervals;
-  loc_buffer[size++] = (0xff & (riot_clocks >> 8));
-  loc_buffer[size++] = (0xff & riot_clocks);
+  if (size == 16453 || /* no supercart ram */
+      size == 32837 || /* supercart ram */
+      size == (16453 + 4 + XM_RAM_SIZE) || /* xm, no supercart ram */
+      size == (32837 + 4 + XM_RAM_SIZE)) /* xm, supercart ram */ {
+      // RIOT state
+      riot_dra = buffer[offset++];
+      riot_drb = buffer[offset++];
+      riot_timing = buffer[offset++];
+      riot_timer = (buffer[offset++] << 8);
+      riot_timer |= buffer[offset++];
+      riot_intervals = buffer[offset++];
+      riot_clocks = (buffer[offset++] << 8);
+      riot_clocks |= buffer[offset++];
+  }
 
   // XM (if applicable)
   if (cartridge_xm) {
-    loc_buffer[size++] = xm_reg;
-    loc_buffer[size++] = xm_bank;
-    loc_buffer[size++] = xm_pokey_enabled;
-    loc_buffer[size++] = xm_mem_enabled;
+      if ((size != (16453 + 4 + XM_RAM_SIZE)) &&
+          (size != (32837 + 4 + XM_RAM_SIZE))) {
+          logger_LogError("Save state file has an invalid size.",
+                          PRO_SYSTEM_SOURCE);
+          return false;
+      }
+      xm_reg = buffer[offset++];
+      xm_bank = buffer[offset++];
+      xm_pokey_enabled = buffer[offset++];
+      xm_mem_enabled = buffer[offset++];
 
 #if 0
-net_print_string(NULL, 0, "Wrote XM: xm_reg: %d, xm_bank: %d, xm_pokey_enabled: %d, xm_mem_enabled: %d\n", 
+net_print_string(NULL, 0, "Read XM: xm_reg: %d, xm_bank: %d, xm_pokey_enabled: %d, xm_mem_enabled: %d\n", 
     xm_reg, xm_bank, xm_pokey_enabled, xm_mem_enabled);
 #endif    
 
-    for (index = 0; index < XM_RAM_SIZE; index++) {
-      loc_buffer[size + index] = xm_ram[index];
-    }
-    size += XM_RAM_SIZE;
+      memcpy(xm_ram, buffer + offset, XM_RAM_SIZE);
+      offset += XM_RAM_SIZE;
+      memory_Map( );
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Restore
+// Restores the state of the machine from the buffer. Only version 1 states
+// reset the machine first (when specified).
+// ----------------------------------------------------------------------------
+static bool prosystem_Restore(const byte* buffer, uint size, bool reset) {
+  byte version = prosystem_ReadHeader(buffer, size);
+  if(version == 0) {
+    return false;
+  }
+  if(version == 1) {
+    return prosystem_ReadLegacyState(buffer, size, reset);
+  }
+  return prosystem_ReadState(buffer, size);
+}
+
+// ----------------------------------------------------------------------------
+// Save
+// ----------------------------------------------------------------------------
+bool prosystem_Save(std::string filename, bool compress) 
+{
+
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", PRO_SYSTEM_SOURCE);
+    return false;
   }
+                                                
+  if (!loc_buffer) loc_buffer = (byte *)malloc(PRO_SYSTEM_STATE_MAX_SIZE * sizeof(byte));
+
+  logger_LogInfo("Saving game state to file " + filename + ".");
+  
+  uint size = prosystem_WriteState(loc_buffer);
 
   FILE* file = fopen(filename.c_str(), "wb");
   if (file == NULL) {
@@ -387,6 +859,21 @@ net_print_string(NULL, 0, "Wrote XM: xm_reg: %d, xm_bank: %d, xm_pokey_enabled:
   return true;
 }
 
+// ----------------------------------------------------------------------------
+// SaveToBuffer
+// Saves the state of the machine to the buffer, which must hold at least
+// prosystem_GetStateSize( ) bytes. Performs no file I/O (suitable for being
+// called every frame).
+// ----------------------------------------------------------------------------
+bool prosystem_SaveToBuffer(byte* buffer, uint size) {
+  if(buffer == NULL || size < prosystem_GetStateSize( )) {
+    logger_LogError("Save state buffer is too small.", PRO_SYSTEM_SOURCE);
+    return false;
+  }
+  prosystem_WriteState(buffer);
+  return true;
+}
+
 // ----------------------------------------------------------------------------
 // Load
 // ----------------------------------------------------------------------------
@@ -397,7 +884,7 @@ bool prosystem_Load(const std::string filename) {
     return false;
   }
 
-  if (!loc_buffer) loc_buffer = (byte *)malloc((33000 + XM_RAM_SIZE + 4) * sizeof(byte));
+  if (!loc_buffer) loc_buffer = (byte *)malloc(PRO_SYSTEM_STATE_MAX_SIZE * sizeof(byte));
 
   logger_LogInfo("Loading game state from file " + filename + ".");
   
@@ -422,11 +909,7 @@ bool prosystem_Load(const std::string filename) {
       return false;
     }
 
-    if( size != 16445 && size != 32829 &&     /* no RIOT */ 
-        size != 16453 && size != 32837 &&     /* with RIOT */ 
-        size != (16453 + 4 + XM_RAM_SIZE) &&  /* XM without supercart ram */ 
-        size != (32837 + 4 + XM_RAM_SIZE))    /* XM with supercart ram */ 
-    {
+    if(size > PRO_SYSTEM_STATE_MAX_SIZE) {
       fclose(file);
       logger_LogError("Save state file has an invalid size.", PRO_SYSTEM_SOURCE);
       return false;
@@ -444,102 +927,60 @@ bool prosystem_Load(const std::string filename) {
     return false;
   }
 
-  uint offset = 0;
-  uint index;
-  for(index = 0; index < 16; index++) {
-    if(loc_buffer[offset + index] != PRO_SYSTEM_STATE_HEADER[index]) {
-      logger_LogError("File is not a valid ProSystem save state.", PRO_SYSTEM_SOURCE);
-      return false;
-    }
-  }
-  offset += 16;
-  byte version = loc_buffer[offset++];
-  
-  uint date = 0;
-  for(index = 0; index < 4; index++) {
-  }
-  offset += 4;
-  
-  prosystem_Reset( );
-  
-  char digest[33] = {0};
-  for(index = 0; index < 32; index++) {
-    digest[index] = loc_buffer[offset + index];
-  }
-  offset += 32;
-  if(cartridge_digest != std::string(digest)) {
-    logger_LogError("Load state digest [" + std::string(digest) + "] does not match loaded cartridge digest [" + cartridge_digest + "].", PRO_SYSTEM_SOURCE);
-    return false;
-  }
-  
-  sally_a = loc_buffer[offset++];
-  sally_x = loc_buffer[offset++];
-  sally_y = loc_buffer[offset++];
-  sally_p = loc_buffer[offset++];
-  sally_s = loc_buffer[offset++];
-  sally_pc.b.l = loc_buffer[offset++];
-  sally_pc.b.h = loc_buffer[offset++];
-  
-  cartridge_StoreBank(loc_buffer[offset++]);
+  return prosystem_Restore(loc_buffer, size, true);
+}
 
-  for(index = 0; index < 16384; index++) {
-    memory_ram[index] = loc_buffer[offset + index];
+// ----------------------------------------------------------------------------
+// GetStateVersion
+// Returns the version of the save state file (0 if it isn't a valid state).
+// ----------------------------------------------------------------------------
+byte prosystem_GetStateVersion(const std::string filename) {
+  byte header[PRO_SYSTEM_STATE_HEADER_SIZE];
+  FILE* file = fopen(filename.c_str( ), "rb");
+  if(file == NULL) {
+    return 0;
   }
-  offset += 16384;
+  uint size = fread(header, 1, PRO_SYSTEM_STATE_HEADER_SIZE, file);
+  fclose(file);
+  return prosystem_ReadHeader(header, size);
+}
 
-  if(cartridge_type == CARTRIDGE_TYPE_SUPERCART_RAM) {
-      if (size != 32829 && /* no RIOT */
-          size != 32837 && /* with RIOT */
-          size != (32837 + 4 + XM_RAM_SIZE)) /* XM */ {
-          logger_LogError("Save state file has an invalid size.",
-                          PRO_SYSTEM_SOURCE);
-          return false;
-      }
-      for (index = 0; index < 16384; index++) {
-          memory_ram[16384 + index] = loc_buffer[offset + index];
-    }
-    offset += 16384; 
+// ----------------------------------------------------------------------------
+// LoadFromBuffer
+// Restores a state saved by prosystem_SaveToBuffer. No file I/O is performed
+// (a version 1 state is restored without resetting the machine first).
+// ----------------------------------------------------------------------------
+bool prosystem_LoadFromBuffer(const byte* buffer, uint size) {
+  if(buffer == NULL) {
+    logger_LogError("Save state buffer is invalid.", PRO_SYSTEM_SOURCE);
+    return false;
   }
+  return prosystem_Restore(buffer, size, false);
+}
 
-  if (size == 16453 || /* no supercart ram */
-      size == 32837 || /* supercart ram */
-      size == (16453 + 4 + XM_RAM_SIZE) || /* xm, no supercart ram */
-      size == (32837 + 4 + XM_RAM_SIZE)) /* xm, supercart ram */ {
-      // RIOT state
-      riot_dra = loc_buffer[offset++];
-      riot_drb = loc_buffer[offset++];
-      riot_timing = loc_buffer[offset++];
-      riot_timer = (loc_buffer[offset++] << 8);
-      riot_timer |= loc_buffer[offset++];
-      riot_intervals = loc_buffer[offset++];
-      riot_clocks = (loc_buffer[offset++] << 8);
-      riot_clocks |= loc_buffer[offset++];
+// ----------------------------------------------------------------------------
+// RunAhead
+// Called after a frame has been executed. Runs the specified count of frames
+// ahead with the same input, without audio and rendering only the last one,
+// then restores the machine. The surface shows the outcome of the input that
+// many frames early, hiding the input lag of the cartridge.
+// ----------------------------------------------------------------------------
+bool prosystem_RunAhead(const byte* input, uint frames) {
+  if(frames == 0) {
+    return true;
   }
-
-  // XM (if applicable)
-  if (cartridge_xm) {
-      if ((size != (16453 + 4 + XM_RAM_SIZE)) &&
-          (size != (32837 + 4 + XM_RAM_SIZE))) {
-          logger_LogError("Save state file has an invalid size.",
-                          PRO_SYSTEM_SOURCE);
-          return false;
-      }
-      xm_reg = loc_buffer[offset++];
-      xm_bank = loc_buffer[offset++];
-      xm_pokey_enabled = loc_buffer[offset++];
-      xm_mem_enabled = loc_buffer[offset++];
-
-#if 0
-net_print_string(NULL, 0, "Read XM: xm_reg: %d, xm_bank: %d, xm_pokey_enabled: %d, xm_mem_enabled: %d\n", 
-    xm_reg, xm_bank, xm_pokey_enabled, xm_mem_enabled);
-#endif    
-
-      for (index = 0; index < XM_RAM_SIZE; index++) {
-          xm_ram[index] = loc_buffer[offset++];
-      }
+  if(!prosystem_aheadBuffer) prosystem_aheadBuffer = (byte *)malloc(PRO_SYSTEM_STATE_MAX_SIZE * sizeof(byte));
+  if(!prosystem_aheadBuffer) {
+    logger_LogError("Failed to allocate the run-ahead buffer.", PRO_SYSTEM_SOURCE);
+    return false;
   }
 
-  return true;
+  uint size = prosystem_WriteState(prosystem_aheadBuffer);
+  for(uint index = 1; index < frames; index++) {
+    prosystem_Frame(input, false, false, true);
+  }
+  prosystem_Frame(input, true, false, true);
+  return prosystem_Restore(prosystem_aheadBuffer, size, false);
 }
 
 // ----------------------------------------------------------------------------
@@ -563,4 +1004,16 @@ void prosystem_Close( ) {
   memory_Reset( );
   tia_Reset( );
   tia_Clear( );
+  if(loc_buffer) {
+    free(loc_buffer);
+    loc_buffer = 0;
+  }
+  profile_Release( );
+#ifdef PROSYSTEM_JIT
+  jit_Release( );
+#endif
+  if(prosystem_aheadBuffer) {
+    free(prosystem_aheadBuffer);
+    prosystem_aheadBuffer = 0;
+  }
 }
@@ -26,6 +26,7 @@
 #define PRO_SYSTEM_H
 
 #include <string>
+#include "EmulatorContext.h"
 #include <stdio.h>
 #include "Equates.h"
 #include "Bios.h"
@@ -51,16 +52,24 @@ typedef unsigned int uint;
 
 extern void prosystem_Reset( );
 extern void prosystem_ExecuteFrame(const byte* input);
+extern void prosystem_SkipFrame(const byte* input);
+extern void prosystem_SeekFrame(const byte* input);
 extern bool prosystem_Save(std::string filename, bool compress);
 extern bool prosystem_Load(std::string filename);
+extern byte prosystem_GetStateVersion(std::string filename);
+extern uint prosystem_GetStateSize( );
+extern bool prosystem_SaveToBuffer(byte* buffer, uint size);
+extern bool prosystem_LoadFromBuffer(const byte* buffer, uint size);
+extern bool prosystem_RunAhead(const byte* input, uint frames);
 extern void prosystem_Pause(bool pause);
 extern void prosystem_Close( );
-extern bool prosystem_active;
-extern bool prosystem_paused;
-extern word prosystem_frequency;
-extern byte prosystem_frame;
-extern word prosystem_scanlines;
-extern uint prosystem_cycles;
-extern uint prosystem_extra_cycles;
+extern CONTEXT_LOCAL bool prosystem_active;
+extern CONTEXT_LOCAL bool prosystem_paused;
+extern CONTEXT_LOCAL word prosystem_frequency;
+extern CONTEXT_LOCAL byte prosystem_frame;
+extern CONTEXT_LOCAL word prosystem_scanlines;
+extern CONTEXT_LOCAL uint prosystem_cycles;
+extern CONTEXT_LOCAL uint prosystem_extra_cycles;
+extern CONTEXT_LOCAL uint prosystem_event;
 
 #endif
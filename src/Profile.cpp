@@ -0,0 +1,794 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Profile.cpp
+// ----------------------------------------------------------------------------
+#include <algorithm>
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Profile.h"
+#include "Cartridge.h"
+#include "Sally.h"
+#include "Stats.h"
+
+#define PROFILE_SOURCE "Profile.cpp"
+
+// The regions of the address space with their own counters: the unbanked
+// memory, the BIOS and each cartridge bank
+#define PROFILE_REGION_MEMORY 0
+#define PROFILE_REGION_BIOS 1
+#define PROFILE_REGION_BANK 2
+#define PROFILE_REGION_COUNT (PROFILE_REGION_BANK + 256)
+#define PROFILE_BIOS_BASE 49152
+#define PROFILE_BANK_SIZE 16384
+
+// The limits of the call tree
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_MAX_NODES 65536
+
+// The count of routines and addresses listed by the report
+#define PROFILE_REPORT_SIZE 40
+
+#ifdef PROSYSTEM_PROFILE
+// The addressing modes of the opcodes
+enum {
+  MODE_IMP, MODE_ACC, MODE_IMM, MODE_ZPG, MODE_ZPX, MODE_ZPY, MODE_ABS,
+  MODE_ABX, MODE_ABY, MODE_IND, MODE_IZX, MODE_IZY, MODE_REL, MODE_ILL,
+  MODE_COUNT
+};
+
+static const char* PROFILE_MODE_NAMES[MODE_COUNT] = {
+  "implied", "accumulator", "immediate", "zero page", "zero page,x",
+  "zero page,y", "absolute", "absolute,x", "absolute,y", "indirect",
+  "(indirect,x)", "(indirect),y", "relative", "illegal"
+};
+
+static const char* PROFILE_OPCODE_NAMES[256] = {
+  "BRK", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+  "PHP", "ORA", "ASL", "???", "???", "ORA", "ASL", "???",
+  "BPL", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+  "CLC", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+  "JSR", "AND", "???", "???", "BIT", "AND", "ROL", "???",
+  "PLP", "AND", "ROL", "???", "BIT", "AND", "ROL", "???",
+  "BMI", "AND", "???", "???", "???", "AND", "ROL", "???",
+  "SEC", "AND", "???", "???", "???", "AND", "ROL", "???",
+  "RTI", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+  "PHA", "EOR", "LSR", "???", "JMP", "EOR", "LSR", "???",
+  "BVC", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+  "CLI", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+  "RTS", "ADC", "???", "???", "???", "ADC", "ROR", "???",
+  "PLA", "ADC", "ROR", "???", "JMP", "ADC", "ROR", "???",
+  "BVS", "ADC", "???", "???", "???", "ADC", "ROR", "???",
+  "SEI", "ADC", "???", "???", "???", "ADC", "ROR", "???",
+  "???", "STA", "???", "???", "STY", "STA", "STX", "???",
+  "DEY", "???", "TXA", "???", "STY", "STA", "STX", "???",
+  "BCC", "STA", "???", "???", "STY", "STA", "STX", "???",
+  "TYA", "STA", "TXS", "???", "???", "STA", "???", "???",
+  "LDY", "LDA", "LDX", "???", "LDY", "LDA", "LDX", "???",
+  "TAY", "LDA", "TAX", "???", "LDY", "LDA", "LDX", "???",
+  "BCS", "LDA", "???", "???", "LDY", "LDA", "LDX", "???",
+  "CLV", "LDA", "TSX", "???", "LDY", "LDA", "LDX", "???",
+  "CPY", "CMP", "???", "???", "CPY", "CMP", "DEC", "???",
+  "INY", "CMP", "DEX", "???", "CPY", "CMP", "DEC", "???",
+  "BNE", "CMP", "???", "???", "???", "CMP", "DEC", "???",
+  "CLD", "CMP", "???", "???", "???", "CMP", "DEC", "???",
+  "CPX", "SBC", "???", "???", "CPX", "SBC", "INC", "???",
+  "INX", "SBC", "NOP", "???", "CPX", "SBC", "INC", "???",
+  "BEQ", "SBC", "???", "???", "???", "SBC", "INC", "???",
+  "SED", "SBC", "???", "???", "???", "SBC", "INC", "???",
+};
+
+static const byte PROFILE_OPCODE_MODES[256] = {
+  MODE_IMP, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_ACC, MODE_ILL, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+  MODE_ABS, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_ACC, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+  MODE_IMP, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_ACC, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+  MODE_IMP, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_ACC, MODE_ILL, MODE_IND, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+  MODE_ILL, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_ILL, MODE_IMP, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ZPY, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_IMP, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ILL, MODE_ILL,
+  MODE_IMM, MODE_IZX, MODE_IMM, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_IMP, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ZPY, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_IMP, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ABY, MODE_ILL,
+  MODE_IMM, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_IMP, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+  MODE_IMM, MODE_IZX, MODE_ILL, MODE_ILL, MODE_ZPG, MODE_ZPG, MODE_ZPG, MODE_ILL,
+  MODE_IMP, MODE_IMM, MODE_IMP, MODE_ILL, MODE_ABS, MODE_ABS, MODE_ABS, MODE_ILL,
+  MODE_REL, MODE_IZY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ZPX, MODE_ZPX, MODE_ILL,
+  MODE_IMP, MODE_ABY, MODE_ILL, MODE_ILL, MODE_ILL, MODE_ABX, MODE_ABX, MODE_ILL,
+};
+
+CONTEXT_LOCAL ullong profile_opcodeCount[256] = {0};
+CONTEXT_LOCAL ullong profile_opcodeTicks[256] = {0};
+CONTEXT_LOCAL bool profile_bios = false;
+static CONTEXT_LOCAL ullong profile_startTicks = 0;
+static CONTEXT_LOCAL ullong profile_startTime = 0;
+
+typedef struct profile_address {
+  ullong count;
+  ullong clocks;
+} profile_address;
+
+// A routine within the call tree. Clocks are Maria clocks (4 per CPU cycle)
+// spent in the routine itself, total includes the routines it called.
+typedef struct profile_node {
+  uint parent;
+  uint child;
+  uint sibling;
+  uint region;
+  word address;
+  bool interrupt;
+  ullong calls;
+  ullong clocks;
+  ullong total;
+} profile_node;
+
+// The counters of each address, allocated per region as it is executed
+static CONTEXT_LOCAL profile_address* profile_addresses[PROFILE_REGION_COUNT] = {NULL};
+static CONTEXT_LOCAL word profile_bankBase = 0;
+
+// The call tree, node 0 is the code executed from the reset vector
+static CONTEXT_LOCAL profile_node* profile_nodes = NULL;
+static CONTEXT_LOCAL uint profile_nodeCount = 0;
+static CONTEXT_LOCAL uint profile_nodeMax = 0;
+static CONTEXT_LOCAL uint profile_current = 0;
+static CONTEXT_LOCAL uint profile_depth = 0;
+static CONTEXT_LOCAL uint profile_overflow = 0;
+
+// ----------------------------------------------------------------------------
+// GetBankBase
+// Returns the address of the bank switched window of the cartridge (0 if the
+// cartridge doesn't switch banks).
+// ----------------------------------------------------------------------------
+static word profile_GetBankBase( ) {
+  switch(cartridge_type) {
+    case CARTRIDGE_TYPE_SUPERCART:
+    case CARTRIDGE_TYPE_SUPERCART_LARGE:
+    case CARTRIDGE_TYPE_SUPERCART_RAM:
+    case CARTRIDGE_TYPE_SUPERCART_ROM:
+      return 32768;
+    case CARTRIDGE_TYPE_ABSOLUTE:
+      return 16384;
+    case CARTRIDGE_TYPE_ACTIVISION:
+      return 40960;
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+// GetRegion
+// ----------------------------------------------------------------------------
+static inline uint profile_GetRegion(word address) {
+  if(profile_bios && address >= PROFILE_BIOS_BASE) {
+    return PROFILE_REGION_BIOS;
+  }
+  if(profile_bankBase && address >= profile_bankBase &&
+     address < profile_bankBase + PROFILE_BANK_SIZE) {
+    return PROFILE_REGION_BANK + cartridge_bank;
+  }
+  return PROFILE_REGION_MEMORY;
+}
+
+// ----------------------------------------------------------------------------
+// GetRegionBase
+// ----------------------------------------------------------------------------
+static inline uint profile_GetRegionBase(uint region) {
+  if(region == PROFILE_REGION_MEMORY) {
+    return 0;
+  }
+  return (region == PROFILE_REGION_BIOS)? PROFILE_BIOS_BASE: profile_bankBase;
+}
+
+// ----------------------------------------------------------------------------
+// GetRegionSize
+// ----------------------------------------------------------------------------
+static inline uint profile_GetRegionSize(uint region) {
+  return (region == PROFILE_REGION_MEMORY)? 65536: PROFILE_BANK_SIZE;
+}
+
+// ----------------------------------------------------------------------------
+// GetAddress
+// Returns the counters of an address (NULL if they can't be allocated).
+// ----------------------------------------------------------------------------
+static inline profile_address* profile_GetAddress(uint region, word address) {
+  if(!profile_addresses[region]) {
+    uint size = profile_GetRegionSize(region);
+    profile_addresses[region] = (profile_address*)calloc(size, sizeof(profile_address));
+    if(!profile_addresses[region]) {
+      return NULL;
+    }
+  }
+  return &profile_addresses[region][address - profile_GetRegionBase(region)];
+}
+
+// ----------------------------------------------------------------------------
+// GetName
+// Symbolizes an address: the BIOS, a cartridge bank, the RAM, the high score
+// cartridge or the fixed cartridge ROM.
+// ----------------------------------------------------------------------------
+static void profile_GetName(uint region, word address, char* name, uint size) {
+  if(region == PROFILE_REGION_BIOS) {
+    snprintf(name, size, "bios:$%04X", address);
+  }
+  else if(region >= PROFILE_REGION_BANK) {
+    snprintf(name, size, "bank%u:$%04X", region - PROFILE_REGION_BANK, address);
+  }
+  else if(address < 0x3000) {
+    snprintf(name, size, "ram:$%04X", address);
+  }
+  else if(address < 0x4000) {
+    snprintf(name, size, "hsc:$%04X", address);
+  }
+  else {
+    snprintf(name, size, "rom:$%04X", address);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// GetNodeName
+// ----------------------------------------------------------------------------
+static void profile_GetNodeName(uint index, char* name, uint size) {
+  const profile_node& node = profile_nodes[index];
+  if(index == 0) {
+    snprintf(name, size, "reset");
+  }
+  else if(node.interrupt) {
+    char address[32];
+    profile_GetName(node.region, node.address, address, sizeof(address));
+    snprintf(name, size, "int@%s", address);
+  }
+  else {
+    profile_GetName(node.region, node.address, name, size);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// AddNode
+// Returns the index of the new node (0 if the tree is full).
+// ----------------------------------------------------------------------------
+static uint profile_AddNode(uint parent, uint region, word address, bool interrupt) {
+  if(profile_nodeCount == profile_nodeMax) {
+    uint max = profile_nodeMax? profile_nodeMax * 2: 1024;
+    if(max > PROFILE_MAX_NODES) {
+      return 0;
+    }
+    profile_node* nodes = (profile_node*)realloc(profile_nodes, max * sizeof(profile_node));
+    if(!nodes) {
+      return 0;
+    }
+    profile_nodes = nodes;
+    profile_nodeMax = max;
+  }
+
+  uint index = profile_nodeCount++;
+  profile_node& node = profile_nodes[index];
+  memset(&node, 0, sizeof(profile_node));
+  node.parent = parent;
+  node.region = region;
+  node.address = address;
+  node.interrupt = interrupt;
+  if(index != parent) {
+    node.sibling = profile_nodes[parent].child;
+    profile_nodes[parent].child = index;
+  }
+  return index;
+}
+
+// ----------------------------------------------------------------------------
+// Call
+// Enters the routine at the program counter. Calls nested deeper than the
+// tree are counted so that their returns are matched.
+// ----------------------------------------------------------------------------
+static void profile_Call(bool interrupt) {
+  if(!profile_nodes || profile_depth >= PROFILE_MAX_DEPTH) {
+    profile_overflow++;
+    return;
+  }
+
+  word address = sally_pc.w;
+  uint region = profile_GetRegion(address);
+  uint child = profile_nodes[profile_current].child;
+  while(child) {
+    const profile_node& node = profile_nodes[child];
+    if(node.address == address && node.region == region && node.interrupt == interrupt) {
+      break;
+    }
+    child = node.sibling;
+  }
+  if(!child) {
+    child = profile_AddNode(profile_current, region, address, interrupt);
+    if(!child) {
+      profile_overflow++;
+      return;
+    }
+  }
+
+  profile_nodes[child].calls++;
+  profile_current = child;
+  profile_depth++;
+}
+
+// ----------------------------------------------------------------------------
+// Return
+// ----------------------------------------------------------------------------
+static void profile_Return( ) {
+  if(profile_overflow) {
+    profile_overflow--;
+  }
+  else if(profile_depth) {
+    profile_current = profile_nodes[profile_current].parent;
+    profile_depth--;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Instruction
+// Records an executed instruction: its opcode, the host ticks and the Maria
+// clocks it took. The clocks are attributed to the address of the instruction
+// and the routine being executed. JSR/BRK enter a routine, RTS/RTI return
+// from it; code that manipulates the stack to return skews the call tree.
+// ----------------------------------------------------------------------------
+void profile_Instruction(word pc, byte opcode, uint clocks, ullong ticks) {
+  profile_opcodeCount[opcode]++;
+  profile_opcodeTicks[opcode] += ticks;
+
+  profile_address* address = profile_GetAddress(profile_GetRegion(pc), pc);
+  if(address) {
+    address->count++;
+    address->clocks += clocks;
+  }
+  if(profile_nodes) {
+    profile_nodes[profile_current].clocks += clocks;
+  }
+
+  switch(opcode) {
+    case 0x00:
+      profile_Call(true);
+      break;
+    case 0x20:
+      profile_Call(false);
+      break;
+    case 0x40:
+    case 0x60:
+      profile_Return( );
+      break;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Interrupt
+// Enters the interrupt handler at the program counter.
+// ----------------------------------------------------------------------------
+void profile_Interrupt( ) {
+  profile_Call(true);
+}
+
+// ----------------------------------------------------------------------------
+// CompareOpcodes
+// Orders the opcodes by descending count of executions.
+// ----------------------------------------------------------------------------
+static bool profile_CompareOpcodes(int a, int b) {
+  if(profile_opcodeCount[a] != profile_opcodeCount[b]) {
+    return profile_opcodeCount[a] > profile_opcodeCount[b];
+  }
+  return a < b;
+}
+
+// A routine of the report, the nodes of the same routine are merged
+typedef struct profile_routine {
+  uint node;
+  ullong calls;
+  ullong clocks;
+  ullong total;
+} profile_routine;
+
+// ----------------------------------------------------------------------------
+// CompareRoutines
+// ----------------------------------------------------------------------------
+static bool profile_CompareRoutines(const profile_routine& a, const profile_routine& b) {
+  if(a.total != b.total) {
+    return a.total > b.total;
+  }
+  return a.node < b.node;
+}
+
+// ----------------------------------------------------------------------------
+// IsSameRoutine
+// ----------------------------------------------------------------------------
+static inline bool profile_IsSameRoutine(uint a, uint b) {
+  const profile_node& nodeA = profile_nodes[a];
+  const profile_node& nodeB = profile_nodes[b];
+  return (a == 0 && b == 0) || (a && b && nodeA.address == nodeB.address &&
+    nodeA.region == nodeB.region && nodeA.interrupt == nodeB.interrupt);
+}
+
+// A hot address of the report
+typedef struct profile_hotspot {
+  uint region;
+  word address;
+  ullong count;
+  ullong clocks;
+} profile_hotspot;
+
+// ----------------------------------------------------------------------------
+// CompareHotspots
+// ----------------------------------------------------------------------------
+static bool profile_CompareHotspots(const profile_hotspot& a, const profile_hotspot& b) {
+  if(a.clocks != b.clocks) {
+    return a.clocks > b.clocks;
+  }
+  return (a.region != b.region)? a.region < b.region: a.address < b.address;
+}
+
+// ----------------------------------------------------------------------------
+// Percent
+// ----------------------------------------------------------------------------
+static inline double profile_Percent(ullong value, ullong total) {
+  return total? (100.0 * value) / total: 0.0;
+}
+
+// ----------------------------------------------------------------------------
+// Cycles
+// Converts Maria clocks to CPU cycles.
+// ----------------------------------------------------------------------------
+static inline double profile_Cycles(ullong clocks) {
+  return clocks / 4.0;
+}
+
+// ----------------------------------------------------------------------------
+// WriteOpcodes
+// ----------------------------------------------------------------------------
+static void profile_WriteOpcodes(FILE* file) {
+  ullong ticks = profile_GetTicks( ) - profile_startTicks;
+  ullong time = stats_GetTime( ) - profile_startTime;
+  double scale = ticks? (double)time / ticks: 0.0;
+
+  ullong count = 0;
+  ullong total = 0;
+  ullong modeCount[MODE_COUNT] = {0};
+  ullong modeTicks[MODE_COUNT] = {0};
+  int opcodes[256];
+  for(int opcode = 0; opcode < 256; opcode++) {
+    count += profile_opcodeCount[opcode];
+    total += profile_opcodeTicks[opcode];
+    modeCount[PROFILE_OPCODE_MODES[opcode]] += profile_opcodeCount[opcode];
+    modeTicks[PROFILE_OPCODE_MODES[opcode]] += profile_opcodeTicks[opcode];
+    opcodes[opcode] = opcode;
+  }
+  std::sort(opcodes, opcodes + 256, profile_CompareOpcodes);
+
+  fprintf(file, "instructions: %llu, time: %.3f ms (%.3f ns/instruction)\n\n",
+    count, (total * scale) / 1e6, count? (total * scale) / count: 0.0);
+  fprintf(file, "opcode  name  mode                count       %%    time (ms)       %%    ns\n");
+  for(int index = 0; index < 256; index++) {
+    int opcode = opcodes[index];
+    if(!profile_opcodeCount[opcode]) {
+      break;
+    }
+    fprintf(file, "$%02X     %s   %-14s %12llu  %6.2f %12.3f  %6.2f %5.1f\n",
+      opcode, PROFILE_OPCODE_NAMES[opcode],
+      PROFILE_MODE_NAMES[PROFILE_OPCODE_MODES[opcode]],
+      profile_opcodeCount[opcode],
+      profile_Percent(profile_opcodeCount[opcode], count),
+      (profile_opcodeTicks[opcode] * scale) / 1e6,
+      profile_Percent(profile_opcodeTicks[opcode], total),
+      (profile_opcodeTicks[opcode] * scale) / profile_opcodeCount[opcode]);
+  }
+
+  fprintf(file, "\nmode                      count       %%    time (ms)       %%    ns\n");
+  for(int mode = 0; mode < MODE_COUNT; mode++) {
+    if(!modeCount[mode]) {
+      continue;
+    }
+    fprintf(file, "%-14s     %12llu  %6.2f %12.3f  %6.2f %5.1f\n",
+      PROFILE_MODE_NAMES[mode], modeCount[mode],
+      profile_Percent(modeCount[mode], count), (modeTicks[mode] * scale) / 1e6,
+      profile_Percent(modeTicks[mode], total),
+      (modeTicks[mode] * scale) / modeCount[mode]);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// WriteRoutines
+// Lists the routines by the cycles spent within them and the routines they
+// called. A routine called recursively is only counted once.
+// ----------------------------------------------------------------------------
+static void profile_WriteRoutines(FILE* file) {
+  if(!profile_nodes) {
+    return;
+  }
+
+  // Children are always added after their parent
+  ullong clocks = 0;
+  for(uint index = 0; index < profile_nodeCount; index++) {
+    profile_nodes[index].total = profile_nodes[index].clocks;
+    clocks += profile_nodes[index].clocks;
+  }
+  for(uint index = profile_nodeCount - 1; index > 0; index--) {
+    profile_nodes[profile_nodes[index].parent].total += profile_nodes[index].total;
+  }
+
+  std::vector<profile_routine> routines;
+  for(uint index = 0; index < profile_nodeCount; index++) {
+    const profile_node& node = profile_nodes[index];
+    bool recursive = false;
+    for(uint parent = index; parent != 0 && !recursive; ) {
+      parent = profile_nodes[parent].parent;
+      recursive = profile_IsSameRoutine(parent, index);
+    }
+
+    uint routine = 0;
+    while(routine < routines.size( ) && !profile_IsSameRoutine(routines[routine].node, index)) {
+      routine++;
+    }
+    if(routine == routines.size( )) {
+      profile_routine entry = {index, 0, 0, 0};
+      routines.push_back(entry);
+    }
+    routines[routine].calls += node.calls;
+    routines[routine].clocks += node.clocks;
+    if(!recursive) {
+      routines[routine].total += node.total;
+    }
+  }
+  std::sort(routines.begin( ), routines.end( ), profile_CompareRoutines);
+
+  fprintf(file, "\nroutine                    calls        cycles       %%     inclusive       %%\n");
+  for(uint index = 0; index < routines.size( ) && index < PROFILE_REPORT_SIZE; index++) {
+    const profile_routine& routine = routines[index];
+    char name[48];
+    profile_GetNodeName(routine.node, name, sizeof(name));
+    fprintf(file, "%-22s %9llu %13.0f  %6.2f %13.0f  %6.2f\n", name,
+      routine.calls, profile_Cycles(routine.clocks),
+      profile_Percent(routine.clocks, clocks), profile_Cycles(routine.total),
+      profile_Percent(routine.total, clocks));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// WriteHotspots
+// Lists the cycles per range of the address space and the hottest addresses.
+// ----------------------------------------------------------------------------
+static void profile_WriteHotspots(FILE* file) {
+  static const char* PROFILE_RANGE_NAMES[4] = {"ram", "hsc", "rom", "bios"};
+  ullong rangeCount[4] = {0};
+  ullong rangeClocks[4] = {0};
+  std::vector<profile_hotspot> hotspots;
+  std::vector<profile_hotspot> banks;
+  ullong clocks = 0;
+
+  for(uint region = 0; region < PROFILE_REGION_COUNT; region++) {
+    if(!profile_addresses[region]) {
+      continue;
+    }
+    uint base = profile_GetRegionBase(region);
+    uint size = profile_GetRegionSize(region);
+    profile_hotspot bank = {region, 0, 0, 0};
+    for(uint offset = 0; offset < size; offset++) {
+      const profile_address& address = profile_addresses[region][offset];
+      if(!address.count) {
+        continue;
+      }
+      profile_hotspot hotspot = {region, (word)(base + offset), address.count, address.clocks};
+      hotspots.push_back(hotspot);
+      clocks += address.clocks;
+
+      uint range = 3;
+      if(region == PROFILE_REGION_MEMORY) {
+        range = (hotspot.address < 0x3000)? 0: (hotspot.address < 0x4000)? 1: 2;
+      }
+      if(region >= PROFILE_REGION_BANK) {
+        bank.count += address.count;
+        bank.clocks += address.clocks;
+      }
+      else {
+        rangeCount[range] += address.count;
+        rangeClocks[range] += address.clocks;
+      }
+    }
+    if(bank.count) {
+      banks.push_back(bank);
+    }
+  }
+  std::sort(hotspots.begin( ), hotspots.end( ), profile_CompareHotspots);
+
+  fprintf(file, "\nrange            instructions        cycles       %%\n");
+  for(uint range = 0; range < 4; range++) {
+    if(rangeCount[range]) {
+      fprintf(file, "%-16s %12llu %13.0f  %6.2f\n", PROFILE_RANGE_NAMES[range],
+        rangeCount[range], profile_Cycles(rangeClocks[range]),
+        profile_Percent(rangeClocks[range], clocks));
+    }
+  }
+  for(uint index = 0; index < banks.size( ); index++) {
+    char name[16];
+    snprintf(name, sizeof(name), "bank%u", banks[index].region - PROFILE_REGION_BANK);
+    fprintf(file, "%-16s %12llu %13.0f  %6.2f\n", name, banks[index].count,
+      profile_Cycles(banks[index].clocks),
+      profile_Percent(banks[index].clocks, clocks));
+  }
+
+  fprintf(file, "\naddress          instructions        cycles       %%\n");
+  for(uint index = 0; index < hotspots.size( ) && index < PROFILE_REPORT_SIZE; index++) {
+    const profile_hotspot& hotspot = hotspots[index];
+    char name[32];
+    profile_GetName(hotspot.region, hotspot.address, name, sizeof(name));
+    fprintf(file, "%-16s %12llu %13.0f  %6.2f\n", name, hotspot.count,
+      profile_Cycles(hotspot.clocks), profile_Percent(hotspot.clocks, clocks));
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Reset
+// ----------------------------------------------------------------------------
+void profile_Reset( ) {
+#ifdef PROSYSTEM_PROFILE
+  memset(profile_opcodeCount, 0, sizeof(profile_opcodeCount));
+  memset(profile_opcodeTicks, 0, sizeof(profile_opcodeTicks));
+  for(uint region = 0; region < PROFILE_REGION_COUNT; region++) {
+    if(profile_addresses[region]) {
+      memset(profile_addresses[region], 0, 
+        profile_GetRegionSize(region) * sizeof(profile_address));
+    }
+  }
+  profile_bankBase = profile_GetBankBase( );
+
+  // The call tree restarts from the routine being executed
+  profile_nodeCount = 0;
+  profile_current = 0;
+  profile_depth = 0;
+  profile_overflow = 0;
+  profile_AddNode(0, PROFILE_REGION_MEMORY, 0, false);
+  if(!profile_nodeCount) {
+    logger_LogError("Failed to allocate the call tree.", PROFILE_SOURCE);
+  }
+
+  profile_startTicks = profile_GetTicks( );
+  profile_startTime = stats_GetTime( );
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void profile_Release( ) {
+#ifdef PROSYSTEM_PROFILE
+  for(uint region = 0; region < PROFILE_REGION_COUNT; region++) {
+    if(profile_addresses[region]) {
+      free(profile_addresses[region]);
+      profile_addresses[region] = NULL;
+    }
+  }
+  if(profile_nodes) {
+    free(profile_nodes);
+    profile_nodes = NULL;
+  }
+  profile_nodeCount = 0;
+  profile_nodeMax = 0;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Write
+// Writes the report: the opcode and addressing mode histograms, ordered by
+// the count of executions, the routines and the hottest addresses, ordered by
+// cycles. Ticks are converted to nanoseconds using the time elapsed since the
+// last reset.
+// ----------------------------------------------------------------------------
+bool profile_Write(std::string filename) {
+#ifdef PROSYSTEM_PROFILE
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", PROFILE_SOURCE);
+    return false;
+  }
+
+  logger_LogInfo("Writing CPU profile to file " + filename + ".");
+  FILE* file = fopen(filename.c_str( ), "w");
+  if(file == NULL) {
+    logger_LogError("Failed to open the file " + filename + " for writing.", PROFILE_SOURCE);
+    return false;
+  }
+
+  profile_WriteOpcodes(file);
+  profile_WriteRoutines(file);
+  profile_WriteHotspots(file);
+
+  bool written = !ferror(file);
+  fclose(file);
+  if(!written) {
+    logger_LogError("Failed to write the CPU profile to the file " + filename + ".", PROFILE_SOURCE);
+  }
+  return written;
+#else
+  logger_LogError("CPU profiling is not enabled in this build.", PROFILE_SOURCE);
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// WriteFolded
+// Writes the call tree as folded stacks (one line per call path with the CPU
+// cycles spent in its last routine), the input of flame graph tools.
+// ----------------------------------------------------------------------------
+bool profile_WriteFolded(std::string filename) {
+#ifdef PROSYSTEM_PROFILE
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", PROFILE_SOURCE);
+    return false;
+  }
+
+  logger_LogInfo("Writing CPU call stacks to file " + filename + ".");
+  FILE* file = fopen(filename.c_str( ), "w");
+  if(file == NULL) {
+    logger_LogError("Failed to open the file " + filename + " for writing.", PROFILE_SOURCE);
+    return false;
+  }
+
+  uint path[PROFILE_MAX_DEPTH + 1];
+  for(uint index = 0; index < profile_nodeCount; index++) {
+    ullong cycles = (profile_nodes[index].clocks + 2) >> 2;
+    if(!cycles) {
+      continue;
+    }
+
+    uint depth = 0;
+    for(uint node = index; ; node = profile_nodes[node].parent) {
+      path[depth++] = node;
+      if(node == 0) {
+        break;
+      }
+    }
+    while(depth--) {
+      char name[48];
+      profile_GetNodeName(path[depth], name, sizeof(name));
+      fprintf(file, depth? "%s;": "%s", name);
+    }
+    fprintf(file, " %llu\n", cycles);
+  }
+
+  bool written = !ferror(file);
+  fclose(file);
+  if(!written) {
+    logger_LogError("Failed to write the CPU call stacks to the file " + filename + ".", PROFILE_SOURCE);
+  }
+  return written;
+#else
+  logger_LogError("CPU profiling is not enabled in this build.", PROFILE_SOURCE);
+  return false;
+#endif
+}
@@ -0,0 +1,77 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Profile.h
+// Instrumentation of the CPU. When built with PROSYSTEM_PROFILE, the count of
+// executions and the host time of each opcode, the cycles spent at each
+// address (per cartridge bank) and within each routine are recorded and can
+// be written as a report or folded call stacks. Otherwise the CPU is not
+// instrumented.
+// ----------------------------------------------------------------------------
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <string>
+#include "EmulatorContext.h"
+#include "Logger.h"
+
+#ifdef PROSYSTEM_PROFILE
+#ifdef WII
+#include <ogc/lwp_watchdog.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include "Stats.h"
+#endif
+#endif
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+
+#ifdef PROSYSTEM_PROFILE
+// Whether the BIOS is mapped (rather than the cartridge)
+extern CONTEXT_LOCAL bool profile_bios;
+
+// ----------------------------------------------------------------------------
+// GetTicks
+// Returns the cheapest host clock available (the time base on the Wii, the
+// time stamp counter on x86). Ticks are converted to time in the report.
+// ----------------------------------------------------------------------------
+static inline ullong profile_GetTicks( ) {
+#ifdef WII
+  return gettime( );
+#elif defined(__i386__) || defined(__x86_64__)
+  return __rdtsc( );
+#else
+  return stats_GetTime( );
+#endif
+}
+
+extern void profile_Instruction(word pc, byte opcode, uint clocks, ullong ticks);
+extern void profile_Interrupt( );
+#endif
+
+extern void profile_Reset( );
+extern void profile_Release( );
+extern bool profile_Write(std::string filename);
+extern bool profile_WriteFolded(std::string filename);
+
+#endif
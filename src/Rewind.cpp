@@ -0,0 +1,329 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Rewind.cpp
+// Keeps a bounded history of the machine state for rewinding. The latest
+// state is kept in full, each earlier one as the XOR of it and its successor
+// (run-length encoded, the bulk of the RAM doesn't change from one frame to
+// the next). Stepping back decodes the newest delta into the full state, the
+// oldest deltas are dropped when the buffer is full.
+// ----------------------------------------------------------------------------
+#include <malloc.h>
+#include <string.h>
+#include "Rewind.h"
+#include "ProSystem.h"
+
+#define REWIND_SOURCE "Rewind.cpp"
+
+// The minimum count of unchanged bytes that ends a run of changed bytes
+#define REWIND_MIN_SKIP 4
+
+typedef struct {
+  uint offset;
+  uint size;
+} rewind_entry;
+
+// The deltas are stored back to back in a circular pool
+static CONTEXT_LOCAL byte* rewind_pool = NULL;
+static CONTEXT_LOCAL uint rewind_poolSize = 0;
+static CONTEXT_LOCAL rewind_entry* rewind_entries = NULL;
+static CONTEXT_LOCAL uint rewind_entryMax = 0;
+static CONTEXT_LOCAL uint rewind_first = 0;
+static CONTEXT_LOCAL uint rewind_count = 0;
+static CONTEXT_LOCAL uint rewind_used = 0;
+
+// The latest state, the state being captured and the encoded delta
+static CONTEXT_LOCAL byte* rewind_state = NULL;
+static CONTEXT_LOCAL byte* rewind_next = NULL;
+static CONTEXT_LOCAL byte* rewind_delta = NULL;
+static CONTEXT_LOCAL uint rewind_stateSize = 0;
+static CONTEXT_LOCAL bool rewind_stateValid = false;
+
+static CONTEXT_LOCAL uint rewind_interval = 1;
+static CONTEXT_LOCAL uint rewind_frames = 0;
+
+// ----------------------------------------------------------------------------
+// WriteCount
+// ----------------------------------------------------------------------------
+static inline void rewind_WriteCount(byte*& data, uint count) {
+  while(count >= 0x80) {
+    *data++ = (count & 0x7f) | 0x80;
+    count >>= 7;
+  }
+  *data++ = count;
+}
+
+// ----------------------------------------------------------------------------
+// ReadCount
+// ----------------------------------------------------------------------------
+static inline uint rewind_ReadCount(const byte*& data) {
+  uint count = 0;
+  uint shift = 0;
+  byte value;
+  do {
+    value = *data++;
+    count |= (value & 0x7f) << shift;
+    shift += 7;
+  } while(value & 0x80);
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+// Encode
+// Encodes the XOR of two states as runs of unchanged bytes (a count) and
+// changed bytes (a count followed by the XOR of the bytes). Returns the size
+// of the delta, identical states are encoded as an empty run so that every
+// delta takes up room in the pool (see Evict).
+// ----------------------------------------------------------------------------
+static uint rewind_Encode(const byte* from, const byte* to, uint size, byte* delta) {
+  byte* data = delta;
+  uint index = 0;
+  while(index < size) {
+    uint start = index;
+    while(index < size && from[index] == to[index]) {
+      index++;
+    }
+    uint skip = index - start;
+    if(index == size) {
+      break;
+    }
+
+    // Changed bytes, up to the next run of unchanged ones
+    start = index;
+    uint end = index;
+    while(end < size) {
+      if(from[end] != to[end]) {
+        index = ++end;
+      }
+      else if(end - index < REWIND_MIN_SKIP) {
+        end++;
+      }
+      else {
+        break;
+      }
+    }
+    rewind_WriteCount(data, skip);
+    rewind_WriteCount(data, index - start);
+    for(uint changed = start; changed < index; changed++) {
+      *data++ = from[changed] ^ to[changed];
+    }
+  }
+  if(data == delta) {
+    rewind_WriteCount(data, 0);
+    rewind_WriteCount(data, 0);
+  }
+  return data - delta;
+}
+
+// ----------------------------------------------------------------------------
+// Decode
+// Applies a delta to a state (in place).
+// ----------------------------------------------------------------------------
+static void rewind_Decode(byte* state, const byte* delta, uint size) {
+  const byte* data = delta;
+  const byte* end = delta + size;
+  while(data < end) {
+    state += rewind_ReadCount(data);
+    uint count = rewind_ReadCount(data);
+    for(uint index = 0; index < count; index++) {
+      *state++ ^= *data++;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Drop
+// Drops the oldest delta.
+// ----------------------------------------------------------------------------
+static inline void rewind_Drop( ) {
+  rewind_used -= rewind_entries[rewind_first].size;
+  rewind_first = (rewind_first + 1) % rewind_entryMax;
+  rewind_count--;
+}
+
+// ----------------------------------------------------------------------------
+// Evict
+// Drops the oldest deltas that overlap the specified region of the pool.
+// Going forward from the end of the newest delta, the oldest is always the
+// first one met.
+// ----------------------------------------------------------------------------
+static void rewind_Evict(uint offset, uint size) {
+  while(rewind_count) {
+    const rewind_entry* oldest = &rewind_entries[rewind_first];
+    if(oldest->offset >= offset + size || offset >= oldest->offset + oldest->size) {
+      return;
+    }
+    rewind_Drop( );
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Push
+// Stores a delta as the newest entry.
+// ----------------------------------------------------------------------------
+static void rewind_Push(const byte* delta, uint size) {
+  if(rewind_count == rewind_entryMax) {
+    rewind_Drop( );
+  }
+
+  uint offset = 0;
+  if(rewind_count) {
+    const rewind_entry* newest = &rewind_entries[(rewind_first + rewind_count - 1) % rewind_entryMax];
+    offset = newest->offset + newest->size;
+    if(offset + size > rewind_poolSize) {
+      // Wrap, the deltas at the end of the pool are the oldest
+      rewind_Evict(offset, rewind_poolSize - offset);
+      offset = 0;
+    }
+  }
+  rewind_Evict(offset, size);
+
+  rewind_entry* entry = &rewind_entries[(rewind_first + rewind_count) % rewind_entryMax];
+  entry->offset = offset;
+  entry->size = size;
+  memcpy(rewind_pool + offset, delta, size);
+  rewind_count++;
+  rewind_used += size;
+}
+
+// ----------------------------------------------------------------------------
+// Initialize
+// Allocates a rewind buffer of the specified size (bytes) for the loaded
+// cartridge, capturing a state every interval frames.
+// ----------------------------------------------------------------------------
+bool rewind_Initialize(uint size, uint interval) {
+  rewind_Release( );
+
+  rewind_stateSize = prosystem_GetStateSize( );
+  rewind_poolSize = size;
+  // One entry per 8 bytes of the pool, when they run out the oldest delta is
+  // dropped even if the pool has room
+  rewind_entryMax = size / 8;
+  rewind_interval = interval? interval: 1;
+
+  rewind_pool = (byte*)malloc(rewind_poolSize);
+  rewind_entries = (rewind_entry*)malloc(rewind_entryMax * sizeof(rewind_entry));
+  rewind_state = (byte*)malloc(rewind_stateSize);
+  rewind_next = (byte*)malloc(rewind_stateSize);
+  rewind_delta = (byte*)malloc(2 * rewind_stateSize + 16);
+  if(!rewind_pool || !rewind_entries || !rewind_state || !rewind_next || !rewind_delta) {
+    logger_LogError("Failed to allocate the rewind buffer.", REWIND_SOURCE);
+    rewind_Release( );
+    return false;
+  }
+  rewind_Reset( );
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Release
+// ----------------------------------------------------------------------------
+void rewind_Release( ) {
+  free(rewind_pool);
+  free(rewind_entries);
+  free(rewind_state);
+  free(rewind_next);
+  free(rewind_delta);
+  rewind_pool = NULL;
+  rewind_entries = NULL;
+  rewind_state = NULL;
+  rewind_next = NULL;
+  rewind_delta = NULL;
+  rewind_poolSize = 0;
+  rewind_entryMax = 0;
+  rewind_Reset( );
+}
+
+// ----------------------------------------------------------------------------
+// Reset
+// Discards the history (after a reset or a load of the machine).
+// ----------------------------------------------------------------------------
+void rewind_Reset( ) {
+  rewind_first = 0;
+  rewind_count = 0;
+  rewind_used = 0;
+  rewind_frames = 0;
+  rewind_stateValid = false;
+}
+
+// ----------------------------------------------------------------------------
+// Capture
+// Captures the state of the machine, called after each frame. Only every
+// interval-th frame is kept.
+// ----------------------------------------------------------------------------
+bool rewind_Capture( ) {
+  if(rewind_pool == NULL) {
+    return false;
+  }
+  if(rewind_frames++ % rewind_interval) {
+    return true;
+  }
+  if(!prosystem_SaveToBuffer(rewind_next, rewind_stateSize)) {
+    return false;
+  }
+  if(rewind_stateValid) {
+    uint size = rewind_Encode(rewind_next, rewind_state, rewind_stateSize, rewind_delta);
+    if(size > rewind_poolSize) {
+      rewind_Reset( );
+    }
+    else {
+      rewind_Push(rewind_delta, size);
+    }
+  }
+
+  byte* state = rewind_state;
+  rewind_state = rewind_next;
+  rewind_next = state;
+  rewind_stateValid = true;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Step
+// Restores the state captured prior to the latest one. Returns false when
+// the history is exhausted.
+// ----------------------------------------------------------------------------
+bool rewind_Step( ) {
+  if(rewind_pool == NULL || !rewind_count) {
+    return false;
+  }
+  const rewind_entry* newest = &rewind_entries[(rewind_first + rewind_count - 1) % rewind_entryMax];
+  rewind_Decode(rewind_state, rewind_pool + newest->offset, newest->size);
+  rewind_count--;
+  rewind_used -= newest->size;
+  rewind_frames = 1;
+  return prosystem_LoadFromBuffer(rewind_state, rewind_stateSize);
+}
+
+// ----------------------------------------------------------------------------
+// GetCount
+// Returns the count of states that can be stepped back to.
+// ----------------------------------------------------------------------------
+uint rewind_GetCount( ) {
+  return rewind_count;
+}
+
+// ----------------------------------------------------------------------------
+// GetUsed
+// Returns the size of the deltas in the buffer (bytes).
+// ----------------------------------------------------------------------------
+uint rewind_GetUsed( ) {
+  return rewind_used;
+}
@@ -23,22 +23,35 @@
 // Riot.cpp
 // ----------------------------------------------------------------------------
 #include "Riot.h"
+#include "ProSystem.h"
+#include "State.h"
+#include "Stats.h"
 
+#ifdef WII
 #include "wii_main.h"
+#endif
 
-bool riot_timing = false;
-word riot_timer = TIM64T;
-byte riot_intervals;
-word riot_clocks;
+CONTEXT_LOCAL bool riot_timing = false;
+CONTEXT_LOCAL word riot_timer = TIM64T;
+CONTEXT_LOCAL byte riot_intervals;
+CONTEXT_LOCAL word riot_clocks;
 
-byte riot_dra = 0;
-byte riot_drb = 0;
+CONTEXT_LOCAL byte riot_dra = 0;
+CONTEXT_LOCAL byte riot_drb = 0;
 
-static bool riot_elapsed;
-static int riot_currentTime;
+// The timer is evaluated lazily. riot_count is the count of the timer (in
+// cycles) at riot_start, the RIOT clock at which it was armed (or elapsed).
+// INTIM is only computed when it is read or the state is saved.
+static CONTEXT_LOCAL bool riot_elapsed;
+static CONTEXT_LOCAL int riot_count;
+static CONTEXT_LOCAL uint riot_start;
 
-// Debug, count the number of times a RIOT timer was used
-unsigned int riot_timer_count = 0;
+// The RIOT clock (in CPU cycles) at riot_cycles, the value of prosystem_cycles
+// it was last brought up to date with. riot_half_cycles is the count of CPU
+// half cycles (see Sally.cpp) executed since.
+static CONTEXT_LOCAL uint riot_clock = 0;
+static CONTEXT_LOCAL uint riot_cycles = 0;
+CONTEXT_LOCAL uint riot_half_cycles = 0;
 
 void riot_Reset(void) {
     riot_SetDRA(0);
@@ -50,9 +63,11 @@ void riot_Reset(void) {
     riot_clocks = 0;
 
     riot_elapsed = false;
-    riot_currentTime = 0;
-
-    riot_timer_count = 0; // debug    
+    riot_count = 0;
+    riot_start = 0;
+    riot_clock = 0;
+    riot_cycles = 0;
+    riot_half_cycles = 0;
 }
 
 // ----------------------------------------------------------------------------
@@ -228,6 +243,7 @@ void riot_SetDRB(byte data) {
 // SetTimer
 // ----------------------------------------------------------------------------
 void riot_SetTimer(word timer, byte intervals) {
+  riot_Sync( );
   riot_timer = timer;
   riot_intervals = intervals;
   switch(timer) {
@@ -249,37 +265,156 @@ void riot_SetTimer(word timer, byte intervals) {
       break;
   }
   if(riot_timing) {
-#if 1
-riot_timer_count++; // debug
-#endif
-    riot_currentTime = riot_clocks * intervals;
+    STATS_ADD(timer_writes, 1);
+    riot_count = riot_clocks * intervals;
+    riot_start = riot_clock;
     riot_elapsed = false;
+
+    // End the current CPU run so that the expiry is scheduled
+    prosystem_event = 0;
   }
 }
 
 // ----------------------------------------------------------------------------
 // UpdateTimer
+// Computes INTIM from the cycles that have elapsed since the timer was armed
+// (or elapsed). A freshly armed timer leaves INTIM untouched until a cycle
+// has passed, as does an elapsed one (which reads 0 at the instant it
+// elapses).
 // ----------------------------------------------------------------------------
-void riot_UpdateTimer(byte cycles) {
-  riot_currentTime -= cycles;
-  if(!riot_elapsed && riot_currentTime > 0) {
-    memory_Write(INTIM, riot_currentTime / riot_clocks);
+void riot_UpdateTimer( ) {
+  if(!riot_timing) {
+    return;
+  }
+  riot_Sync( );
+  uint cycles = riot_clock - riot_start;
+  if(!cycles) {
+    return;
+  }
+  int time = riot_count - (int)cycles;
+  if(!riot_elapsed) {
+    memory_Write(INTIM, time / riot_clocks);
+  }
+  else if(time >= -255) {
+    memory_Write(INTIM, time);
   }
   else {
-    if(riot_elapsed) {
-      if(riot_currentTime >= -255) {
-        memory_Write(INTIM, riot_currentTime);
-      }
-      else {
-        memory_Write(INTIM, 0);
-        riot_timing = false;
-      }
-    }
-    else {
-      riot_currentTime = riot_clocks;
-      memory_Write(INTIM, 0);
-	  memory_ram[INTFLG] |= 0x80;
-      riot_elapsed = true;
-    }
+    memory_Write(INTIM, 0);
+    riot_timing = false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Sync
+// Brings the RIOT clock up to date with the CPU cycles executed since it was
+// last synced and checks whether the timer has elapsed.
+// ----------------------------------------------------------------------------
+void riot_Sync( ) {
+  riot_clock += (prosystem_cycles - riot_cycles - (riot_half_cycles << 1)) >> 2;
+  riot_Rebase( );
+
+  if(riot_timing && !riot_elapsed && 
+     (int)(riot_clock - riot_start) >= riot_count) {
+    riot_count = riot_clocks;
+    riot_start = riot_clock;
+    riot_elapsed = true;
+    memory_Write(INTIM, 0);
+    memory_ram[INTFLG] |= 0x80;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Advance
+// Advances the RIOT clock by the cycles that were not executed by the CPU
+// (Maria DMA, the remainder of a scanline after WSYNC). prosystem_cycles must
+// have been synced before the cycles were added to it.
+// ----------------------------------------------------------------------------
+void riot_Advance(uint cycles) {
+  riot_clock += cycles;
+  riot_Rebase( );
+  riot_Sync( );
+}
+
+// ----------------------------------------------------------------------------
+// Rebase
+// Marks the RIOT clock as up to date with prosystem_cycles, called after the
+// cycle count has been adjusted outside of the CPU.
+// ----------------------------------------------------------------------------
+void riot_Rebase( ) {
+  riot_cycles = prosystem_cycles;
+  riot_half_cycles = 0;
+}
+
+// ----------------------------------------------------------------------------
+// GetEvent
+// Returns the cycle at (or before) which the timer elapses. The CPU must stop
+// there so that the underflow lands on the same instruction as when the timer
+// was updated after every instruction.
+// ----------------------------------------------------------------------------
+uint riot_GetEvent( ) {
+  if(!riot_timing || riot_elapsed) {
+    return ~0U;
+  }
+  int remaining = riot_count - (int)(riot_clock - riot_start);
+  return remaining > 0 ? riot_cycles + (remaining << 2) : riot_cycles;
+}
+
+// ----------------------------------------------------------------------------
+// GetStable
+// Returns the cycle before which reads of INTIM keep returning the count they
+// returned since the given cycle, or that cycle if they may not. The count
+// holds for riot_clocks cycles while the timer runs.
+// ----------------------------------------------------------------------------
+uint riot_GetStable(uint since) {
+  if(!riot_timing) {
+    return ~0U;
+  }
+  int elapsed = (int)(prosystem_cycles - since) >> 2;
+  int cycles = (int)(riot_clock - riot_start) +
+    (int)((prosystem_cycles - riot_cycles - (riot_half_cycles << 1)) >> 2);
+  int time = riot_count - cycles;
+  if(riot_elapsed || time <= 0 || cycles - elapsed < 1) {
+    return since;
+  }
+  int count = time / riot_clocks;
+  if(time + elapsed >= (count + 1) * riot_clocks) {
+    return since;
   }
+  return prosystem_cycles + ((time - count * riot_clocks) << 2);
+}
+
+// ----------------------------------------------------------------------------
+// SaveState
+// ----------------------------------------------------------------------------
+void riot_SaveState(byte* buffer, uint& offset) {
+  state_WriteByte(buffer, offset, riot_timing);
+  state_WriteWord(buffer, offset, riot_timer);
+  state_WriteByte(buffer, offset, riot_intervals);
+  state_WriteWord(buffer, offset, riot_clocks);
+  state_WriteByte(buffer, offset, riot_dra);
+  state_WriteByte(buffer, offset, riot_drb);
+  state_WriteByte(buffer, offset, riot_elapsed);
+  state_WriteUint(buffer, offset, riot_count);
+  state_WriteUint(buffer, offset, riot_start);
+  state_WriteUint(buffer, offset, riot_clock);
+  state_WriteUint(buffer, offset, riot_cycles);
+  state_WriteUint(buffer, offset, riot_half_cycles);
+}
+
+// ----------------------------------------------------------------------------
+// LoadState
+// ----------------------------------------------------------------------------
+void riot_LoadState(const byte* buffer, uint& offset) {
+  riot_timing = state_ReadByte(buffer, offset);
+  riot_timer = state_ReadWord(buffer, offset);
+  riot_intervals = state_ReadByte(buffer, offset);
+  riot_clocks = state_ReadWord(buffer, offset);
+  riot_dra = state_ReadByte(buffer, offset);
+  riot_drb = state_ReadByte(buffer, offset);
+  riot_elapsed = state_ReadByte(buffer, offset);
+  riot_count = (int)state_ReadUint(buffer, offset);
+  riot_start = state_ReadUint(buffer, offset);
+  riot_clock = state_ReadUint(buffer, offset);
+  riot_cycles = state_ReadUint(buffer, offset);
+  riot_half_cycles = state_ReadUint(buffer, offset);
 }
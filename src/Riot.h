@@ -26,23 +26,34 @@
 #define RIOT_H
 
 #include "Equates.h"
+#include "EmulatorContext.h"
 #include "Memory.h"
 
 typedef unsigned char byte;
 typedef unsigned short word;
 typedef unsigned int uint;
 
+#define RIOT_STATE_SIZE 29
+
 extern void riot_Reset(void);
 extern void riot_SetInput(const byte* input);
 extern void riot_SetDRA(byte data);
 extern void riot_SetDRB(byte data);
 extern void riot_SetTimer(word timer, byte intervals);
-extern void riot_UpdateTimer(byte cycles);
-extern bool riot_timing;
-extern word riot_timer;
-extern byte riot_intervals;
-extern byte riot_dra;
-extern byte riot_drb;
-extern word riot_clocks;
+extern void riot_UpdateTimer( );
+extern void riot_Sync( );
+extern void riot_Advance(uint cycles);
+extern void riot_Rebase( );
+extern uint riot_GetEvent( );
+extern uint riot_GetStable(uint since);
+extern void riot_SaveState(byte* buffer, uint& offset);
+extern void riot_LoadState(const byte* buffer, uint& offset);
+extern CONTEXT_LOCAL bool riot_timing;
+extern CONTEXT_LOCAL word riot_timer;
+extern CONTEXT_LOCAL byte riot_intervals;
+extern CONTEXT_LOCAL byte riot_dra;
+extern CONTEXT_LOCAL byte riot_drb;
+extern CONTEXT_LOCAL word riot_clocks;
+extern CONTEXT_LOCAL uint riot_half_cycles;
 
 #endif
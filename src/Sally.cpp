@@ -24,23 +24,36 @@
 // ----------------------------------------------------------------------------
 #include "Sally.h"
 #include "Cartridge.h"
-
-byte sally_a = 0;
-byte sally_x = 0;
-byte sally_y = 0;
-byte sally_p = 0;
-byte sally_s = 0;
-pair sally_pc = {0};
-
-static byte sally_opcode;
-static pair sally_address;
-static uint sally_cycles;
+#include "Jit.h"
+#include "Profile.h"
+#include "ProSystem.h"
+#include "Stats.h"
+#include <string.h>
+
+#define SALLY_SOURCE "Sally.cpp"
+
+CONTEXT_LOCAL byte sally_a = 0;
+CONTEXT_LOCAL byte sally_x = 0;
+CONTEXT_LOCAL byte sally_y = 0;
+CONTEXT_LOCAL byte sally_s = 0;
+CONTEXT_LOCAL pair sally_pc = {0};
+
+// The N and Z flags are evaluated lazily: N is bit 7 of sally_n and Z is set
+// when sally_z is zero, their bits in sally_p are only valid after Pack.
+static CONTEXT_LOCAL byte sally_p = 0;
+static CONTEXT_LOCAL byte sally_n = 0;
+static CONTEXT_LOCAL byte sally_z = 1;
+
+static CONTEXT_LOCAL byte sally_opcode;
+static CONTEXT_LOCAL pair sally_address;
+static CONTEXT_LOCAL uint sally_cycles;
+static CONTEXT_LOCAL pair sally_operand;
 
 // Whether the last operation resulted in a half cycle. (needs to be taken 
 // into consideration by ProSystem when cycle counting). This can occur when
 // a TIA or RIOT are accessed (drops to 1.19Mhz when the TIA or RIOT chips 
 // are accessed)
-bool half_cycle = false;
+CONTEXT_LOCAL bool half_cycle = false;
 
 struct Flag {
   byte C;
@@ -64,7 +77,7 @@ static const Vector SALLY_RES = {65533, 65532};
 static const Vector SALLY_NMI = {65531, 65530};
 static const Vector SALLY_IRQ = {65535, 65534}; 
 
-static const byte SALLY_CYCLES[256] = {
+const byte SALLY_CYCLES[256] = {
 	7,6,0,0,0,3,5,0,3,2,2,0,0,4,6,0, // 0 - 15
 	2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0, // 16 - 31
 	6,6,0,0,3,3,5,0,4,2,2,0,4,4,6,0, // 32 - 47
@@ -83,6 +96,94 @@ static const byte SALLY_CYCLES[256] = {
 	2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0, // 240 - 255
 };
 
+// The length of the instructions (illegal opcodes are executed as one byte)
+const byte SALLY_LENGTHS[256] = {
+	1,2,1,1,1,2,2,1,1,2,1,1,1,3,3,1, // 0 - 15
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 16 - 31
+	3,2,1,1,2,2,2,1,1,2,1,1,3,3,3,1, // 32 - 47
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 48 - 63
+	1,2,1,1,1,2,2,1,1,2,1,1,3,3,3,1, // 64 - 79
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 80 - 95
+	1,2,1,1,1,2,2,1,1,2,1,1,3,3,3,1, // 96 - 111
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 112 - 127
+	1,2,1,1,2,2,2,1,1,1,1,1,3,3,3,1, // 128 - 143
+	2,2,1,1,2,2,2,1,1,3,1,1,1,3,1,1, // 144 - 159
+	2,2,2,1,2,2,2,1,1,2,1,1,3,3,3,1, // 160 - 175
+	2,2,1,1,2,2,2,1,1,3,1,1,3,3,3,1, // 176 - 191
+	2,2,1,1,2,2,2,1,1,2,1,1,3,3,3,1, // 192 - 207
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 208 - 223
+	2,2,1,1,2,2,2,1,1,2,1,1,3,3,3,1, // 224 - 239
+	2,2,1,1,1,2,2,1,1,3,1,1,1,3,3,1, // 240 - 255
+};
+
+// ----------------------------------------------------------------------------
+// Predecoded instructions
+// Each address holds the decoded form of the instruction starting there. An
+// entry is valid while its generation matches the generation of its page,
+// pages that can change underneath the cpu are never cached.
+// ----------------------------------------------------------------------------
+typedef struct {
+  uint generation;
+  pair operand;
+  byte opcode;
+  byte cycles;
+  byte length;
+  word handler;
+} sally_entry;
+
+// ----------------------------------------------------------------------------
+// Fused instructions
+// The handlers of frequent pairs of instructions (see Fuse), dispatched in
+// place of the opcode of the first one.
+// ----------------------------------------------------------------------------
+#define SALLY_LDA_ZP_STA_ZP 256
+#define SALLY_LDA_ZP_STA_ABS 257
+#define SALLY_LDA_IMM_STA_ZP 258
+#define SALLY_LDA_IMM_STA_ABS 259
+#define SALLY_LDA_INDY_STA_INDY 260
+#define SALLY_LDA_INDY_STA_ABSX 261
+#define SALLY_DEX_BNE 262
+#define SALLY_DEY_BNE 263
+#define SALLY_CMP_IMM_BEQ 264
+#define SALLY_CMP_IMM_BNE 265
+
+static CONTEXT_LOCAL sally_entry sally_cache[MEMORY_SIZE];
+CONTEXT_LOCAL uint sally_pages[256];
+static CONTEXT_LOCAL uint sally_generation = 0;
+
+// ----------------------------------------------------------------------------
+// Idle loops
+// The last backward branch taken within the run and the state at its target
+// (see Idle). While verifying, the iterations up to the cycle are checked.
+// ----------------------------------------------------------------------------
+#define SALLY_IDLE_LENGTH 32
+
+typedef struct {
+  bool valid;
+  bool verify;
+  word pc;
+  word branch;
+  byte a;
+  byte x;
+  byte y;
+  byte s;
+  byte p;
+  byte flag;
+  uint cycle;
+  uint iteration;
+  uint until;
+} sally_idleState;
+
+// The profiler records every instruction executed
+#ifdef PROSYSTEM_PROFILE
+byte sally_idle = SALLY_IDLE_OFF;
+#else
+byte sally_idle = SALLY_IDLE_SKIP;
+static CONTEXT_LOCAL sally_idleState sally_loop;
+#endif
+CONTEXT_LOCAL uint sally_idleLoops = 0;
+CONTEXT_LOCAL uint sally_idleErrors = 0;
+
 #if 0
 static char msg[512];
 #endif
@@ -135,20 +236,214 @@ sprintf( msg, "Flags: %d", data );
 logger_LogInfo( msg );
 #endif
 
-  if(!data) {
+  sally_n = data;
+  sally_z = data;
+}
+
+// ----------------------------------------------------------------------------
+// Pack
+// Stores the lazy N and Z flags to P
+// ----------------------------------------------------------------------------
+static inline void sally_Pack( ) {
+  sally_p &= ~(SALLY_FLAG.N | SALLY_FLAG.Z);
+  sally_p |= sally_n & SALLY_FLAG.N;
+  if(!sally_z) {
     sally_p |= SALLY_FLAG.Z;
   }
-  else {
-    sally_p &= ~SALLY_FLAG.Z;
+}
+
+// ----------------------------------------------------------------------------
+// Unpack
+// Loads the lazy N and Z flags from P
+// ----------------------------------------------------------------------------
+static inline void sally_Unpack( ) {
+  sally_n = sally_p;
+  sally_z = !(sally_p & SALLY_FLAG.Z);
+}
+
+#ifndef PROSYSTEM_PROFILE
+// ----------------------------------------------------------------------------
+// IdleRead
+// Whether the loop may read the addresses, memory that only changes between
+// runs or the RIOT (see Idle). An indexed read may reach INTIM anywhere from
+// the first to the last address.
+// ----------------------------------------------------------------------------
+static inline bool sally_IdleRead(word first, word last, bool& riot, bool& timer) {
+  if(memory_readPages[first >> 8] == NULL && (first >> 8) != 0x02) {
+    return false;
   }
-  if(data & 128) {
-    sally_p |= SALLY_FLAG.N;
+  if(memory_readPages[last >> 8] == NULL && (last >> 8) != 0x02) {
+    return false;
   }
-  else {
-    sally_p &= ~SALLY_FLAG.N;
+  if((first >> 8) == 0x02 || (last >> 8) == 0x02) {
+    riot = true;
+    timer |= first != last || (first & ~2) == INTIM;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// IdleLoop
+// Returns the count of instructions of the loop from the address to (and
+// including) the branch if they only change the registers and read memory
+// at fixed addresses, otherwise 0. The loop must not branch or jump before
+// the branch. Counts the half cycles (see BIT) of an iteration and whether
+// it reads the RIOT and its timer.
+// ----------------------------------------------------------------------------
+static uint sally_IdleLoop(word address, word branch, uint& half, bool& riot,
+                           bool& timer) {
+  if(address > branch || branch - address > SALLY_IDLE_LENGTH ||
+     memory_readPages[address >> 8] == NULL ||
+     memory_readPages[branch >> 8] == NULL) {
+    return 0;
+  }
+  uint count = 1;
+  half = 0;
+  riot = false;
+  timer = false;
+  while(address < branch) {
+    byte opcode = memory_Read(address);
+    if(address + SALLY_LENGTHS[opcode] > branch) {
+      return 0;
+    }
+    pair operand = {0};
+    if(SALLY_LENGTHS[opcode] > 1) {
+      operand.b.l = memory_Read(address + 1);
+    }
+    if(SALLY_LENGTHS[opcode] > 2) {
+      operand.b.h = memory_Read(address + 2);
+    }
+    switch(opcode) {
+      // Implied, accumulator and immediate
+      case 0x09: case 0x0a: case 0x18: case 0x29: case 0x2a: case 0x38:
+      case 0x49: case 0x4a: case 0x58: case 0x69: case 0x6a: case 0x78:
+      case 0x88: case 0x8a: case 0x98: case 0x9a: case 0xa0: case 0xa2:
+      case 0xa8: case 0xa9: case 0xaa: case 0xb8: case 0xba: case 0xc0:
+      case 0xc8: case 0xc9: case 0xca: case 0xd8: case 0xe0: case 0xe8:
+      case 0xe9: case 0xea: case 0xf8:
+        break;
+
+      // Zero page, indexed ones wrap within it
+      case 0x24:
+        if(operand.b.l == INPT4) {
+          half++;
+        }
+        break;
+      case 0x05: case 0x15: case 0x25: case 0x35: case 0x45: case 0x55:
+      case 0x65: case 0x75: case 0xa4: case 0xa5: case 0xa6: case 0xb4:
+      case 0xb5: case 0xb6: case 0xc4: case 0xc5: case 0xd5: case 0xe4:
+      case 0xe5: case 0xf5:
+        break;
+
+      // Absolute
+      case 0x0d: case 0x2c: case 0x2d: case 0x4d: case 0x6d: case 0xac:
+      case 0xad: case 0xae: case 0xcc: case 0xcd: case 0xec: case 0xed:
+        if(!sally_IdleRead(operand.w, operand.w, riot, timer)) {
+          return 0;
+        }
+        break;
+
+      // Absolute indexed, any of the pages the index can reach
+      case 0x19: case 0x1d: case 0x39: case 0x3d: case 0x59: case 0x5d:
+      case 0x79: case 0x7d: case 0xb9: case 0xbc: case 0xbd: case 0xbe:
+      case 0xd9: case 0xdd: case 0xf9: case 0xfd:
+        if(!sally_IdleRead(operand.w, operand.w + 255, riot, timer)) {
+          return 0;
+        }
+        break;
+
+      default:
+        return 0;
+    }
+    address += SALLY_LENGTHS[opcode];
+    count++;
   }
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+// IdleError
+// ----------------------------------------------------------------------------
+static void sally_IdleError( ) {
+  char message[64];
+  sprintf(message, "Idle loop at %04x was not idle.", sally_loop.pc);
+  logger_LogError(message, SALLY_SOURCE);
+  sally_idleErrors++;
+  sally_loop.verify = false;
 }
 
+// ----------------------------------------------------------------------------
+// Idle
+// Called when a branch at the address is taken backward. A loop whose
+// iteration leaves the registers as they were is idle if it only reads
+// memory that can't change until the end of the run (see IdleLoop), the
+// iterations up to the event then only advance the cycles and are skipped.
+// INTFLG must be clear when the RIOT is read, INTIM also limits the
+// iterations skipped (see riot_GetStable).
+// When verifying, the iterations are interpreted and checked instead.
+// ----------------------------------------------------------------------------
+static void sally_Idle(word branch) {
+  sally_Pack( );
+  uint cycle = prosystem_cycles + (sally_cycles << 2);
+  bool same = sally_loop.valid && sally_loop.pc == sally_pc.w &&
+    sally_loop.branch == branch && sally_loop.a == sally_a && sally_loop.x == sally_x &&
+    sally_loop.y == sally_y && sally_loop.s == sally_s &&
+    sally_loop.p == sally_p;
+
+  if(sally_loop.verify) {
+    if(!same || cycle - sally_loop.cycle != sally_loop.iteration) {
+      sally_IdleError( );
+    }
+    else if(cycle == sally_loop.until) {
+      sally_loop.verify = false;
+    }
+  }
+  else if(same) {
+    uint iteration = cycle - sally_loop.cycle;
+    uint half;
+    bool riot;
+    bool timer;
+    uint count = sally_IdleLoop(sally_pc.w, branch, half, riot, timer);
+    uint until = prosystem_event;
+    if(count && riot && (sally_loop.flag & 0x80)) {
+      until = sally_loop.cycle;
+    }
+    else if(count && timer) {
+      uint stable = riot_GetStable(sally_loop.cycle);
+      if(stable < until) {
+        until = stable;
+      }
+    }
+    if(count && cycle < until && until - cycle > iteration) {
+      uint skip = (until - cycle - 1) / iteration;
+      if(sally_idle == SALLY_IDLE_VERIFY) {
+        sally_loop.verify = true;
+        sally_loop.iteration = iteration;
+        sally_loop.until = cycle + skip * iteration;
+      }
+      else {
+        prosystem_cycles += skip * iteration;
+        riot_half_cycles += skip * half;
+        STATS_ADD(instructions, skip * count);
+        cycle += skip * iteration;
+      }
+      sally_idleLoops++;
+    }
+  }
+
+  sally_loop.valid = true;
+  sally_loop.pc = sally_pc.w;
+  sally_loop.branch = branch;
+  sally_loop.a = sally_a;
+  sally_loop.x = sally_x;
+  sally_loop.y = sally_y;
+  sally_loop.s = sally_s;
+  sally_loop.p = sally_p;
+  sally_loop.flag = memory_ram[INTFLG];
+  sally_loop.cycle = cycle;
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // Branch
 // ----------------------------------------------------------------------------
@@ -168,6 +463,12 @@ logger_LogInfo( msg );
     else {
       sally_cycles++;
     }
+
+#ifndef PROSYSTEM_PROFILE
+    if(sally_idle && sally_pc.w < temp.w) {
+      sally_Idle(temp.w - 2);
+    }
+#endif
   }
 }
 
@@ -197,8 +498,7 @@ sprintf( msg, "Absolute" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.b.l = memory_Read(sally_pc.w++);
-  sally_address.b.h = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.w;
 }
 
 // ----------------------------------------------------------------------------
@@ -210,8 +510,7 @@ sprintf( msg, "AbsoluteX" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.b.l = memory_Read(sally_pc.w++);
-  sally_address.b.h = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.w;
   sally_address.w += sally_x;
 }
 
@@ -224,8 +523,7 @@ sprintf( msg, "AbsoluteY" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.b.l = memory_Read(sally_pc.w++);
-  sally_address.b.h = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.w;
   sally_address.w += sally_y;
 }
 
@@ -238,7 +536,7 @@ sprintf( msg, "Immediate" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.w = sally_pc.w++;
+  sally_address.w = sally_pc.w - 1;
 }
 
 // ----------------------------------------------------------------------------
@@ -251,8 +549,7 @@ logger_LogInfo( msg );
 #endif
 
   pair base;
-  base.b.l = memory_Read(sally_pc.w++);
-  base.b.h = memory_Read(sally_pc.w++);
+  base.w = sally_operand.w;
   sally_address.b.l = memory_Read(base.w);
   sally_address.b.h = memory_Read(base.w + 1);
 }
@@ -266,7 +563,7 @@ sprintf( msg, "IndirectX" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.b.l = memory_Read(sally_pc.w++) + sally_x;
+  sally_address.b.l = sally_operand.b.l + sally_x;
   sally_address.b.h = memory_Read(sally_address.b.l + 1);
   sally_address.b.l = memory_Read(sally_address.b.l);
 }
@@ -280,7 +577,7 @@ sprintf( msg, "IndirectY" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.b.l = memory_Read(sally_pc.w++);
+  sally_address.b.l = sally_operand.b.l;
   sally_address.b.h = memory_Read(sally_address.b.l + 1);
   sally_address.b.l = memory_Read(sally_address.b.l);
   sally_address.w += sally_y;
@@ -295,7 +592,7 @@ sprintf( msg, "Relative" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.w = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.b.l;
 }
 
 // ----------------------------------------------------------------------------
@@ -307,7 +604,7 @@ sprintf( msg, "ZeroPage" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.w = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.b.l;
 }
 
 // ----------------------------------------------------------------------------
@@ -319,7 +616,7 @@ sprintf( msg, "ZeroPageX" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.w = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.b.l;
   sally_address.b.l += sally_x;
 }
 
@@ -332,7 +629,7 @@ sprintf( msg, "ZeroPageY" );
 logger_LogInfo( msg );
 #endif
 
-  sally_address.w = memory_Read(sally_pc.w++);
+  sally_address.w = sally_operand.b.l;
   sally_address.b.l += sally_y;
 }
 
@@ -356,19 +653,8 @@ logger_LogInfo( msg );
       ah++;
     }
 
-    if(!(sally_a + data + (sally_p & SALLY_FLAG.C))) {
-      sally_p |= SALLY_FLAG.Z;
-    }
-    else {
-      sally_p &= ~SALLY_FLAG.Z;
-    }
-
-    if((ah & 8) != 0) {
-      sally_p |= SALLY_FLAG.N;      
-    }
-    else {
-      sally_p &= ~SALLY_FLAG.N;
-    }
+    sally_z = (sally_a + data + (sally_p & SALLY_FLAG.C)) != 0;
+    sally_n = ah << 4;
 
     if(~(sally_a ^ data) & ((ah << 4) ^ sally_a) & 128) {
       sally_p |= SALLY_FLAG.V;
@@ -502,7 +788,7 @@ sprintf( msg, "BEQ" );
 logger_LogInfo( msg );
 #endif
 
-  sally_Branch(sally_p & SALLY_FLAG.Z);
+  sally_Branch(!sally_z);
 }
 
 // ----------------------------------------------------------------------------
@@ -516,17 +802,10 @@ logger_LogInfo( msg );
 
   byte data = memory_Read(sally_address.w);
     
-  if(!(data & sally_a)) {
-    sally_p |= SALLY_FLAG.Z;
-  }
-  else {
-    sally_p &= ~SALLY_FLAG.Z;
-  }
-
+  sally_z = data & sally_a;
+  sally_n = data;
   sally_p &= ~SALLY_FLAG.V;
-  sally_p &= ~SALLY_FLAG.N;  
   sally_p |= data & 64;
-  sally_p |= data & 128;
 }
 
 // ----------------------------------------------------------------------------
@@ -538,7 +817,7 @@ sprintf( msg, "BMI" );
 logger_LogInfo( msg );
 #endif
 
-  sally_Branch(sally_p & SALLY_FLAG.N);
+  sally_Branch(sally_n & SALLY_FLAG.N);
 }
 
 // ----------------------------------------------------------------------------
@@ -550,7 +829,7 @@ sprintf( msg, "BNE" );
 logger_LogInfo( msg );
 #endif
 
-  sally_Branch(!(sally_p & SALLY_FLAG.Z));
+  sally_Branch(sally_z);
 }
 
 // ----------------------------------------------------------------------------
@@ -562,7 +841,7 @@ sprintf( msg, "BPL" );
 logger_LogInfo( msg );
 #endif
 
-  sally_Branch(!(sally_p & SALLY_FLAG.N));
+  sally_Branch(!(sally_n & SALLY_FLAG.N));
 }
 
 // ----------------------------------------------------------------------------
@@ -579,6 +858,7 @@ logger_LogInfo( msg );
     
   sally_Push(sally_pc.b.h);
   sally_Push(sally_pc.b.l);
+  sally_Pack( );
   sally_Push(sally_p);
 
   sally_p |= SALLY_FLAG.I;
@@ -963,6 +1243,7 @@ sprintf( msg, "PHP" );
 logger_LogInfo( msg );
 #endif
 
+  sally_Pack( );
   sally_Push(sally_p);
 }
 
@@ -989,6 +1270,7 @@ logger_LogInfo( msg );
 #endif
 
   sally_p = sally_Pop( );
+  sally_Unpack( );
 }
 
 // ----------------------------------------------------------------------------
@@ -1095,6 +1377,7 @@ logger_LogInfo( msg );
 #endif
 
   sally_p = sally_Pop( );
+  sally_Unpack( );
   sally_pc.b.l = sally_Pop( );
   sally_pc.b.h = sally_Pop( );
 }
@@ -1342,14 +1625,153 @@ logger_LogInfo( msg );
   sally_x = 0;
   sally_y = 0;
   sally_p = SALLY_FLAG.R;
+  sally_Unpack( );
   sally_s = 0;
   sally_pc.w = 0;
+  sally_InvalidateCache(0, MEMORY_SIZE);
 }
 
 // ----------------------------------------------------------------------------
-// ExecuteInstruction
+// UpdatePage
 // ----------------------------------------------------------------------------
-uint sally_ExecuteInstruction( ) 
+static void sally_UpdatePage(uint page) {
+  if(memchr(memory_rom + (page << 8), 0, 256) != NULL ||
+     (cartridge_xm && page >= 0x40 && page < 0x80) ||
+     (cartridge_pokey && !cartridge_pokey450 && page == 0x40)) {
+    sally_pages[page] = SALLY_PAGE_UNCACHED;
+  }
+  else {
+    sally_pages[page] = ++sally_generation;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// InvalidateCache
+// ----------------------------------------------------------------------------
+void sally_InvalidateCache(word address, uint size) {
+  if(size == 0) {
+    return;
+  }
+  if(sally_generation >= SALLY_PAGE_UNCACHED - 256) {
+    memset(sally_cache, 0, sizeof(sally_cache));
+#ifdef PROSYSTEM_JIT
+    jit_Flush( );
+#endif
+    sally_generation = 0;
+    address = 0;
+    size = MEMORY_SIZE;
+  }
+  uint last = (address + size - 1) >> 8;
+  for(uint page = address >> 8; page <= last && page < 256; page++) {
+    sally_UpdatePage(page);
+  }
+}
+
+#ifndef PROSYSTEM_PROFILE
+// ----------------------------------------------------------------------------
+// Fuse
+// Returns the handler of a pair of instructions, or the opcode of the first
+// when the pair isn't fused. None of the first instructions writes memory,
+// so the second still holds when the first has been executed.
+// ----------------------------------------------------------------------------
+static word sally_Fuse(byte first, byte second) {
+  switch((first << 8) | second) {
+    case 0xa585:
+      return SALLY_LDA_ZP_STA_ZP;
+    case 0xa58d:
+      return SALLY_LDA_ZP_STA_ABS;
+    case 0xa985:
+      return SALLY_LDA_IMM_STA_ZP;
+    case 0xa98d:
+      return SALLY_LDA_IMM_STA_ABS;
+    case 0xb191:
+      return SALLY_LDA_INDY_STA_INDY;
+    case 0xb19d:
+      return SALLY_LDA_INDY_STA_ABSX;
+    case 0xcad0:
+      return SALLY_DEX_BNE;
+    case 0x88d0:
+      return SALLY_DEY_BNE;
+    case 0xc9f0:
+      return SALLY_CMP_IMM_BEQ;
+    case 0xc9d0:
+      return SALLY_CMP_IMM_BNE;
+  }
+  return first;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Decode
+// ----------------------------------------------------------------------------
+static sally_entry* sally_Decode(word address) {
+  sally_entry* entry = &sally_cache[address];
+  entry->opcode = memory_Read(address);
+  entry->cycles = SALLY_CYCLES[entry->opcode];
+  entry->length = SALLY_LENGTHS[entry->opcode];
+  entry->operand.w = 0;
+  if(entry->length > 1) {
+    entry->operand.b.l = memory_Read(address + 1);
+  }
+  if(entry->length > 2) {
+    entry->operand.b.h = memory_Read(address + 2);
+  }
+
+  // Instructions spanning two pages are decoded again each time
+  uint page = address >> 8;
+  if(sally_pages[page] != SALLY_PAGE_UNCACHED &&
+     ((address + entry->length - 1) & 0xffff) >> 8 == page) {
+    entry->generation = sally_pages[page];
+  }
+  else {
+    entry->generation = 0;
+  }
+
+  // The instructions of a fused pair are cached within the same page, the
+  // profiler records each of them
+  entry->handler = entry->opcode;
+#ifndef PROSYSTEM_PROFILE
+  word next = address + entry->length;
+  if(entry->generation != 0 && next >> 8 == page) {
+    byte opcode = memory_Read(next);
+    word handler = sally_Fuse(entry->opcode, opcode);
+    if(handler != entry->opcode &&
+       sally_Decode(next)->generation == entry->generation) {
+      entry->handler = handler;
+    }
+  }
+#endif
+  return entry;
+}
+
+// ----------------------------------------------------------------------------
+// Run
+// Executes instructions until the cycle count reaches the event (see
+// prosystem_Run), which a write to WSYNC moves to end the run early, or a
+// single instruction when stepping. Returns the cycles executed. When
+// profiling, each instruction is executed by Dispatch (see below).
+// ----------------------------------------------------------------------------
+#ifdef PROSYSTEM_PROFILE
+#define SALLY_NEXT return sally_cycles
+static uint sally_Dispatch( )
+#else
+#define SALLY_NEXT goto next
+
+// Ends the first instruction of a fused pair and continues with the second,
+// already decoded (see Decode), unless the run ends in between
+#define SALLY_FUSE \
+  prosystem_cycles += sally_cycles << 2; \
+  STATS_ADD(instructions, 1); \
+  if(step || prosystem_cycles >= prosystem_event) { \
+    continue; \
+  } \
+  entry = &sally_cache[sally_pc.w]; \
+  sally_opcode = entry->opcode; \
+  sally_cycles = entry->cycles; \
+  sally_operand = entry->operand; \
+  sally_pc.w += entry->length
+uint sally_Run(bool step) 
+#endif
 {
   __label__ 
 l_0x00, l_0x01, l_0x02, l_0x03, l_0x04, l_0x05, l_0x06, l_0x07, l_0x08,
@@ -1381,8 +1803,14 @@ l_0xe1, l_0xe2, l_0xe3, l_0xe4, l_0xe5, l_0xe6, l_0xe7, l_0xe8, l_0xe9,
 l_0xea, l_0xeb, l_0xec, l_0xed, l_0xee, l_0xef, l_0xf0, l_0xf1, l_0xf2,
 l_0xf3, l_0xf4, l_0xf5, l_0xf6, l_0xf7, l_0xf8, l_0xf9, l_0xfa, l_0xfb,
 l_0xfc, l_0xfd, l_0xfe, l_0xff;
+#ifndef PROSYSTEM_PROFILE
+  __label__
+f_lda_zp_sta_zp, f_lda_zp_sta_abs, f_lda_imm_sta_zp, f_lda_imm_sta_abs,
+f_lda_indy_sta_indy, f_lda_indy_sta_absx, f_dex_bne, f_dey_bne,
+f_cmp_imm_beq, f_cmp_imm_bne;
+#endif
 
-    static const void* const a_jump_table[256] = {
+    static const void* const a_jump_table[] = {
 &&l_0x00, &&l_0x01, &&l_0x02, &&l_0x03, &&l_0x04, &&l_0x05, &&l_0x06, &&l_0x07, &&l_0x08,
 &&l_0x09, &&l_0x0a, &&l_0x0b, &&l_0x0c, &&l_0x0d, &&l_0x0e, &&l_0x0f, &&l_0x10, &&l_0x11,
 &&l_0x12, &&l_0x13, &&l_0x14, &&l_0x15, &&l_0x16, &&l_0x17, &&l_0x18, &&l_0x19, &&l_0x1a,
@@ -1412,13 +1840,35 @@ l_0xfc, l_0xfd, l_0xfe, l_0xff;
 &&l_0xea, &&l_0xeb, &&l_0xec, &&l_0xed, &&l_0xee, &&l_0xef, &&l_0xf0, &&l_0xf1, &&l_0xf2,
 &&l_0xf3, &&l_0xf4, &&l_0xf5, &&l_0xf6, &&l_0xf7, &&l_0xf8, &&l_0xf9, &&l_0xfa, &&l_0xfb,
 &&l_0xfc, &&l_0xfd, &&l_0xfe, &&l_0xff 
+#ifndef PROSYSTEM_PROFILE
+, &&f_lda_zp_sta_zp, &&f_lda_zp_sta_abs, &&f_lda_imm_sta_zp, 
+&&f_lda_imm_sta_abs, &&f_lda_indy_sta_indy, &&f_lda_indy_sta_absx, 
+&&f_dex_bne, &&f_dey_bne, &&f_cmp_imm_beq, &&f_cmp_imm_bne
+#endif
 };
   
+#ifndef PROSYSTEM_PROFILE
+  uint start = prosystem_cycles;
+
+  // Idle loops are detected within a run (see Idle)
+  if(sally_loop.verify) {
+    sally_IdleError( );
+  }
+  sally_loop.valid = false;
+
+  do {
+#endif
   // Reset half cycle flag
   half_cycle = false;
 
-  sally_opcode = memory_Read(sally_pc.w++);
-  sally_cycles = SALLY_CYCLES[sally_opcode];
+  const sally_entry* entry = &sally_cache[sally_pc.w];
+  if(entry->generation != sally_pages[sally_pc.b.h]) {
+    entry = sally_Decode(sally_pc.w);
+  }
+  sally_opcode = entry->opcode;
+  sally_cycles = entry->cycles;
+  sally_operand = entry->operand;
+  sally_pc.w += entry->length;
 
 #ifdef LOWTRACE
 sprintf( msg, "Exec: %x, cycles: %d", sally_opcode, sally_cycles );
@@ -1431,103 +1881,103 @@ sprintf( message, "opcode: %d %d", sally_opcode, sally_cycles );
 logger_LogDebug( message );
 */
 
-	goto *a_jump_table[sally_opcode];
+	goto *a_jump_table[entry->handler];
   
 //  switch(sally_opcode) 
 //  {
     l_0x00:
       sally_BRK( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x01:
       sally_IndirectX( ); 
       sally_ORA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
     
     l_0x05:
       sally_ZeroPage( );  
       sally_ORA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x06: 
       sally_ZeroPage( );
       sally_ASL( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x08: 
       sally_PHP( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x09: 
       sally_Immediate( ); 
       sally_ORA( ); 
-      return sally_cycles;        
+      SALLY_NEXT;        
 
     l_0x0a: 
       sally_ASLA( ); 
-      return sally_cycles;        
+      SALLY_NEXT;        
 
     l_0x0d: 
       sally_Absolute( );  
       sally_ORA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x0e: 
       sally_Absolute( );  
       sally_ASL( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x10: 
       sally_Relative( );
       sally_BPL( );
-      return sally_cycles;        
+      SALLY_NEXT;        
 
     l_0x11: 
       sally_IndirectY( ); 
       sally_ORA( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x15: 
       sally_ZeroPageX( ); 
       sally_ORA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x16: 
       sally_ZeroPageX( ); 
       sally_ASL( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x18: 
       sally_CLC( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x19: 
       sally_AbsoluteY( ); 
       sally_ORA( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x1d: 
       sally_AbsoluteX( ); 
       sally_ORA( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x1e: 
       sally_AbsoluteX( ); 
       sally_ASL( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x20: 
       sally_Absolute( );  
       sally_JSR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x21: 
       sally_IndirectX( );
       sally_AND( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x24: 
       sally_ZeroPage( );
@@ -1542,657 +1992,657 @@ logger_LogDebug( message );
         half_cycle = true;
       }
 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x25: 
       sally_ZeroPage( );
       sally_AND( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x26: 
       sally_ZeroPage( );
       sally_ROL( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x28:
       sally_PLP( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x29:
       sally_Immediate( );
       sally_AND( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x2a: 
       sally_ROLA( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x2c: 
       sally_Absolute( );
       sally_BIT( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x2d: 
       sally_Absolute( );
       sally_AND( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x2e: 
       sally_Absolute( );
       sally_ROL( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x30:
       sally_Relative( );
       sally_BMI( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x31: 
       sally_IndirectY( );
       sally_AND( );
       sally_Delay(sally_y);
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x35: 
       sally_ZeroPageX( ); 
       sally_AND( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x36: 
       sally_ZeroPageX( ); 
       sally_ROL( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x38: 
       sally_SEC( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x39: 
       sally_AbsoluteY( );
       sally_AND( );
       sally_Delay(sally_y);
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x3d: 
       sally_AbsoluteX( ); 
       sally_AND( );
       sally_Delay(sally_x);
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x3e: 
       sally_AbsoluteX( );
       sally_ROL( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x40: 
       sally_RTI( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x41: 
       sally_IndirectX( ); 
       sally_EOR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x45: 
       sally_ZeroPage( );
       sally_EOR( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x46: 
       sally_ZeroPage( );
       sally_LSR( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x48: 
       sally_PHA( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x49: 
       sally_Immediate( ); 
       sally_EOR( ); 
-      return sally_cycles;  
+      SALLY_NEXT;  
     
     l_0x4a: 
       sally_LSRA( ); 
-      return sally_cycles; 
+      SALLY_NEXT; 
     
     l_0x4c: 
       sally_Absolute( );  
       sally_JMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x4d: 
       sally_Absolute( );  
       sally_EOR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x4e: 
       sally_Absolute( );
       sally_LSR( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x50: 
       sally_Relative( );
       sally_BVC( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x51: 
       sally_IndirectY( ); 
       sally_EOR( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;      
+      SALLY_NEXT;      
 
     l_0x55: 
       sally_ZeroPageX( ); 
       sally_EOR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x56: 
       sally_ZeroPageX( ); 
       sally_LSR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x58: 
       sally_CLI( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x59: 
       sally_AbsoluteY( ); 
       sally_EOR( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x5d: 
       sally_AbsoluteX( ); 
       sally_EOR( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x5e: 
       sally_AbsoluteX( ); 
       sally_LSR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x60: 
       sally_RTS( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x61: 
       sally_IndirectX( ); 
       sally_ADC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x65: 
       sally_ZeroPage( );
       sally_ADC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x66: 
       sally_ZeroPage( );  
       sally_ROR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x68: 
       sally_PLA( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x69: 
       sally_Immediate( ); 
       sally_ADC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x6a: 
       sally_RORA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x6c: 
       sally_Indirect( );
       sally_JMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x6d: 
       sally_Absolute( );
       sally_ADC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
     
     l_0x6e: 
       sally_Absolute( );  
       sally_ROR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x70: 
       sally_Relative( );  
       sally_BVS( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x71: 
       sally_IndirectY( ); 
       sally_ADC( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x75: 
       sally_ZeroPageX( ); 
       sally_ADC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x76: 
       sally_ZeroPageX( ); 
       sally_ROR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x78: 
       sally_SEI( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x79: 
       sally_AbsoluteY( ); 
       sally_ADC( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x7d: 
       sally_AbsoluteX( ); 
       sally_ADC( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x7e: 
       sally_AbsoluteX( ); 
       sally_ROR( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x81: 
       sally_IndirectX( ); 
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x84: 
       sally_ZeroPage( );  
       sally_STY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x85: 
       sally_ZeroPage( );  
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x86: 
       sally_ZeroPage( );  
       sally_stx( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x88: 
       sally_DEY( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x8a: 
       sally_TXA( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x8c: 
       sally_Absolute( );  
       sally_STY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x8d: 
       sally_Absolute( );  
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x8e: 
       sally_Absolute( );  
       sally_stx( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x90: 
       sally_Relative( );
       sally_BCC( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x91: 
       sally_IndirectY( ); 
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x94: 
       sally_ZeroPageX( ); 
       sally_STY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x95: 
       sally_ZeroPageX( ); 
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x96: 
       sally_ZeroPageY( ); 
       sally_stx( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x98: 
       sally_TYA( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x99: 
       sally_AbsoluteY( ); 
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x9a: 
       sally_TXS( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0x9d: 
       sally_AbsoluteX( ); 
       sally_STA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa0: 
       sally_Immediate( ); 
       sally_LDY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa1: 
       sally_IndirectX( ); 
       sally_LDA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa2: 
       sally_Immediate( ); 
       sally_LDX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa4: 
       sally_ZeroPage( );  
       sally_LDY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa5: 
       sally_ZeroPage( );  
       sally_LDA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa6: 
       sally_ZeroPage( );  
       sally_LDX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa8: 
       sally_TAY( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xa9: 
       sally_Immediate( ); 
       sally_LDA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xaa: 
       sally_TAX( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xac: 
       sally_Absolute( );  
       sally_LDY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xad: 
       sally_Absolute( );  
       sally_LDA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xae: 
       sally_Absolute( );  
       sally_LDX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb0: 
       sally_Relative( );  
       sally_BCS( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb1: 
       sally_IndirectY( ); 
       sally_LDA( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb4: 
       sally_ZeroPageX( ); 
       sally_LDY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb5: 
       sally_ZeroPageX( ); 
       sally_LDA( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb6: 
       sally_ZeroPageY( ); 
       sally_LDX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb8: 
       sally_CLV( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xb9: 
       sally_AbsoluteY( ); 
       sally_LDA( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xba: 
       sally_TSX( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xbc: 
       sally_AbsoluteX( ); 
       sally_LDY( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xbd: 
       sally_AbsoluteX( ); 
       sally_LDA( ); 
       sally_Delay(sally_x);
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xbe: 
       sally_AbsoluteY( ); 
       sally_LDX( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc0: 
       sally_Immediate( ); 
       sally_CPY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc1: 
       sally_IndirectX( ); 
       sally_CMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc4: 
       sally_ZeroPage( );  
       sally_CPY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc5: 
       sally_ZeroPage( );  
       sally_CMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc6: 
       sally_ZeroPage( );  
       sally_DEC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc8: 
       sally_INY( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xc9: 
       sally_Immediate( ); 
       sally_CMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xca: 
       sally_DEX( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xcc: 
       sally_Absolute( );  
       sally_CPY( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xcd: 
       sally_Absolute( );  
       sally_CMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xce: 
       sally_Absolute( );  
       sally_DEC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xd0: 
       sally_Relative( );  
       sally_BNE( );
-      return sally_cycles;          
+      SALLY_NEXT;          
 
     l_0xd1: 
       sally_IndirectY( ); 
       sally_CMP( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xd5: 
       sally_ZeroPageX( ); 
       sally_CMP( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xd6: 
       sally_ZeroPageX( ); 
       sally_DEC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xd8: 
       sally_CLD( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xd9: 
       sally_AbsoluteY( ); 
       sally_CMP( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xdd: 
       sally_AbsoluteX( ); 
       sally_CMP( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xde: 
       sally_AbsoluteX( ); 
       sally_DEC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe0: 
       sally_Immediate( ); 
       sally_CPX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe1: 
       sally_IndirectX( ); 
       sally_SBC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe4: 
       sally_ZeroPage( );  
       sally_CPX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe5: 
       sally_ZeroPage( );  
       sally_SBC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe6: 
       sally_ZeroPage( );  
       sally_INC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe8: 
       sally_INX( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xe9: 
       sally_Immediate( ); 
       sally_SBC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xea:
       sally_NOP( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xec: 
       sally_Absolute( );  
       sally_CPX( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xed: 
       sally_Absolute( );  
       sally_SBC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xee: 
       sally_Absolute( );  
       sally_INC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf0: 
       sally_Relative( );
       sally_BEQ( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf1: 
       sally_IndirectY( ); 
       sally_SBC( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf5: 
       sally_ZeroPageX( ); 
       sally_SBC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf6: 
       sally_ZeroPageX( ); 
       sally_INC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf8: 
       sally_SED( );
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xf9: 
       sally_AbsoluteY( ); 
       sally_SBC( ); 
       sally_Delay(sally_y); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xfd: 
       sally_AbsoluteX( ); 
       sally_SBC( ); 
       sally_Delay(sally_x); 
-      return sally_cycles;
+      SALLY_NEXT;
 
     l_0xfe: 
       sally_AbsoluteX( ); 
       sally_INC( ); 
-      return sally_cycles;
+      SALLY_NEXT;
 l_0xff:
 l_0xfc:
 l_0xfb:
@@ -2298,10 +2748,119 @@ l_0x07:
 l_0x04:
 l_0x03:
 l_0x02:
-      return sally_cycles;
+      SALLY_NEXT;
+
+#ifndef PROSYSTEM_PROFILE
+    f_lda_zp_sta_zp:
+      sally_ZeroPage( );
+      sally_LDA( );
+      SALLY_FUSE;
+      sally_ZeroPage( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_lda_zp_sta_abs:
+      sally_ZeroPage( );
+      sally_LDA( );
+      SALLY_FUSE;
+      sally_Absolute( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_lda_imm_sta_zp:
+      sally_Immediate( );
+      sally_LDA( );
+      SALLY_FUSE;
+      sally_ZeroPage( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_lda_imm_sta_abs:
+      sally_Immediate( );
+      sally_LDA( );
+      SALLY_FUSE;
+      sally_Absolute( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_lda_indy_sta_indy:
+      sally_IndirectY( );
+      sally_LDA( );
+      sally_Delay(sally_y);
+      SALLY_FUSE;
+      sally_IndirectY( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_lda_indy_sta_absx:
+      sally_IndirectY( );
+      sally_LDA( );
+      sally_Delay(sally_y);
+      SALLY_FUSE;
+      sally_AbsoluteX( );
+      sally_STA( );
+      SALLY_NEXT;
+
+    f_dex_bne:
+      sally_DEX( );
+      SALLY_FUSE;
+      sally_Relative( );
+      sally_BNE( );
+      SALLY_NEXT;
+
+    f_dey_bne:
+      sally_DEY( );
+      SALLY_FUSE;
+      sally_Relative( );
+      sally_BNE( );
+      SALLY_NEXT;
+
+    f_cmp_imm_beq:
+      sally_Immediate( );
+      sally_CMP( );
+      SALLY_FUSE;
+      sally_Relative( );
+      sally_BEQ( );
+      SALLY_NEXT;
+
+    f_cmp_imm_bne:
+      sally_Immediate( );
+      sally_CMP( );
+      SALLY_FUSE;
+      sally_Relative( );
+      sally_BNE( );
+      SALLY_NEXT;
+#endif
   //}
 
-  return sally_cycles;
+#ifndef PROSYSTEM_PROFILE
+next:
+    prosystem_cycles += sally_cycles << 2;
+    if(half_cycle) {
+      prosystem_cycles += 2;
+      riot_half_cycles++;
+    }
+    STATS_ADD(instructions, 1);
+  } while(!step && prosystem_cycles < prosystem_event);
+  return prosystem_cycles - start;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// GetP
+// Returns P with the N and Z flags evaluated
+// ----------------------------------------------------------------------------
+byte sally_GetP( ) {
+  sally_Pack( );
+  return sally_p;
+}
+
+// ----------------------------------------------------------------------------
+// SetP
+// ----------------------------------------------------------------------------
+void sally_SetP(byte data) {
+  sally_p = data;
+  sally_Unpack( );
 }
 
 // ----------------------------------------------------------------------------
@@ -2309,11 +2868,36 @@ l_0x02:
 // ----------------------------------------------------------------------------
 uint sally_ExecuteRES( ) {
   sally_p = SALLY_FLAG.I | SALLY_FLAG.R | SALLY_FLAG.Z;
+  sally_Unpack( );
   sally_pc.b.l = memory_ram[SALLY_RES.L];
   sally_pc.b.h = memory_ram[SALLY_RES.H];
   return 6;
 }
 
+#ifdef PROSYSTEM_PROFILE
+// ----------------------------------------------------------------------------
+// Run
+// Records the opcode, the host time and the cycles of each instruction.
+// ----------------------------------------------------------------------------
+uint sally_Run(bool step) {
+  uint start = prosystem_cycles;
+  do {
+    word pc = sally_pc.w;
+    ullong begin = profile_GetTicks( );
+    uint cycles = sally_Dispatch( );
+    ullong ticks = profile_GetTicks( ) - begin;
+    profile_Instruction(pc, sally_opcode, (cycles << 2) + (half_cycle? 2: 0), ticks);
+    prosystem_cycles += cycles << 2;
+    if(half_cycle) {
+      prosystem_cycles += 2;
+      riot_half_cycles++;
+    }
+    STATS_ADD(instructions, 1);
+  } while(!step && prosystem_cycles < prosystem_event);
+  return prosystem_cycles - start;
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // ExecuteNMI
 // ----------------------------------------------------------------------------
@@ -2321,10 +2905,14 @@ uint sally_ExecuteNMI( ) {
   sally_Push(sally_pc.b.h);
   sally_Push(sally_pc.b.l);
   sally_p &= ~SALLY_FLAG.B;
+  sally_Pack( );
   sally_Push(sally_p);
   sally_p |= SALLY_FLAG.I;
   sally_pc.b.l = memory_ram[SALLY_NMI.L];
   sally_pc.b.h = memory_ram[SALLY_NMI.H];
+#ifdef PROSYSTEM_PROFILE
+  profile_Interrupt( );
+#endif
   return 7;
 }
 
@@ -2336,6 +2924,7 @@ uint sally_ExecuteIRQ( ) {
     sally_Push(sally_pc.b.h);
     sally_Push(sally_pc.b.l);
     sally_p &= ~SALLY_FLAG.B;
+    sally_Pack( );
     sally_Push(sally_p);
     sally_p |= SALLY_FLAG.I;
     sally_pc.b.l = memory_ram[SALLY_IRQ.L];
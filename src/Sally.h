@@ -25,6 +25,7 @@
 #ifndef SALLY_H
 #define SALLY_H
 
+#include "EmulatorContext.h"
 #include "Memory.h"
 #include "Pair.h"
 
@@ -33,15 +34,36 @@ typedef unsigned short word;
 typedef unsigned int uint;
 
 extern void sally_Reset( );
-extern uint sally_ExecuteInstruction( );
+extern uint sally_Run(bool step);
 extern uint sally_ExecuteRES( );
 extern uint sally_ExecuteNMI( );
 extern uint sally_ExecuteIRQ( );
-extern byte sally_a;
-extern byte sally_x;
-extern byte sally_y;
-extern byte sally_p;
-extern byte sally_s;
-extern pair sally_pc;
+extern void sally_InvalidateCache(word address, uint size);
+extern byte sally_GetP( );
+extern void sally_SetP(byte data);
+
+// Whether idle loops are skipped or verified (set prior to creating the
+// contexts), the count of those found and of those that weren't idle
+#define SALLY_IDLE_OFF 0
+#define SALLY_IDLE_SKIP 1
+#define SALLY_IDLE_VERIFY 2
+extern byte sally_idle;
+extern CONTEXT_LOCAL uint sally_idleLoops;
+extern CONTEXT_LOCAL uint sally_idleErrors;
+
+extern CONTEXT_LOCAL byte sally_a;
+extern CONTEXT_LOCAL byte sally_x;
+extern CONTEXT_LOCAL byte sally_y;
+extern CONTEXT_LOCAL byte sally_s;
+extern CONTEXT_LOCAL pair sally_pc;
+
+// The base cycles and the length of each opcode
+extern const byte SALLY_CYCLES[256];
+extern const byte SALLY_LENGTHS[256];
+
+// The generation of the code in each page (see InvalidateCache), pages that
+// are not ROM are never cached
+#define SALLY_PAGE_UNCACHED 0xffffffff
+extern CONTEXT_LOCAL uint sally_pages[256];
 
 #endif
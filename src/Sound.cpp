@@ -23,9 +23,14 @@
 // Sound.cpp
 // ----------------------------------------------------------------------------
 #include "Sound.h"
+#include <string.h>
 #include "ProSystem.h"
+#ifdef WII
 #include <SDL.h>
 #include "wii_direct_sound.h"
+#else
+#include "host_sound.h"
+#endif
 
 #ifdef WII_NETTRACE
 #include <network.h>
@@ -34,8 +39,8 @@
 
 #define SOUND_SOURCE "Sound.cpp"
 
-int wii_sound_length = 0;
-int wii_convert_length = 0;
+CONTEXT_LOCAL int wii_sound_length = 0;
+CONTEXT_LOCAL int wii_convert_length = 0;
 
 #define MAX_BUFFER_SIZE 8192
 
@@ -55,8 +60,8 @@ typedef struct {
 # define WAVE_FORMAT_PCM 0
 
 static const WAVEFORMATEX SOUND_DEFAULT_FORMAT = {WAVE_FORMAT_PCM, 1, 48000, 48000, 1, 8, 0};
-static WAVEFORMATEX sound_format = SOUND_DEFAULT_FORMAT;
-static bool sound_muted = false;
+static CONTEXT_LOCAL WAVEFORMATEX sound_format = SOUND_DEFAULT_FORMAT;
+static CONTEXT_LOCAL bool sound_muted = false;
 
 static void wii_storeSound( byte* sample, int length )
 {
@@ -116,8 +121,8 @@ bool sound_SetFormat(WAVEFORMATEX format) {
 // Store
 // ----------------------------------------------------------------------------
 
-byte sample[MAX_BUFFER_SIZE] = {0};
-byte pokeySample[MAX_BUFFER_SIZE] = {0};
+CONTEXT_LOCAL byte sample[MAX_BUFFER_SIZE] = {0};
+CONTEXT_LOCAL byte pokeySample[MAX_BUFFER_SIZE] = {0};
 
 #ifdef TRACE_SOUND
 static int maxTia = 0, minTia = 0, maxPokey = 0, minPokey = 0;
@@ -32,6 +32,8 @@
 #define SOUND_LATENCY_HIGH 4
 #define SOUND_LATENCY_VERY_HIGH 5
 
+#include "EmulatorContext.h"
+
 typedef unsigned char byte;
 typedef unsigned short word;
 typedef unsigned int uint;
@@ -43,7 +45,7 @@ extern bool sound_SetSampleRate(uint rate);
 extern bool sound_Initialize();
 extern bool sound_SetMuted(bool muted);
 
-extern int wii_sound_length;
-extern int wii_convert_length;
+extern CONTEXT_LOCAL int wii_sound_length;
+extern CONTEXT_LOCAL int wii_convert_length;
 
 #endif
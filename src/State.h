@@ -0,0 +1,77 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// State.h
+// Helpers for the save state chunks. Values are stored big-endian so that
+// states are interchangeable between the Wii and the host.
+// ----------------------------------------------------------------------------
+#ifndef STATE_H
+#define STATE_H
+
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+
+static inline void state_WriteByte(byte* buffer, uint& offset, byte data) {
+  buffer[offset++] = data;
+}
+
+static inline void state_WriteWord(byte* buffer, uint& offset, word data) {
+  buffer[offset++] = data >> 8;
+  buffer[offset++] = data;
+}
+
+static inline void state_WriteUint(byte* buffer, uint& offset, uint data) {
+  buffer[offset++] = data >> 24;
+  buffer[offset++] = data >> 16;
+  buffer[offset++] = data >> 8;
+  buffer[offset++] = data;
+}
+
+static inline void state_WriteBlock(byte* buffer, uint& offset, const void* data, uint size) {
+  memcpy(buffer + offset, data, size);
+  offset += size;
+}
+
+static inline byte state_ReadByte(const byte* buffer, uint& offset) {
+  return buffer[offset++];
+}
+
+static inline word state_ReadWord(const byte* buffer, uint& offset) {
+  word data = (buffer[offset] << 8) | buffer[offset + 1];
+  offset += 2;
+  return data;
+}
+
+static inline uint state_ReadUint(const byte* buffer, uint& offset) {
+  uint data = ((uint)buffer[offset] << 24) | (buffer[offset + 1] << 16) |
+              (buffer[offset + 2] << 8) | buffer[offset + 3];
+  offset += 4;
+  return data;
+}
+
+static inline void state_ReadBlock(const byte* buffer, uint& offset, void* data, uint size) {
+  memcpy(data, buffer + offset, size);
+  offset += size;
+}
+
+#endif
@@ -0,0 +1,261 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Stats.cpp
+// ----------------------------------------------------------------------------
+#include <stdio.h>
+#include <time.h>
+#include "Stats.h"
+#include "State.h"
+
+#ifdef WII
+#include <ogc/lwp_watchdog.h>
+#endif
+
+#define STATS_SOURCE "Stats.cpp"
+
+// ----------------------------------------------------------------------------
+// Binary log format
+// +----------+----------------------------------------------------------------
+// | Size     | Contents
+// +----------+----------------------------------------------------------------
+// | 16       | "PRO-SYSTEM STATS"
+// | 1        | Version
+// | 4        | Record size
+// | ...      | Records: the counters (4 bytes each), the flags (1 byte, bit
+// |          | 0 wsync to bit 4 ahead) and the times (8 bytes each) in the
+// |          | order of stats_frame (big-endian)
+// +----------+----------------------------------------------------------------
+// ----------------------------------------------------------------------------
+#define STATS_HEADER "PRO-SYSTEM STATS"
+#define STATS_VERSION 1
+#define STATS_HEADER_SIZE 21
+#define STATS_RECORD_SIZE (11 * 4 + 1 + 4 * 8)
+
+#ifdef PROSYSTEM_STATS
+CONTEXT_LOCAL stats_frame stats_current;
+static CONTEXT_LOCAL stats_frame stats_last;
+static CONTEXT_LOCAL stats_frame stats_total;
+static CONTEXT_LOCAL uint stats_frames = 0;
+static CONTEXT_LOCAL ullong stats_start = 0;
+static CONTEXT_LOCAL FILE* stats_file = NULL;
+static CONTEXT_LOCAL bool stats_binary = false;
+
+// ----------------------------------------------------------------------------
+// WriteTime
+// ----------------------------------------------------------------------------
+static inline void stats_WriteTime(byte* buffer, uint& offset, ullong time) {
+  state_WriteUint(buffer, offset, (uint)(time >> 32));
+  state_WriteUint(buffer, offset, (uint)time);
+}
+
+// ----------------------------------------------------------------------------
+// WriteRecord
+// ----------------------------------------------------------------------------
+static void stats_WriteRecord(const stats_frame& stats) {
+  if(!stats_binary) {
+    fprintf(stats_file, "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d,%d,%d,%d,%d,"
+      "%llu,%llu,%llu,%llu\n", stats.frame, stats.cpu_cycles,
+      stats.maria_cycles, stats.saved_cycles, stats.wsync_count,
+      stats.instructions, stats.bank_switches, stats.tia_writes,
+      stats.pokey_writes, stats.timer_writes, stats.hs_sram_writes,
+      stats.wsync, stats.cycle_stealing, stats.video, stats.audio,
+      stats.ahead, stats.cpu_ns, stats.maria_ns, stats.audio_ns,
+      stats.frame_ns);
+    return;
+  }
+
+  byte buffer[STATS_RECORD_SIZE];
+  uint offset = 0;
+  state_WriteUint(buffer, offset, stats.frame);
+  state_WriteUint(buffer, offset, stats.cpu_cycles);
+  state_WriteUint(buffer, offset, stats.maria_cycles);
+  state_WriteUint(buffer, offset, stats.saved_cycles);
+  state_WriteUint(buffer, offset, stats.wsync_count);
+  state_WriteUint(buffer, offset, stats.instructions);
+  state_WriteUint(buffer, offset, stats.bank_switches);
+  state_WriteUint(buffer, offset, stats.tia_writes);
+  state_WriteUint(buffer, offset, stats.pokey_writes);
+  state_WriteUint(buffer, offset, stats.timer_writes);
+  state_WriteUint(buffer, offset, stats.hs_sram_writes);
+  state_WriteByte(buffer, offset, (stats.wsync? 1: 0) |
+    (stats.cycle_stealing? 2: 0) | (stats.video? 4: 0) |
+    (stats.audio? 8: 0) | (stats.ahead? 16: 0));
+  stats_WriteTime(buffer, offset, stats.cpu_ns);
+  stats_WriteTime(buffer, offset, stats.maria_ns);
+  stats_WriteTime(buffer, offset, stats.audio_ns);
+  stats_WriteTime(buffer, offset, stats.frame_ns);
+  fwrite(buffer, 1, offset, stats_file);
+}
+
+// ----------------------------------------------------------------------------
+// Accumulate
+// ----------------------------------------------------------------------------
+static void stats_Accumulate(stats_frame& total, const stats_frame& stats) {
+  total.frame = stats.frame;
+  total.cpu_cycles += stats.cpu_cycles;
+  total.maria_cycles += stats.maria_cycles;
+  total.saved_cycles += stats.saved_cycles;
+  total.wsync_count += stats.wsync_count;
+  total.instructions += stats.instructions;
+  total.bank_switches += stats.bank_switches;
+  total.tia_writes += stats.tia_writes;
+  total.pokey_writes += stats.pokey_writes;
+  total.timer_writes += stats.timer_writes;
+  total.hs_sram_writes += stats.hs_sram_writes;
+  total.cpu_ns += stats.cpu_ns;
+  total.maria_ns += stats.maria_ns;
+  total.audio_ns += stats.audio_ns;
+  total.frame_ns += stats.frame_ns;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Reset
+// ----------------------------------------------------------------------------
+void stats_Reset( ) {
+#ifdef PROSYSTEM_STATS
+  memset(&stats_current, 0, sizeof(stats_frame));
+  memset(&stats_last, 0, sizeof(stats_frame));
+  memset(&stats_total, 0, sizeof(stats_frame));
+  stats_frames = 0;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// BeginFrame
+// ----------------------------------------------------------------------------
+void stats_BeginFrame(bool video, bool audio, bool ahead) {
+#ifdef PROSYSTEM_STATS
+  memset(&stats_current, 0, sizeof(stats_frame));
+  stats_current.frame = stats_frames;
+  stats_current.video = video;
+  stats_current.audio = audio;
+  stats_current.ahead = ahead;
+  stats_start = stats_GetTime( );
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// EndFrame
+// ----------------------------------------------------------------------------
+void stats_EndFrame( ) {
+#ifdef PROSYSTEM_STATS
+  stats_current.frame_ns = stats_GetTime( ) - stats_start;
+  stats_last = stats_current;
+  stats_Accumulate(stats_total, stats_current);
+  stats_frames++;
+  if(stats_file != NULL) {
+    stats_WriteRecord(stats_current);
+  }
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// GetFrame
+// Returns the counters of the last emulated frame (NULL when the counters
+// are compiled out).
+// ----------------------------------------------------------------------------
+const stats_frame* stats_GetFrame( ) {
+#ifdef PROSYSTEM_STATS
+  return &stats_last;
+#else
+  return NULL;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// GetTotal
+// Returns the counters summed over the frames since the last reset (NULL
+// when the counters are compiled out).
+// ----------------------------------------------------------------------------
+const stats_frame* stats_GetTotal( ) {
+#ifdef PROSYSTEM_STATS
+  return &stats_total;
+#else
+  return NULL;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Open
+// Streams the counters of each frame to a CSV or binary log.
+// ----------------------------------------------------------------------------
+bool stats_Open(std::string filename, bool binary) {
+#ifdef PROSYSTEM_STATS
+  if(filename.empty( ) || filename.length( ) == 0) {
+    logger_LogError("Filename is invalid.", STATS_SOURCE);
+    return false;
+  }
+
+  stats_Close( );
+  stats_file = fopen(filename.c_str( ), binary? "wb": "w");
+  if(stats_file == NULL) {
+    logger_LogError("Failed to open the file " + filename + " for writing.", STATS_SOURCE);
+    return false;
+  }
+
+  stats_binary = binary;
+  if(binary) {
+    byte buffer[STATS_HEADER_SIZE];
+    uint offset = 0;
+    state_WriteBlock(buffer, offset, STATS_HEADER, 16);
+    state_WriteByte(buffer, offset, STATS_VERSION);
+    state_WriteUint(buffer, offset, STATS_RECORD_SIZE);
+    fwrite(buffer, 1, offset, stats_file);
+  }
+  else {
+    fprintf(stats_file, "frame,cpu_cycles,maria_cycles,saved_cycles,"
+      "wsync_count,instructions,bank_switches,tia_writes,pokey_writes,"
+      "timer_writes,hs_sram_writes,wsync,cycle_stealing,video,audio,ahead,"
+      "cpu_ns,maria_ns,audio_ns,frame_ns\n");
+  }
+  return true;
+#else
+  logger_LogError("Performance counters are not enabled in this build.", STATS_SOURCE);
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Close
+// ----------------------------------------------------------------------------
+void stats_Close( ) {
+#ifdef PROSYSTEM_STATS
+  if(stats_file != NULL) {
+    fclose(stats_file);
+    stats_file = NULL;
+  }
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// GetTime
+// Returns the time of the host (nanoseconds).
+// ----------------------------------------------------------------------------
+ullong stats_GetTime( ) {
+#ifdef WII
+  return ticks_to_nanosecs(gettime( ));
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((ullong)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+#endif
+}
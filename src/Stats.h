@@ -0,0 +1,87 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /  emulator
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// Stats.h
+// Per-frame performance counters. The counters are only maintained when
+// built with PROSYSTEM_STATS, otherwise the STATS_ macros expand to nothing
+// and the emulation loop is unchanged.
+// ----------------------------------------------------------------------------
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include "EmulatorContext.h"
+#include "Logger.h"
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+
+// ----------------------------------------------------------------------------
+// The counters of a frame. Cycles are Maria clocks (4 per CPU cycle) like
+// prosystem_cycles, times are host nanoseconds.
+// ----------------------------------------------------------------------------
+typedef struct stats_frame {
+  uint frame;           // Sequence number of the emulated frame
+  uint cpu_cycles;      // Cycles executed by the CPU
+  uint maria_cycles;    // Cycles stolen by Maria DMA
+  uint saved_cycles;    // Cycles carried over into the next scanline
+  uint wsync_count;     // Scanlines ended by a WSYNC
+  uint instructions;    // Instructions executed by the CPU
+  uint bank_switches;   // Cartridge bank switches
+  uint tia_writes;      // Writes to the TIA audio registers
+  uint pokey_writes;    // Writes to the POKEY registers
+  uint timer_writes;    // Writes starting a RIOT timer
+  uint hs_sram_writes;  // Writes to the high score cartridge SRAM
+  bool wsync;           // Whether WSYNC was enabled
+  bool cycle_stealing;  // Whether Maria cycle stealing was enabled
+  bool video;           // Whether the frame was rendered
+  bool audio;           // Whether audio was synthesized
+  bool ahead;           // Whether the frame was run ahead (and discarded)
+  ullong cpu_ns;        // Time spent running the CPU
+  ullong maria_ns;      // Time spent rendering the scanlines
+  ullong audio_ns;      // Time spent synthesizing audio
+  ullong frame_ns;      // Time spent emulating the frame
+} stats_frame;
+
+#ifdef PROSYSTEM_STATS
+extern CONTEXT_LOCAL stats_frame stats_current;
+
+#define STATS_ADD(field, value) (stats_current.field += (value))
+#define STATS_SET(field, value) (stats_current.field = (value))
+#define STATS_START(start) ullong start = stats_GetTime( )
+#define STATS_STOP(field, start) (stats_current.field += stats_GetTime( ) - (start))
+#else
+#define STATS_ADD(field, value)
+#define STATS_SET(field, value)
+#define STATS_START(start)
+#define STATS_STOP(field, start)
+#endif
+
+extern void stats_Reset( );
+extern void stats_BeginFrame(bool video, bool audio, bool ahead);
+extern void stats_EndFrame( );
+extern const stats_frame* stats_GetFrame( );
+extern const stats_frame* stats_GetTotal( );
+extern bool stats_Open(std::string filename, bool binary);
+extern void stats_Close( );
+extern ullong stats_GetTime( );
+
+#endif
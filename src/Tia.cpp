@@ -39,6 +39,8 @@
 // Tia.cpp
 // ----------------------------------------------------------------------------
 #include "Tia.h"
+#include "State.h"
+#include "Stats.h"
 #include <string.h>
 
 
@@ -51,23 +53,23 @@
 #define TIA_POLY5_SIZE 31
 #define TIA_POLY9_SIZE 511
 
-byte tia_buffer[TIA_BUFFER_SIZE] = {0};
-uint tia_size = TIA_BUFFER_SIZE;
+CONTEXT_LOCAL byte tia_buffer[TIA_BUFFER_SIZE] = {0};
+CONTEXT_LOCAL uint tia_size = TIA_BUFFER_SIZE;
 
 static const byte TIA_POLY4[ ] = {1,1,0,1,1,1,0,0,0,0,1,0,1,0,0};
 static const byte TIA_POLY5[ ] = {0,0,1,0,1,1,0,0,1,1,1,1,1,0,0,0,1,1,0,1,1,1,0,1,0,1,0,0,0,0,1};
 static const byte TIA_POLY9[ ] = {0,0,1,0,1,0,0,0,1,0,0,0,0,0,0,0,1,0,1,1,1,0,0,1,0,1,0,0,1,1,1,1,1,0,0,1,1,0,1,1,0,1,0,1,1,1,0,1,1,0,0,1,0,0,1,1,1,1,0,1,0,0,0,0,1,1,0,1,1,0,0,0,1,0,0,0,1,1,1,1,0,1,0,1,1,0,1,0,1,0,0,0,0,1,1,0,1,0,1,0,0,0,1,0,1,0,0,0,1,1,1,0,0,1,1,0,1,1,0,0,1,1,1,1,1,0,0,1,1,0,0,0,1,1,0,1,0,0,0,1,1,0,0,1,1,1,1,0,0,1,0,0,0,1,1,1,0,0,1,1,0,1,0,1,1,0,1,1,0,1,0,0,1,0,0,1,1,1,1,1,1,0,1,1,1,1,0,1,1,0,0,0,0,1,1,1,1,1,0,0,0,1,0,0,0,0,1,0,0,0,1,0,1,0,1,1,0,0,0,0,1,0,1,1,1,1,0,1,0,0,0,1,1,0,0,0,1,1,1,0,1,1,1,0,1,0,0,0,0,0,0,0,0,1,0,1,0,0,1,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,1,1,0,0,1,0,0,1,0,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,1,1,1,1,0,0,0,1,1,1,0,0,0,1,0,0,1,1,1,1,0,1,1,1,1,1,1,1,0,1,1,1,1,1,1,0,1,1,0,1,0,1,1,1,1,0,0,1,0,1,0,1,1,1,0,0,0,0,0,1,1,0,1,1,0,0,0,1,0,1,0,1,0,0,0,0,1,0,1,1,1,0,0,0,0,1,0,0,1,0,1,0,0,0,1,0,1,1,1,0,0,1,1,1,1,1,1,1,0,0,0,0,0,1,0,0,1,1,0,1,0,0,1,0,0,0,1,0,0,1,0,1,0,0,0,1,1,0,1,0,0,0,0,0,1,1,1,1,0,0,1,0,0,1,0,1,1,1,1,1,1,1,0,1,0,0,1,0,0,0,1,1,0,1,1,1,0,0,0,1,0,1,0,0,1,0,1,0,1,0,1,1,1,0,0,1,0,1,1,0,0,1,1,1,1,1,0,0,0,1,1,0};
 static const byte TIA_DIV31[ ] = {1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0};
-static byte tia_volume[2] = {0};
-static byte tia_counterMax[2] = {0};
-static byte tia_counter[2] = {0};
-static byte tia_audc[2] = {0};
-static byte tia_audf[2] = {0};
-static byte tia_audv[2] = {0};
-static uint tia_poly4Cntr[2] = {0};
-static uint tia_poly5Cntr[2] = {0};
-static uint tia_poly9Cntr[2] = {0};
-static uint tia_soundCntr = 0;
+static CONTEXT_LOCAL byte tia_volume[2] = {0};
+static CONTEXT_LOCAL byte tia_counterMax[2] = {0};
+static CONTEXT_LOCAL byte tia_counter[2] = {0};
+static CONTEXT_LOCAL byte tia_audc[2] = {0};
+static CONTEXT_LOCAL byte tia_audf[2] = {0};
+static CONTEXT_LOCAL byte tia_audv[2] = {0};
+static CONTEXT_LOCAL uint tia_poly4Cntr[2] = {0};
+static CONTEXT_LOCAL uint tia_poly5Cntr[2] = {0};
+static CONTEXT_LOCAL uint tia_poly9Cntr[2] = {0};
+static CONTEXT_LOCAL uint tia_soundCntr = 0;
 
 // ----------------------------------------------------------------------------
 // ProcessChannel
@@ -137,7 +139,8 @@ void tia_Clear( ) {
 void tia_SetRegister(word address, byte data) {
   byte channel;
   byte frequency;
-    
+
+  STATS_ADD(tia_writes, 1);
   switch(address) {
     case AUDC0:
       tia_audc[0] = data & 15;
@@ -211,3 +214,39 @@ void tia_Process(uint length) {
     }
   }
 }
+
+// ----------------------------------------------------------------------------
+// SaveState
+// ----------------------------------------------------------------------------
+void tia_SaveState(byte* buffer, uint& offset) {
+  for(int index = 0; index < 2; index++) {
+    state_WriteByte(buffer, offset, tia_volume[index]);
+    state_WriteByte(buffer, offset, tia_counterMax[index]);
+    state_WriteByte(buffer, offset, tia_counter[index]);
+    state_WriteByte(buffer, offset, tia_audc[index]);
+    state_WriteByte(buffer, offset, tia_audf[index]);
+    state_WriteByte(buffer, offset, tia_audv[index]);
+    state_WriteUint(buffer, offset, tia_poly4Cntr[index]);
+    state_WriteUint(buffer, offset, tia_poly5Cntr[index]);
+    state_WriteUint(buffer, offset, tia_poly9Cntr[index]);
+  }
+  state_WriteUint(buffer, offset, tia_soundCntr);
+}
+
+// ----------------------------------------------------------------------------
+// LoadState
+// ----------------------------------------------------------------------------
+void tia_LoadState(const byte* buffer, uint& offset) {
+  for(int index = 0; index < 2; index++) {
+    tia_volume[index] = state_ReadByte(buffer, offset);
+    tia_counterMax[index] = state_ReadByte(buffer, offset);
+    tia_counter[index] = state_ReadByte(buffer, offset);
+    tia_audc[index] = state_ReadByte(buffer, offset);
+    tia_audf[index] = state_ReadByte(buffer, offset);
+    tia_audv[index] = state_ReadByte(buffer, offset);
+    tia_poly4Cntr[index] = state_ReadUint(buffer, offset);
+    tia_poly5Cntr[index] = state_ReadUint(buffer, offset);
+    tia_poly9Cntr[index] = state_ReadUint(buffer, offset);
+  }
+  tia_soundCntr = state_ReadUint(buffer, offset) % tia_size;
+}
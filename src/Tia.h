@@ -42,8 +42,10 @@
 #define TIA_H
 //#define TIA_BUFFER_SIZE 624
 #define TIA_BUFFER_SIZE 2048 // WII
+#define TIA_STATE_SIZE 40
 
 #include "Equates.h"
+#include "EmulatorContext.h"
 
 typedef unsigned char byte;
 typedef unsigned short word;
@@ -53,7 +55,9 @@ extern void tia_Reset( );
 extern void tia_SetRegister(word address, byte data);
 extern void tia_Clear( );
 extern void tia_Process(uint length);
-extern byte tia_buffer[TIA_BUFFER_SIZE];
-extern uint tia_size;
+extern void tia_SaveState(byte* buffer, uint& offset);
+extern void tia_LoadState(const byte* buffer, uint& offset);
+extern CONTEXT_LOCAL byte tia_buffer[TIA_BUFFER_SIZE];
+extern CONTEXT_LOCAL uint tia_size;
 
 #endif
@@ -0,0 +1,122 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#include <string.h>
+#include <time.h>
+
+#include "Cartridge.h"
+#include "Maria.h"
+#include "Sound.h"
+
+#include "host_atari.h"
+
+/** The null video sink that Maria renders into */
+static CONTEXT_LOCAL unsigned char host_surface[MARIA_SURFACE_SIZE];
+
+/** The 8-bit palette (the null sink keeps the raw Atari color indices) */
+CONTEXT_LOCAL byte atari_pal8[256];
+/** The 7800 scanline that the lightgun is currently at */
+CONTEXT_LOCAL int lightgun_scanline = 0;
+/** The 7800 cycle that the lightgun is currently at */
+CONTEXT_LOCAL float lightgun_cycle = 0;
+/** Whether the lightgun is enabled for the current cartridge */
+CONTEXT_LOCAL bool lightgun_enabled = false;
+/** Whether to flash the screen */
+unsigned int wii_lightgun_flash = 1;
+/** The keyboard (controls) state */
+CONTEXT_LOCAL unsigned char keyboard_data[19];
+
+/**
+ * Returns the Atari blit surface
+ *
+ * return   The Atari blit surface
+ */
+unsigned char* wii_sdl_get_blit_addr() {
+    return host_surface;
+}
+
+/**
+ * Initializes the 8-bit palette
+ */
+static void host_atari_init_palette8() {
+    for (uint index = 0; index < 256; index++) {
+        atari_pal8[index] = index;
+    }
+}
+
+/**
+ * Resets the keyboard (controls) information
+ */
+void host_reset_keyboard_data() {
+    memset(keyboard_data, 0, sizeof(keyboard_data));
+
+    // Left difficulty switch defaults to off
+    keyboard_data[15] = cartridge_left_switch;
+    // Right difficulty switch defaults to on
+    keyboard_data[16] = cartridge_right_switch;
+}
+
+/**
+ * Loads the specified ROM into the context and resets the emulator
+ *
+ * @param   context The emulator context of the current thread
+ * @param   filename The filename of the ROM
+ * @return  Whether the load was successful
+ */
+bool host_atari_load_rom(EmulatorContext* context, const char* filename) {
+    bios_enabled = false;
+    host_atari_init_palette8();
+    sound_Initialize();
+
+    if (!context_Load(context, std::string(filename)))
+        return false;
+
+    lightgun_enabled =
+        (cartridge_controller[0] == CARTRIDGE_CONTROLLER_LIGHTGUN);
+
+    host_reset_keyboard_data();
+
+    return true;
+}
+
+/**
+ * Returns the current value of the monotonic host clock
+ *
+ * @return  The current time (in nanoseconds)
+ */
+ullong host_get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((ullong)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
@@ -0,0 +1,70 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef HOST_ATARI_H
+#define HOST_ATARI_H
+
+#include "ProSystem.h"
+
+// Typedefs
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int uint;
+typedef unsigned long long ullong;
+
+/** The keyboard (controls) state passed to the emulator each frame */
+extern CONTEXT_LOCAL unsigned char keyboard_data[19];
+
+/**
+ * Resets the keyboard (controls) information
+ */
+void host_reset_keyboard_data();
+
+/**
+ * Loads the specified ROM into the context and resets the emulator
+ *
+ * @param   context The emulator context of the current thread
+ * @param   filename The filename of the ROM
+ * @return  Whether the load was successful
+ */
+bool host_atari_load_rom(EmulatorContext* context, const char* filename);
+
+/**
+ * Returns the current value of the monotonic host clock
+ *
+ * @return  The current time (in nanoseconds)
+ */
+ullong host_get_time_ns();
+
+#endif
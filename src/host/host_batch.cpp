@@ -0,0 +1,395 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#include <algorithm>
+#include <deque>
+#include <dirent.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "Cartridge.h"
+#include "Database.h"
+#include "ProSystem.h"
+#include "Sound.h"
+
+#include "host_atari.h"
+#include "host_sound.h"
+
+// The default count of frames to run for each ROM
+#define BATCH_DEFAULT_FRAMES 600
+
+/**
+ * The result of running a single ROM
+ */
+typedef struct batch_job {
+    std::string rom;
+    bool loaded;
+    std::string title;
+    std::string digest;
+    ullong time;
+    ullong samples;
+    uLong video_crc;
+    uLong audio_crc;
+    uLong ram_crc;
+} batch_job;
+
+/**
+ * The queue of job indices owned by a worker. Workers pop from the back of
+ * their own queue and steal from the front of the others.
+ */
+typedef struct batch_queue {
+    std::mutex lock;
+    std::deque<size_t> jobs;
+} batch_queue;
+
+/** The jobs of the batch */
+static std::vector<batch_job> batch_jobs;
+/** The per-worker job queues */
+static std::vector<batch_queue> batch_queues;
+/** The count of frames to run for each ROM */
+static int batch_frames = BATCH_DEFAULT_FRAMES;
+
+/**
+ * Displays the usage for the batch runner
+ */
+static void batch_usage() {
+    fprintf(stderr,
+            "usage: prosystem-batch [options] <rom or directory>...\n"
+            "  -f <frames>  count of frames to run for each rom (default %d)\n"
+            "  -j <threads> count of worker threads (default: all cores)\n"
+            "  -d <file>    ProSystem database (default %s)\n"
+            "  -o <file>    write the summary to file (default stdout)\n"
+            "  -F <format>  summary format, csv or json (default csv)\n",
+            BATCH_DEFAULT_FRAMES, database_filename.c_str());
+}
+
+/**
+ * Returns whether the specified file name has a ROM extension
+ *
+ * @param   name The file name
+ * @return  Whether the file is a ROM
+ */
+static bool batch_is_rom(const char* name) {
+    const char* ext = strrchr(name, '.');
+    return ext != NULL &&
+           (!strcasecmp(ext, ".a78") || !strcasecmp(ext, ".bin") ||
+            !strcasecmp(ext, ".zip"));
+}
+
+/**
+ * Adds the ROM, or the ROMs in the directory, to the list of ROMs
+ *
+ * @param   path The ROM or directory
+ * @param   roms The list of ROMs
+ */
+static void batch_add_path(const char* path, std::vector<std::string>& roms) {
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        roms.push_back(path);
+        return;
+    }
+
+    std::string prefix(path);
+    if (prefix[prefix.length() - 1] != '/') prefix += '/';
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.' && batch_is_rom(entry->d_name)) {
+            roms.push_back(prefix + entry->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * Runs the job (load, run the frames, checksum) in its own emulator context
+ *
+ * @param   job The job to run
+ */
+static void batch_run_job(batch_job* job) {
+    ullong start = host_get_time_ns();
+    EmulatorContext* context = context_Create();
+    job->loaded = host_atari_load_rom(context, job->rom.c_str());
+    if (job->loaded) {
+        for (int i = 0; i < batch_frames; i++) {
+            context_ExecuteFrame(context, keyboard_data);
+            sound_Store();
+        }
+
+        job->title = cartridge_title;
+        job->digest = cartridge_digest;
+        job->samples = host_sound_samples;
+        job->video_crc =
+            crc32(crc32(0L, Z_NULL, 0), maria_surface, MARIA_SURFACE_SIZE);
+        job->audio_crc = host_sound_crc;
+        job->ram_crc = crc32(crc32(0L, Z_NULL, 0), memory_ram, MEMORY_SIZE);
+    }
+    context_Release(context);
+    job->time = host_get_time_ns() - start;
+}
+
+/**
+ * Takes the next job for the worker, stealing from the other workers when
+ * its own queue is empty
+ *
+ * @param   worker The index of the worker
+ * @param   index The index of the job (output)
+ * @return  Whether a job was found
+ */
+static bool batch_next_job(size_t worker, size_t* index) {
+    size_t count = batch_queues.size();
+    for (size_t i = 0; i < count; i++) {
+        batch_queue& queue = batch_queues[(worker + i) % count];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.jobs.empty()) continue;
+        if (i == 0) {
+            *index = queue.jobs.back();
+            queue.jobs.pop_back();
+        } else {
+            *index = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * The worker thread
+ *
+ * @param   worker The index of the worker
+ */
+static void batch_worker(size_t worker) {
+    size_t index;
+    while (batch_next_job(worker, &index)) {
+        batch_run_job(&batch_jobs[index]);
+    }
+}
+
+/**
+ * Writes the string as a quoted CSV field
+ *
+ * @param   out The output file
+ * @param   value The value
+ */
+static void batch_write_csv_string(FILE* out, const std::string& value) {
+    fputc('"', out);
+    for (size_t i = 0; i < value.length(); i++) {
+        if (value[i] == '"') fputc('"', out);
+        fputc(value[i], out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Writes the string as a quoted JSON string
+ *
+ * @param   out The output file
+ * @param   value The value
+ */
+static void batch_write_json_string(FILE* out, const std::string& value) {
+    fputc('"', out);
+    for (size_t i = 0; i < value.length(); i++) {
+        unsigned char ch = value[i];
+        if (ch == '"' || ch == '\\') {
+            fprintf(out, "\\%c", ch);
+        } else if (ch < 0x20) {
+            fprintf(out, "\\u%04x", ch);
+        } else {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Writes the summary as CSV
+ *
+ * @param   out The output file
+ */
+static void batch_write_csv(FILE* out) {
+    fprintf(out, "rom,status,title,digest,frames,time_ms,samples,"
+                 "video_crc,audio_crc,ram_crc\n");
+    for (size_t i = 0; i < batch_jobs.size(); i++) {
+        batch_job& job = batch_jobs[i];
+        batch_write_csv_string(out, job.rom);
+        fprintf(out, ",%s,", job.loaded ? "ok" : "error");
+        batch_write_csv_string(out, job.title);
+        fprintf(out, ",%s,%d,%.3f,%llu,%08lx,%08lx,%08lx\n",
+                job.digest.c_str(), batch_frames, job.time / 1e6,
+                job.samples, job.video_crc, job.audio_crc, job.ram_crc);
+    }
+}
+
+/**
+ * Writes the summary as JSON
+ *
+ * @param   out The output file
+ */
+static void batch_write_json(FILE* out) {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < batch_jobs.size(); i++) {
+        batch_job& job = batch_jobs[i];
+        fprintf(out, "  {\"rom\": ");
+        batch_write_json_string(out, job.rom);
+        fprintf(out, ", \"status\": \"%s\", \"title\": ",
+                job.loaded ? "ok" : "error");
+        batch_write_json_string(out, job.title);
+        fprintf(out,
+                ", \"digest\": \"%s\", \"frames\": %d, \"time_ms\": %.3f, "
+                "\"samples\": %llu, \"video_crc\": \"%08lx\", "
+                "\"audio_crc\": \"%08lx\", \"ram_crc\": \"%08lx\"}%s\n",
+                job.digest.c_str(), batch_frames, job.time / 1e6,
+                job.samples, job.video_crc, job.audio_crc, job.ram_crc,
+                i + 1 < batch_jobs.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+/**
+ * Runs the batch
+ */
+int main(int argc, char* argv[]) {
+    int threads = std::thread::hardware_concurrency();
+    const char* output = NULL;
+    bool json = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:j:d:o:F:")) != -1) {
+        switch (opt) {
+            case 'f':
+                batch_frames = atoi(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'd':
+                database_filename = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'F':
+                if (!strcmp(optarg, "json")) {
+                    json = true;
+                } else if (strcmp(optarg, "csv")) {
+                    batch_usage();
+                    return 1;
+                }
+                break;
+            default:
+                batch_usage();
+                return 1;
+        }
+    }
+
+    if (threads <= 0) threads = 1;
+    if (optind >= argc || batch_frames <= 0) {
+        batch_usage();
+        return 1;
+    }
+
+    std::vector<std::string> roms;
+    for (int i = optind; i < argc; i++) {
+        batch_add_path(argv[i], roms);
+    }
+    std::sort(roms.begin(), roms.end());
+    if (roms.empty()) {
+        fprintf(stderr, "no roms found\n");
+        return 1;
+    }
+
+    // Read the database once, the workers share the in-memory copy
+    database_Initialize();
+
+    batch_jobs.resize(roms.size());
+    for (size_t i = 0; i < roms.size(); i++) {
+        batch_jobs[i].rom = roms[i];
+        batch_jobs[i].loaded = false;
+        batch_jobs[i].time = 0;
+        batch_jobs[i].samples = 0;
+        batch_jobs[i].video_crc = 0;
+        batch_jobs[i].audio_crc = 0;
+        batch_jobs[i].ram_crc = 0;
+    }
+
+    if ((size_t)threads > roms.size()) threads = roms.size();
+    batch_queues = std::vector<batch_queue>(threads);
+    for (size_t i = 0; i < roms.size(); i++) {
+        batch_queues[i % threads].jobs.push_back(i);
+    }
+
+    ullong start = host_get_time_ns();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(batch_worker, i));
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+    ullong wall = host_get_time_ns() - start;
+
+    database_Release();
+
+    FILE* out = stdout;
+    if (output != NULL) {
+        out = fopen(output, "w");
+        if (out == NULL) {
+            fprintf(stderr, "unable to open output file: %s\n", output);
+            return 1;
+        }
+    }
+    if (json) {
+        batch_write_json(out);
+    } else {
+        batch_write_csv(out);
+    }
+    if (out != stdout) fclose(out);
+
+    int failed = 0;
+    for (size_t i = 0; i < batch_jobs.size(); i++) {
+        if (!batch_jobs[i].loaded) failed++;
+    }
+    fprintf(stderr, "%d roms (%d failed), %d threads, %.3f s\n",
+            (int)batch_jobs.size(), failed, threads, wall / 1e9);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,392 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "Cartridge.h"
+#include "Database.h"
+#include "Jit.h"
+#include "Movie.h"
+#include "ProSystem.h"
+#include "Profile.h"
+#include "Sound.h"
+#include "Stats.h"
+
+#include "host_atari.h"
+#include "host_sound.h"
+
+// The default count of frames to measure
+#define BENCH_DEFAULT_FRAMES 3600
+// The default count of frames to run prior to measuring
+#define BENCH_DEFAULT_WARMUP 120
+
+/**
+ * A benchmark run of a ROM (one per thread)
+ */
+typedef struct bench_job {
+    const char* rom;
+    const char* movie;
+    const char* log;
+    const char* profile;
+    int frames;
+    int warmup;
+    int speed;
+    int ahead;
+    bool audio;
+    bool loaded;
+    bool movie_loaded;
+    bool log_opened;
+    bool profile_written;
+    uint movie_length;
+    std::string title;
+    std::string digest;
+    word frequency;
+    ullong total;
+    ullong ahead_total;
+    ullong samples;
+    uLong checksum;
+    uint idle_loops;
+    uint idle_errors;
+    std::vector<ullong> times;
+} bench_job;
+
+/**
+ * Displays the usage for the benchmark
+ */
+static void bench_usage() {
+    fprintf(stderr,
+            "usage: prosystem-bench [options] <rom>\n"
+            "  -f <frames>  count of frames to measure (default %d)\n"
+            "  -w <frames>  count of warm-up frames (default %d)\n"
+            "  -d <file>    ProSystem database (default %s)\n"
+            "  -t <threads> count of machines to run concurrently (default 1)\n"
+            "  -s <speed>   fast-forward, presenting one of every <speed> "
+            "frames\n"
+            "  -r <frames>  run ahead of each presented frame\n"
+            "  -m <movie>   play the input of a movie\n"
+            "  -l <file>    stream the per-frame counters to a CSV file "
+            "(STATS=1 builds)\n"
+            "  -p <file>    write the CPU profile of the measured frames and "
+            "its call\n"
+            "               stacks to <file>.folded (PROFILE=1 builds)\n"
+            "  -q           skip the null audio sink\n"
+            "  -i           interpret the ROM code (JIT=1 builds)\n"
+            "  -n           interpret idle loops rather than skipping them\n"
+            "  -v           verify that the idle loops skipped are idle\n",
+            BENCH_DEFAULT_FRAMES, BENCH_DEFAULT_WARMUP,
+            database_filename.c_str());
+}
+
+/**
+ * Returns the specified percentile of the sorted frame times
+ *
+ * @param   times The sorted frame times
+ * @param   pct The percentile (0-100)
+ * @return  The frame time at the percentile
+ */
+static ullong bench_percentile(const std::vector<ullong>& times, double pct) {
+    size_t index = (size_t)((pct / 100.0) * (times.size() - 1) + 0.5);
+    return times[index];
+}
+
+/**
+ * Runs a frame of the job. When fast-forwarding, only every Nth frame
+ * renders video and audio. When running ahead, the time spent doing so is
+ * accumulated separately. When playing a movie, its input is used until it
+ * ends.
+ *
+ * @param   job The job
+ * @param   context The emulator context
+ * @param   frame The index of the frame
+ */
+static inline void bench_frame(bench_job* job, EmulatorContext* context,
+                               int frame) {
+    if (job->movie) movie_Input(keyboard_data);
+    if ((frame % job->speed) != (job->speed - 1)) {
+        context_SkipFrame(context, keyboard_data);
+        return;
+    }
+    context_ExecuteFrame(context, keyboard_data);
+    if (job->ahead > 0) {
+        ullong ahead_start = host_get_time_ns();
+        context_RunAhead(context, keyboard_data, job->ahead);
+        job->ahead_total += host_get_time_ns() - ahead_start;
+    }
+    if (job->audio) sound_Store();
+}
+
+/**
+ * Runs the benchmark for a job in its own emulator context
+ *
+ * @param   job The job to run
+ */
+static void bench_run(bench_job* job) {
+    EmulatorContext* context = context_Create();
+    job->loaded = host_atari_load_rom(context, job->rom);
+    if (!job->loaded) {
+        context_Release(context);
+        return;
+    }
+
+    if (job->movie) {
+        job->movie_loaded = movie_Load(job->movie) && movie_Play();
+        job->movie_length = movie_length;
+        if (!job->movie_loaded) {
+            movie_Release();
+            context_Release(context);
+            return;
+        }
+    }
+
+    for (int i = 0; i < job->warmup; i++) {
+        bench_frame(job, context, i);
+    }
+
+    if (job->log) {
+        job->log_opened = stats_Open(job->log, false);
+        if (!job->log_opened) {
+            movie_Release();
+            context_Release(context);
+            return;
+        }
+    }
+    profile_Reset();
+
+    job->times.resize(job->frames);
+    job->ahead_total = 0;
+    ullong start = host_get_time_ns();
+    for (int i = 0; i < job->frames; i++) {
+        ullong frame_start = host_get_time_ns();
+        bench_frame(job, context, i);
+        job->times[i] = host_get_time_ns() - frame_start;
+    }
+    job->total = host_get_time_ns() - start;
+
+    job->title = cartridge_title;
+    job->digest = cartridge_digest;
+    job->frequency = prosystem_frequency;
+    job->samples = host_sound_samples;
+    job->checksum = crc32(0L, Z_NULL, 0);
+    job->checksum = crc32(job->checksum, memory_ram, MEMORY_SIZE);
+    job->checksum = crc32(job->checksum, maria_surface, MARIA_SURFACE_SIZE);
+    job->idle_loops = sally_idleLoops;
+    job->idle_errors = sally_idleErrors;
+
+    stats_Close();
+    if (job->profile) {
+        job->profile_written =
+            profile_Write(job->profile) &&
+            profile_WriteFolded(std::string(job->profile) + ".folded");
+    }
+    movie_Release();
+    context_Release(context);
+}
+
+/**
+ * Runs the benchmark
+ */
+int main(int argc, char* argv[]) {
+    int frames = BENCH_DEFAULT_FRAMES;
+    int warmup = BENCH_DEFAULT_WARMUP;
+    int threads = 1;
+    int speed = 1;
+    int ahead = 0;
+    const char* movie = NULL;
+    const char* log = NULL;
+    const char* profile = NULL;
+    bool audio = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:w:d:t:s:r:m:l:p:qinv")) != -1) {
+        switch (opt) {
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'w':
+                warmup = atoi(optarg);
+                break;
+            case 'd':
+                database_filename = optarg;
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                speed = atoi(optarg);
+                break;
+            case 'r':
+                ahead = atoi(optarg);
+                break;
+            case 'm':
+                movie = optarg;
+                break;
+            case 'l':
+                log = optarg;
+                break;
+            case 'p':
+                profile = optarg;
+                break;
+            case 'q':
+                audio = false;
+                break;
+            case 'i':
+#ifdef PROSYSTEM_JIT
+                jit_enabled = false;
+#endif
+                break;
+            case 'n':
+                sally_idle = SALLY_IDLE_OFF;
+                break;
+            case 'v':
+                sally_idle = SALLY_IDLE_VERIFY;
+                break;
+            default:
+                bench_usage();
+                return 1;
+        }
+    }
+
+    if (optind >= argc || frames <= 0 || warmup < 0 || threads <= 0 ||
+        speed <= 0 || ahead < 0 || ((log || profile) && threads > 1)) {
+        bench_usage();
+        return 1;
+    }
+
+    const char* rom = argv[optind];
+    std::vector<bench_job> jobs(threads);
+    for (int i = 0; i < threads; i++) {
+        jobs[i].rom = rom;
+        jobs[i].movie = movie;
+        jobs[i].movie_loaded = false;
+        jobs[i].log = log;
+        jobs[i].log_opened = false;
+        jobs[i].profile = profile;
+        jobs[i].profile_written = false;
+        jobs[i].frames = frames;
+        jobs[i].warmup = warmup;
+        jobs[i].speed = speed;
+        jobs[i].ahead = ahead;
+        jobs[i].audio = audio;
+        jobs[i].loaded = false;
+    }
+
+    ullong start = host_get_time_ns();
+    if (threads == 1) {
+        bench_run(&jobs[0]);
+    } else {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(bench_run, &jobs[i]));
+        }
+        for (int i = 0; i < threads; i++) {
+            workers[i].join();
+        }
+    }
+    ullong wall = host_get_time_ns() - start;
+
+    for (int i = 0; i < threads; i++) {
+        if (!jobs[i].loaded) {
+            fprintf(stderr, "unable to load rom: %s\n", rom);
+            return 1;
+        }
+        if (movie && !jobs[i].movie_loaded) {
+            fprintf(stderr, "unable to play movie: %s\n", movie);
+            return 1;
+        }
+        if (log && !jobs[i].log_opened) {
+            fprintf(stderr, "unable to open log: %s\n", log);
+            return 1;
+        }
+        if (profile && !jobs[i].profile_written) {
+            fprintf(stderr, "unable to write profile: %s\n", profile);
+            return 1;
+        }
+    }
+
+    bench_job& job = jobs[0];
+    std::vector<ullong>& times = job.times;
+    std::sort(times.begin(), times.end());
+    double seconds = job.total / 1e9;
+    double fps = frames / seconds;
+
+    printf("rom:       %s\n", rom);
+    printf("title:     %s\n", job.title.c_str());
+    printf("digest:    %s\n", job.digest.c_str());
+    printf("frames:    %d (warm-up %d)\n", frames, warmup);
+    if (movie) {
+        printf("movie:     %s (%u frames)\n", movie, job.movie_length);
+    }
+    printf("total:     %.3f s\n", seconds);
+    printf("fps:       %.1f (%.1fx real time)\n", fps, fps / job.frequency);
+    if (speed > 1) {
+        printf("presented: %d of %d frames (%.1f fps)\n", frames / speed,
+               frames, fps / speed);
+    }
+    printf("ns/frame:  mean %llu, p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+           job.total / frames, bench_percentile(times, 50),
+           bench_percentile(times, 90), bench_percentile(times, 99),
+           times[frames - 1]);
+    if (ahead > 0) {
+        ullong ahead_mean = job.ahead_total / std::max(frames / speed, 1);
+        printf("run-ahead: %d frames, mean %llu ns/frame (%.1f%% of total)\n",
+               ahead, ahead_mean, (100.0 * job.ahead_total) / job.total);
+    }
+    if (audio) {
+        printf("samples:   %llu\n", job.samples);
+    }
+    if (sally_idle == SALLY_IDLE_VERIFY) {
+        printf("idle:      %u loops verified, %u not idle\n", job.idle_loops,
+               job.idle_errors);
+        if (job.idle_errors) return 1;
+    }
+
+    if (threads > 1) {
+        bool match = true;
+        for (int i = 1; i < threads; i++) {
+            if (jobs[i].checksum != job.checksum) match = false;
+        }
+        double aggregate = ((double)frames * threads) / (wall / 1e9);
+        printf("threads:   %d, aggregate fps %.1f, state %s\n", threads,
+               aggregate, match ? "identical" : "DIVERGED");
+        if (!match) return 1;
+    }
+
+    return 0;
+}
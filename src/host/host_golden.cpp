@@ -0,0 +1,451 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "Cartridge.h"
+#include "Database.h"
+#include "Movie.h"
+#include "ProSystem.h"
+
+#include "host_atari.h"
+
+// The default directory of the movies and golden checksums
+#define GOLDEN_DEFAULT_DIR "tests/golden"
+// The default count of frames to record
+#define GOLDEN_DEFAULT_FRAMES 600
+// The count of frames the scripted input is held for
+#define GOLDEN_INPUT_FRAMES 8
+// The interval (frames) of the keyframes of a recorded movie
+#define GOLDEN_KEYFRAME_INTERVAL 120
+// The count of seeks checked against linear playback
+#define GOLDEN_SEEKS 5
+// The count of frames played after each seek
+#define GOLDEN_SEEK_FRAMES 30
+
+/**
+ * The checksums of a frame
+ */
+typedef struct golden_frame {
+    uLong video;
+    uLong audio;
+    uLong ram;
+} golden_frame;
+
+/** The names of the checksums of a frame */
+static const char* golden_components[] = {"video", "audio", "ram"};
+
+/**
+ * Displays the usage for the golden-frame suite
+ */
+static void golden_usage() {
+    fprintf(stderr,
+            "usage: prosystem-golden [options] <rom or directory>...\n"
+            "  -g <dir>     movies and golden checksums (default %s)\n"
+            "  -u           update the golden checksums\n"
+            "  -R           record the movies (scripted input from reset)\n"
+            "  -f <frames>  count of frames to record (default %d)\n"
+            "  -d <file>    ProSystem database (default %s)\n",
+            GOLDEN_DEFAULT_DIR, GOLDEN_DEFAULT_FRAMES,
+            database_filename.c_str());
+}
+
+/**
+ * Returns the name of the ROM without its directory and extension
+ *
+ * @param   rom The path of the ROM
+ * @return  The name of the ROM
+ */
+static std::string golden_name(const std::string& rom) {
+    size_t start = rom.find_last_of('/');
+    start = (start == std::string::npos) ? 0 : start + 1;
+    size_t end = rom.find_last_of('.');
+    if (end == std::string::npos || end < start) end = rom.length();
+    return rom.substr(start, end - start);
+}
+
+/**
+ * Adds the ROM, or the ROMs in the directory, to the list of ROMs
+ *
+ * @param   path The ROM or directory
+ * @param   roms The list of ROMs
+ */
+static void golden_add_path(const char* path, std::vector<std::string>& roms) {
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        roms.push_back(path);
+        return;
+    }
+
+    std::string prefix(path);
+    if (prefix[prefix.length() - 1] != '/') prefix += '/';
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* ext = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] != '.' && ext != NULL &&
+            (!strcasecmp(ext, ".a78") || !strcasecmp(ext, ".bin"))) {
+            roms.push_back(prefix + entry->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * Sets the scripted input of a frame. The joysticks and buttons of both
+ * players change every few frames, in a fixed pseudo-random sequence.
+ *
+ * @param   frame The index of the frame
+ */
+static void golden_script(int frame) {
+    uint seed = (frame / GOLDEN_INPUT_FRAMES) * 1103515245u + 12345u;
+    seed ^= seed >> 16;
+    seed *= 0x45d9f3bu;
+    seed ^= seed >> 16;
+    for (int i = 0; i < 12; i++) {
+        keyboard_data[i] = (seed >> i) & 1;
+    }
+}
+
+/**
+ * Computes the checksums of the frame that was just executed
+ *
+ * @param   frame The checksums (output)
+ */
+static void golden_checksum(golden_frame* frame) {
+    // The timer is evaluated lazily, bring INTIM up to date
+    riot_UpdateTimer();
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    frame->video = crc32(crc, maria_surface, MARIA_SURFACE_SIZE);
+    frame->audio = crc32(crc, tia_buffer, tia_size);
+    if (cartridge_pokey || cartridge_xm) {
+        frame->audio = crc32(frame->audio, pokey_buffer, pokey_size);
+    }
+    frame->ram = crc32(crc, memory_ram, MEMORY_SIZE);
+}
+
+/**
+ * Reads the golden checksums
+ *
+ * @param   filename The name of the file
+ * @param   frames The checksums of each frame (output)
+ * @return  Whether the checksums were read
+ */
+static bool golden_read(const std::string& filename,
+                        std::vector<golden_frame>& frames) {
+    FILE* file = fopen(filename.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') continue;
+        int index;
+        golden_frame frame;
+        if (sscanf(line, "%d %lx %lx %lx", &index, &frame.video, &frame.audio,
+                   &frame.ram) != 4 ||
+            index != (int)frames.size()) {
+            fclose(file);
+            return false;
+        }
+        frames.push_back(frame);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Writes the golden checksums
+ *
+ * @param   filename The name of the file
+ * @param   rom The name of the ROM
+ * @param   frames The checksums of each frame
+ * @return  Whether the checksums were written
+ */
+static bool golden_write(const std::string& filename, const std::string& rom,
+                         const std::vector<golden_frame>& frames) {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "# %s %s\n", rom.c_str(), cartridge_digest.c_str());
+    fprintf(file, "# frame video audio ram\n");
+    for (size_t i = 0; i < frames.size(); i++) {
+        fprintf(file, "%d %08lx %08lx %08lx\n", (int)i, frames[i].video,
+                frames[i].audio, frames[i].ram);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Compares the checksums against the golden ones, reporting the first frame
+ * that diverges
+ *
+ * @param   name The name of the ROM
+ * @param   frames The checksums of each frame
+ * @param   golden The golden checksums of each frame
+ * @return  Whether the checksums match
+ */
+static bool golden_compare(const std::string& name,
+                           const std::vector<golden_frame>& frames,
+                           const std::vector<golden_frame>& golden) {
+    size_t count = std::min(frames.size(), golden.size());
+    for (size_t i = 0; i < count; i++) {
+        const uLong actual[] = {frames[i].video, frames[i].audio,
+                                frames[i].ram};
+        const uLong expected[] = {golden[i].video, golden[i].audio,
+                                  golden[i].ram};
+        bool diverged = false;
+        for (int c = 0; c < 3; c++) {
+            if (actual[c] != expected[c]) {
+                printf("%s: frame %d diverges, %s %08lx (expected %08lx)\n",
+                       name.c_str(), (int)i, golden_components[c], actual[c],
+                       expected[c]);
+                diverged = true;
+            }
+        }
+        if (diverged) return false;
+    }
+    if (frames.size() != golden.size()) {
+        printf("%s: %d frames (expected %d)\n", name.c_str(),
+               (int)frames.size(), (int)golden.size());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Seeks the movie to several frames, playing a few frames after each, and
+ * checks that video, audio and RAM match linear playback
+ *
+ * @param   context The context of the machine
+ * @param   name The name of the ROM
+ * @param   frames The checksums of each frame of linear playback
+ * @return  Whether every seek matched
+ */
+static bool golden_seek(EmulatorContext* context, const std::string& name,
+                        const std::vector<golden_frame>& frames) {
+    // Seek backwards, to frames off the keyframes, so that each seek both
+    // restores an earlier keyframe and emulates frames up to the target
+    for (int seek = GOLDEN_SEEKS; seek > 0; seek--) {
+        uint target = (uint)frames.size() * seek / (GOLDEN_SEEKS + 1) + seek;
+        if (target >= frames.size() || !movie_Seek(target)) {
+            printf("%s: unable to seek to frame %d\n", name.c_str(),
+                   (int)target);
+            return false;
+        }
+        for (uint i = target;
+             i < target + GOLDEN_SEEK_FRAMES && movie_Input(keyboard_data);
+             i++) {
+            context_ExecuteFrame(context, keyboard_data);
+            golden_frame frame;
+            golden_checksum(&frame);
+            const uLong actual[] = {frame.video, frame.audio, frame.ram};
+            const uLong expected[] = {frames[i].video, frames[i].audio,
+                                      frames[i].ram};
+            for (int c = 0; c < 3; c++) {
+                if (actual[c] != expected[c]) {
+                    printf("%s: frame %d after seeking to %d diverges, %s "
+                           "%08lx (expected %08lx)\n",
+                           name.c_str(), (int)i, (int)target,
+                           golden_components[c], actual[c], expected[c]);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs a ROM with its movie and checks (or updates) its golden checksums
+ *
+ * @param   rom The path of the ROM
+ * @param   dir The directory of the movies and golden checksums
+ * @param   update Whether to update the golden checksums
+ * @param   record The count of frames to record a movie for (0 to play the
+ *          existing movie)
+ * @return  Whether the ROM passed
+ */
+static bool golden_run(const std::string& rom, const std::string& dir,
+                       bool update, int record) {
+    std::string name = golden_name(rom);
+    std::string movie = dir + "/" + name + ".mov";
+    std::string checksums = dir + "/" + name + ".golden";
+
+    EmulatorContext* context = context_Create();
+    if (!host_atari_load_rom(context, rom.c_str())) {
+        printf("%s: unable to load rom\n", name.c_str());
+        context_Release(context);
+        return false;
+    }
+
+    if (record > 0) {
+        // The frames are played with audio, so that the sound generators of
+        // the keyframes match playback
+        movie_Record(GOLDEN_KEYFRAME_INTERVAL);
+        for (int i = 0; i < record; i++) {
+            golden_script(i);
+            movie_Input(keyboard_data);
+            context_ExecuteFrame(context, keyboard_data);
+        }
+        movie_Stop();
+        if (!movie_Save(movie)) {
+            printf("%s: unable to save movie %s\n", name.c_str(),
+                   movie.c_str());
+            movie_Release();
+            context_Release(context);
+            return false;
+        }
+    } else if (!movie_Load(movie)) {
+        printf("%s: unable to load movie %s\n", name.c_str(), movie.c_str());
+        movie_Release();
+        context_Release(context);
+        return false;
+    }
+
+    std::vector<golden_frame> frames;
+    frames.reserve(movie_length);
+    bool played = movie_Play();
+    while (played && movie_Input(keyboard_data)) {
+        context_ExecuteFrame(context, keyboard_data);
+        golden_frame frame;
+        golden_checksum(&frame);
+        frames.push_back(frame);
+    }
+    bool seeked = played && golden_seek(context, name, frames);
+    movie_Release();
+
+    bool passed = played && seeked;
+    if (!played) {
+        printf("%s: unable to play movie %s\n", name.c_str(), movie.c_str());
+    } else if (!seeked) {
+        // The divergence has been reported
+    } else if (update || record > 0) {
+        passed = golden_write(checksums, name, frames);
+        printf("%s: %s %d frames\n", name.c_str(),
+               passed ? "updated" : "unable to update", (int)frames.size());
+    } else {
+        std::vector<golden_frame> golden;
+        if (!golden_read(checksums, golden)) {
+            printf("%s: unable to read %s\n", name.c_str(), checksums.c_str());
+            passed = false;
+        } else {
+            passed = golden_compare(name, frames, golden);
+            if (passed) {
+                printf("%s: ok (%d frames)\n", name.c_str(), (int)frames.size());
+            }
+        }
+    }
+
+    context_Release(context);
+    return passed;
+}
+
+/**
+ * Runs the golden-frame suite
+ */
+int main(int argc, char* argv[]) {
+    std::string dir = GOLDEN_DEFAULT_DIR;
+    int frames = GOLDEN_DEFAULT_FRAMES;
+    bool update = false;
+    bool record = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:uRf:d:")) != -1) {
+        switch (opt) {
+            case 'g':
+                dir = optarg;
+                break;
+            case 'u':
+                update = true;
+                break;
+            case 'R':
+                record = true;
+                break;
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'd':
+                database_filename = optarg;
+                break;
+            default:
+                golden_usage();
+                return 1;
+        }
+    }
+
+    if (optind >= argc || frames <= 0) {
+        golden_usage();
+        return 1;
+    }
+
+    std::vector<std::string> roms;
+    for (int i = optind; i < argc; i++) {
+        golden_add_path(argv[i], roms);
+    }
+    std::sort(roms.begin(), roms.end());
+    if (roms.empty()) {
+        fprintf(stderr, "no roms found\n");
+        return 1;
+    }
+
+    database_Initialize();
+
+    int failed = 0;
+    for (size_t i = 0; i < roms.size(); i++) {
+        if (!golden_run(roms[i], dir, update, record ? frames : 0)) {
+            failed++;
+        }
+    }
+
+    database_Release();
+
+    printf("%d roms, %d passed, %d failed\n", (int)roms.size(),
+           (int)roms.size() - failed, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * host_ioapi.c -- stdio based IO functions for the bundled zip sources
+ *
+ * The Wii build obtains these from its support libraries. The host build
+ * provides the plain fopen() implementation here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "zlib.h"
+#include "ioapi.h"
+
+static voidpf ZCALLBACK host_fopen_file(voidpf opaque, const char* filename,
+                                        int mode) {
+    const char* mode_fopen = NULL;
+    if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) == ZLIB_FILEFUNC_MODE_READ)
+        mode_fopen = "rb";
+    else if (mode & ZLIB_FILEFUNC_MODE_EXISTING)
+        mode_fopen = "r+b";
+    else if (mode & ZLIB_FILEFUNC_MODE_CREATE)
+        mode_fopen = "wb";
+
+    if (filename == NULL || mode_fopen == NULL)
+        return NULL;
+    return fopen(filename, mode_fopen);
+}
+
+static uLong ZCALLBACK host_fread_file(voidpf opaque, voidpf stream, void* buf,
+                                       uLong size) {
+    return (uLong)fread(buf, 1, (size_t)size, (FILE*)stream);
+}
+
+static uLong ZCALLBACK host_fwrite_file(voidpf opaque, voidpf stream,
+                                        const void* buf, uLong size) {
+    return (uLong)fwrite(buf, 1, (size_t)size, (FILE*)stream);
+}
+
+static long ZCALLBACK host_ftell_file(voidpf opaque, voidpf stream) {
+    return ftell((FILE*)stream);
+}
+
+static long ZCALLBACK host_fseek_file(voidpf opaque, voidpf stream,
+                                      uLong offset, int origin) {
+    int fseek_origin = SEEK_SET;
+    switch (origin) {
+        case ZLIB_FILEFUNC_SEEK_CUR:
+            fseek_origin = SEEK_CUR;
+            break;
+        case ZLIB_FILEFUNC_SEEK_END:
+            fseek_origin = SEEK_END;
+            break;
+        case ZLIB_FILEFUNC_SEEK_SET:
+            fseek_origin = SEEK_SET;
+            break;
+        default:
+            return -1;
+    }
+    return fseek((FILE*)stream, offset, fseek_origin) == 0 ? 0 : -1;
+}
+
+static int ZCALLBACK host_fclose_file(voidpf opaque, voidpf stream) {
+    return fclose((FILE*)stream);
+}
+
+static int ZCALLBACK host_ferror_file(voidpf opaque, voidpf stream) {
+    return ferror((FILE*)stream);
+}
+
+void fill_fopen_filefunc(zlib_filefunc_def* pzlib_filefunc_def) {
+    pzlib_filefunc_def->zopen_file = host_fopen_file;
+    pzlib_filefunc_def->zread_file = host_fread_file;
+    pzlib_filefunc_def->zwrite_file = host_fwrite_file;
+    pzlib_filefunc_def->ztell_file = host_ftell_file;
+    pzlib_filefunc_def->zseek_file = host_fseek_file;
+    pzlib_filefunc_def->zclose_file = host_fclose_file;
+    pzlib_filefunc_def->zerror_file = host_ferror_file;
+    pzlib_filefunc_def->opaque = NULL;
+}
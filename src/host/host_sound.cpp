@@ -0,0 +1,71 @@
+/*--------------------------------------------------------------------------*\
+|                                                                            |
+|     __      __.__.___________  ______ _______  _______                     |
+|    /  \    /  \__|__\______  \/  __  \\   _  \ \   _  \                    |
+|    \   \/\/   /  |  |   /    />      </  /_\  \/  /_\  \                   |
+|     \        /|  |  |  /    //   --   \  \_/   \  \_/   \                  |
+|      \__/\  / |__|__| /____/ \______  /\_____  /\_____  /                  |
+|           \/                        \/       \/       \/                   |
+|                                                                            |
+|    Wii7800 by raz0red                                                      |
+|    Wii port of the ProSystem emulator developed by Greg Stanton            |
+|                                                                            |
+|    [github.com/raz0red/wii7800]                                            |
+|                                                                            |
++----------------------------------------------------------------------------+
+|                                                                            |
+|    This program is free software; you can redistribute it and/or           |
+|    modify it under the terms of the GNU General Public License             |
+|    as published by the Free Software Foundation; either version 2          |
+|    of the License, or (at your option) any later version.                  |
+|                                                                            |
+|    This program is distributed in the hope that it will be useful,         |
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+|    GNU General Public License for more details.                            |
+|                                                                            |
+|    You should have received a copy of the GNU General Public License       |
+|    along with this program; if not, write to the Free Software             |
+|    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA           |
+|    02110-1301, USA.                                                        |
+|                                                                            |
+\*--------------------------------------------------------------------------*/
+
+
+#include <zlib.h>
+
+#include "host_sound.h"
+
+/** The total count of samples that have been discarded by the null sink */
+CONTEXT_LOCAL unsigned long long host_sound_samples = 0;
+/** The running CRC-32 of the samples that have been discarded */
+CONTEXT_LOCAL unsigned long host_sound_crc = 0;
+
+/**
+ * Initializes the audio (null sink, no device is opened)
+ */
+void InitialiseAudio() {
+    host_sound_samples = 0;
+    host_sound_crc = crc32(0L, Z_NULL, 0);
+}
+
+/**
+ * Stops the audio
+ */
+void StopAudio() {}
+
+/**
+ * Resets the audio
+ */
+void ResetAudio() {}
+
+/**
+ * Discards the specified samples
+ *
+ * @param   Buffer The samples
+ * @param   samples The count of samples
+ */
+void PlaySound(u8* Buffer, int samples) {
+    host_sound_samples += samples;
+    host_sound_crc = crc32(host_sound_crc, Buffer, samples);
+}
@@ -47,6 +47,9 @@
 #define WII_BASE_APP_DIR "sd:/apps/wii7800/"
 
 #define WII_SAVE_GAME_EXT "sav"
+#define WII_MOVIE_EXT "mov"
+#define WII_PROFILE_EXT "prof"
+#define WII_FOLDED_EXT "folded"
 
 /**
  * The different types of nodes in the menu
@@ -74,14 +77,19 @@ enum NODETYPE {
     NODETYPE_SAVE_STATE,
     NODETYPE_LOAD_STATE,
     NODETYPE_DELETE_STATE,
+    NODETYPE_MOVIE_RECORD,
+    NODETYPE_MOVIE_PLAY,
     NODETYPE_VSYNC,
     NODETYPE_MAX_FRAME_RATE,
+    NODETYPE_FAST_FORWARD_SPEED,
     NODETYPE_DIFF_SWITCH_DISPLAY,
     NODETYPE_DIFF_SWITCH_ENABLED,
     NODETYPE_DISPLAY_SETTINGS,
     NODETYPE_CONTROLS_SETTINGS,
     NODETYPE_LIGHTGUN_CROSSHAIR,
     NODETYPE_LIGHTGUN_FLASH,
+    NODETYPE_REWIND,
+    NODETYPE_RUN_AHEAD,
     NODETYPE_RESIZE_SCREEN,
     NODETYPE_WIIMOTE_MENU_ORIENT,
     NODETYPE_16_9_CORRECTION,
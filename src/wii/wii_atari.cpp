@@ -33,13 +33,17 @@
 
 #include "Cartridge.h"
 #include "Database.h"
+#include "Movie.h"
+#include "Rewind.h"
 #include "Sound.h"
+#include "Stats.h"
 #include "Timer.h"
 #ifdef DEBUG
 #include "Logger.h"
 #endif
 
 #include <gccore.h>
+#include <ogc/lwp_watchdog.h>
 
 #include "font_ttf.h"
 
@@ -102,6 +106,12 @@ int wii_screen_y = DEFAULT_SCREEN_Y;
 short wii_debug = 0;
 /** The maximum frame rate */
 int wii_max_frame_rate = 0;
+/** The fast-forward speed (frames emulated per frame presented) */
+int wii_fast_forward_speed = FAST_FORWARD_SPEED_DEFAULT;
+/** Whether rewinding is enabled (it captures a state every frame) */
+BOOL wii_rewind = FALSE;
+/** The count of frames to run ahead (0 disables run-ahead) */
+int wii_run_ahead = 0;
 /** Whether to filter the display */
 BOOL wii_filter = FALSE;
 /** Whether to use the GX/VI scaler */
@@ -169,19 +179,18 @@ void WII_VideoStart();
 // For debug output
 //
 
-extern int hs_sram_write_count;
-extern unsigned int riot_timer_count;
 extern byte riot_drb;
 extern byte RANDOM;
-extern uint dbg_saved_cycles;
-extern uint dbg_wsync_count;
-extern uint dbg_maria_cycles;
-extern uint dbg_p6502_cycles;
-extern bool dbg_wsync;
-extern bool dbg_cycle_stealing;
 
 static float wii_fps_counter;
+static float wii_speed_counter;
+/** The time spent running ahead per frame (ms) */
+static float wii_run_ahead_counter;
 static int wii_dbg_scanlines;
+/** Whether fast-forward is currently held */
+static bool wii_fast_forward = false;
+/** Whether rewind is currently held */
+static bool wii_rewinding = false;
 
 /**
  * Returns the default screen sizes
@@ -416,6 +425,11 @@ bool wii_atari_load_rom(char* filename, bool loadbios) {
     wii_atari_init_palette8();
     prosystem_Reset();
 
+    // The size of the state depends on the cartridge
+    if (wii_rewind) {
+        rewind_Initialize(REWIND_DEFAULT_SIZE, 1);
+    }
+
     wii_atari_pause(false);
 
     return true;
@@ -743,6 +757,9 @@ static void wii_atari_update_joystick(int joyIndex,
         keyboard_data[14] =
             (held & WII_BUTTON_ATARI_PAUSE || gcHeld & GC_BUTTON_ATARI_PAUSE);
 
+        wii_fast_forward = (held & WII_BUTTON_ATARI_FAST_FORWARD);
+        wii_rewinding = (held & WII_BUTTON_ATARI_REWIND);
+
         if (wii_diff_switch_enabled) {
             // | 15       | Console      | Left Difficulty
             if ((diff_wait_count == 0) &&
@@ -842,15 +859,33 @@ void wii_render_callback() {
             /* a: %d, %d, c: 0x%x,0x%x,0x%x*/
             /* wii_sound_length, wii_convert_length, memory_ram[CTLSWB],
              * riot_drb, memory_ram[SWCHB] */
+#ifdef PROSYSTEM_STATS
+            const stats_frame* stats = stats_GetFrame();
             sprintf(text,
-                    "v: %.2f, hs: %d, %d, timer: %d, wsync: %s, %d, stl: %s, "
-                    "mar: %d, cpu: %d, ext: %d, rnd: %d, hb: %d, db: %s",
-                    wii_fps_counter, high_score_set, hs_sram_write_count,
-                    (riot_timer_count % 1000), (dbg_wsync ? "1" : "0"),
-                    dbg_wsync_count, (dbg_cycle_stealing ? "1" : "0"),
-                    dbg_maria_cycles, dbg_p6502_cycles, dbg_saved_cycles,
-                    RANDOM, cartridge_hblank,
+                    "v: %.2f, spd: %.2fx, ra: %.2fms, hs: %d, %d, timer: %d, "
+                    "wsync: %s, %d, stl: %s, mar: %d, cpu: %d, ext: %d, "
+                    "ins: %d, bank: %d, snd: %d/%d, "
+                    "us: %d/%d/%d/%d, rnd: %d, hb: %d, db: %s",
+                    wii_fps_counter, wii_speed_counter, wii_run_ahead_counter,
+                    high_score_set, stats->hs_sram_writes,
+                    stats->timer_writes, (stats->wsync ? "1" : "0"),
+                    stats->wsync_count, (stats->cycle_stealing ? "1" : "0"),
+                    stats->maria_cycles, stats->cpu_cycles,
+                    stats->saved_cycles, stats->instructions,
+                    stats->bank_switches, stats->tia_writes,
+                    stats->pokey_writes, (int)(stats->cpu_ns / 1000),
+                    (int)(stats->maria_ns / 1000),
+                    (int)(stats->audio_ns / 1000),
+                    (int)(stats->frame_ns / 1000), RANDOM, cartridge_hblank,
                     cart_in_db ? "1" : "0");
+#else
+            sprintf(text,
+                    "v: %.2f, spd: %.2fx, ra: %.2fms, hs: %d, rnd: %d, "
+                    "hb: %d, db: %s",
+                    wii_fps_counter, wii_speed_counter, wii_run_ahead_counter,
+                    high_score_set, RANDOM, cartridge_hblank,
+                    cart_in_db ? "1" : "0");
+#endif
 #if 0
     ", roll: %f"
     , wii_orient_roll
@@ -964,6 +999,17 @@ void wii_atari_main_loop(int testframes) {
     u32 timerCount = 0;
     u32 start_time = SDL_GetTicks();
 
+    // The emulated frames (including those skipped while fast-forwarding)
+    // since the speed was last measured
+    u32 speed_frames = 0;
+    u32 speed_time = start_time;
+    bool fast_forwarding = false;
+
+    // The time spent running ahead (and the count of frames run ahead of)
+    // since it was last measured
+    u64 run_ahead_ticks = 0;
+    u32 run_ahead_frames = 0;
+
     timer_Reset();
 
     if (testframes < 0) {
@@ -982,14 +1028,54 @@ void wii_atari_main_loop(int testframes) {
         if (testframes < 0) {
             wii_atari_update_keys(keyboard_data);
             wii_testframe = false;
+            // The movie being played replaces the input
+            movie_Input(keyboard_data);
         } else {
+            wii_fast_forward = false;
+            wii_rewinding = false;
             wii_testframe = true;
         }
 
         if (prosystem_active && !prosystem_paused) {
+            // Step back to the previous state and display the frame that
+            // follows it. Once the history is exhausted the emulation
+            // resumes.
+            bool rewound = wii_rewinding && movie_mode == MOVIE_MODE_NONE &&
+                           rewind_Step();
+            if (wii_fast_forward && !rewound) {
+                // Emulate the frames between those presented without
+                // rendering video or audio
+                for (int i = 1; i < wii_fast_forward_speed; i++) {
+                    prosystem_SkipFrame(keyboard_data);
+                    movie_Input(keyboard_data);
+                }
+                speed_frames += wii_fast_forward_speed - 1;
+                fast_forwarding = true;
+            } else if (fast_forwarding) {
+                // Resync the timer so it doesn't catch up on the frames
+                // that were run ahead of it
+                timer_Reset();
+                fast_forwarding = false;
+            }
+
             prosystem_ExecuteFrame(keyboard_data);
+            speed_frames++;
+
+            if (!rewound && testframes < 0) {
+                rewind_Capture();
+            }
+
+            // Display the frame the input will have produced a few frames
+            // from now (the cartridge reacts to it a frame or two late)
+            if (wii_run_ahead > 0 && !fast_forwarding && !rewound &&
+                testframes < 0) {
+                u64 run_ahead_start = gettime();
+                prosystem_RunAhead(keyboard_data, wii_run_ahead);
+                run_ahead_ticks += gettime() - run_ahead_start;
+                run_ahead_frames++;
+            }
 
-            if (wii_vsync) {
+            if (wii_vsync && !fast_forwarding) {
 #if 0        
                 wii_sync_video();
 #else
@@ -998,16 +1084,34 @@ void wii_atari_main_loop(int testframes) {
 #endif
             }
 
-            while (!timer_IsTime())
+            // Fast-forward is not capped by the timer
+            while (!fast_forwarding && !timer_IsTime())
                 ;
 
+            u32 now = SDL_GetTicks();
             fps_counter =
-                (((float)timerCount++ / (SDL_GetTicks() - start_time)) *
-                 1000.0);
+                (((float)timerCount++ / (now - start_time)) * 1000.0);
+
+            // The achieved speed (relative to the cartridge frequency)
+            if (now - speed_time >= 1000) {
+                wii_speed_counter =
+                    (((float)speed_frames / (now - speed_time)) * 1000.0) /
+                    prosystem_frequency;
+                wii_run_ahead_counter =
+                    run_ahead_frames > 0
+                        ? (ticks_to_microsecs(run_ahead_ticks) / 1000.0) /
+                              run_ahead_frames
+                        : 0;
+                run_ahead_ticks = 0;
+                run_ahead_frames = 0;
+                speed_frames = 0;
+                speed_time = now;
+            }
 
             wii_atari_refresh_screen(testframes);
 
-            if (testframes < 0) {
+            // The audio of a rewound frame plays forward, drop it
+            if (testframes < 0 && !rewound) {
                 sound_Store();
             }
 
@@ -65,6 +65,14 @@
 #define DEFAULT_SCREEN_X 548 // (6:7)
 #define DEFAULT_SCREEN_Y 480
 
+// Fast-forward speeds
+#define FAST_FORWARD_SPEED_MIN 2
+#define FAST_FORWARD_SPEED_MAX 8
+#define FAST_FORWARD_SPEED_DEFAULT 4
+
+// The maximum count of frames to run ahead
+#define RUN_AHEAD_MAX 4
+
 // vsync modes
 #define VSYNC_DISABLED 0
 #define VSYNC_ENABLED 1
@@ -102,6 +110,12 @@ extern BOOL wii_diff_switch_display;
 extern short wii_debug;
 /** The maximum frame rate */
 extern int wii_max_frame_rate;
+/** The fast-forward speed (frames emulated per frame presented) */
+extern int wii_fast_forward_speed;
+/** Whether rewinding is enabled */
+extern BOOL wii_rewind;
+/** The count of frames to run ahead (0 disables run-ahead) */
+extern int wii_run_ahead;
 /** The screen X size */
 extern int wii_screen_x;
 /** The screen Y size */
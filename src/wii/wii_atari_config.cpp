@@ -53,6 +53,12 @@ void wii_config_handle_read_value(char* name, char* value) {
         wii_debug = Util_sscandec(value);
     } else if (strcmp(name, "max_frame_rate") == 0) {
         wii_max_frame_rate = Util_sscandec(value);
+    } else if (strcmp(name, "fast_forward_speed") == 0) {
+        wii_fast_forward_speed = Util_sscandec(value);
+        if (wii_fast_forward_speed < FAST_FORWARD_SPEED_MIN ||
+            wii_fast_forward_speed > FAST_FORWARD_SPEED_MAX) {
+            wii_fast_forward_speed = FAST_FORWARD_SPEED_DEFAULT;
+        }
     } else if (strcmp(name, "top_menu_exit") == 0) {
         wii_top_menu_exit = Util_sscandec(value);
     } else if (strcmp(name, "vsync") == 0) {
@@ -65,6 +71,13 @@ void wii_config_handle_read_value(char* name, char* value) {
         wii_lightgun_crosshair = Util_sscandec(value);
     } else if (strcmp(name, "lightgun_flash") == 0) {
         wii_lightgun_flash = Util_sscandec(value);
+    } else if (strcmp(name, "rewind") == 0) {
+        wii_rewind = Util_sscandec(value);
+    } else if (strcmp(name, "run_ahead") == 0) {
+        wii_run_ahead = Util_sscandec(value);
+        if (wii_run_ahead < 0 || wii_run_ahead > RUN_AHEAD_MAX) {
+            wii_run_ahead = 0;
+        }
     } else if (strcmp(name, "screen_x") == 0) {
         wii_screen_x = Util_sscandec(value);
     } else if (strcmp(name, "screen_y") == 0) {
@@ -104,12 +117,15 @@ void wii_config_handle_read_value(char* name, char* value) {
 void wii_config_handle_write_config(FILE* fp) {
     fprintf(fp, "debug=%d\n", wii_debug);
     fprintf(fp, "max_frame_rate=%d\n", wii_max_frame_rate);
+    fprintf(fp, "fast_forward_speed=%d\n", wii_fast_forward_speed);
     fprintf(fp, "top_menu_exit=%d\n", wii_top_menu_exit);
     fprintf(fp, "vsync=%d\n", wii_vsync);
     fprintf(fp, "diff_switch_display=%d\n", wii_diff_switch_display);
     fprintf(fp, "diff_switch_enabled=%d\n", wii_diff_switch_enabled);
     fprintf(fp, "lightgun_crosshair=%d\n", wii_lightgun_crosshair);
     fprintf(fp, "lightgun_flash=%d\n", wii_lightgun_flash);
+    fprintf(fp, "rewind=%d\n", wii_rewind);
+    fprintf(fp, "run_ahead=%d\n", wii_run_ahead);
     fprintf(fp, "screen_x=%d\n", wii_screen_x);
     fprintf(fp, "screen_y=%d\n", wii_screen_y);
     fprintf(fp, "mote_menu_vertical=%d\n", wii_mote_menu_vertical);
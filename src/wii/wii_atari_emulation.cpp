@@ -34,7 +34,9 @@
 #include <malloc.h>
 #include <string.h>
 
+#include "Movie.h"
 #include "ProSystem.h"
+#include "Rewind.h"
 #include "Sound.h"
 
 #include "wii_app.h"
@@ -88,6 +90,7 @@ BOOL wii_start_emulation(char* romfile,
         }
 
         wii_reset_keyboard_data();
+        movie_Release();
         succeeded = wii_atari_load_rom(romfile, !loadsave);
 
         if (succeeded) {
@@ -104,21 +107,17 @@ BOOL wii_start_emulation(char* romfile,
                     }
                     succeeded = false;
                 } else {
-                    // Run some test frames
-                    //
-                    // TODO:
-                    //
-                    // This is definitely a ProSystem emu bug. Basically, if
-                    // you don't load the ROM and run some frames prior to
-                    // loading save state the game may not work. This is due to
-                    // the fact that it relies on state set when the ROM is
-                    // initially loaded (I believe it is Maria state). This is
-                    // something that should be resolved by adding Maria state
-                    // to the save file. For now, we just load the ROM and let
-                    // it execute for a second.
-                    wii_atari_main_loop(prosystem_frequency);
+                    // Version 1 save states don't capture the Maria, TIA and
+                    // POKEY state, the game may not work unless the ROM has
+                    // run for a while prior to loading them. Let it execute
+                    // for a second. Later versions capture the complete
+                    // machine and are loaded directly.
+                    if (prosystem_GetStateVersion(savefile) < 2) {
+                        wii_atari_main_loop(prosystem_frequency);
+                    }
 
                     succeeded = prosystem_Load(savefile);
+                    rewind_Reset();
                     if (succeeded) {
                         // Load high score cart after loading saved state
                         cartridge_LoadHighScoreCart();
@@ -137,6 +136,8 @@ BOOL wii_start_emulation(char* romfile,
     } else if (reset) {
         wii_reset_keyboard_data();
         prosystem_Reset();
+        rewind_Reset();
+        movie_Release();
     } else {
         prosystem_Pause(false);
     }
@@ -174,6 +175,10 @@ BOOL wii_start_emulation(char* romfile,
 
         wii_atari_main_loop();
 
+#ifdef PROSYSTEM_PROFILE
+        wii_write_profile();
+#endif
+
         if (wii_top_menu_exit) {
             // Pop to the top
             while (wii_menu_pop() != NULL)
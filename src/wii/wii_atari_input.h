@@ -46,6 +46,9 @@
 #define WII_BUTTON_ATARI_PAUSE (WPAD_CLASSIC_BUTTON_ZL | WPAD_CLASSIC_BUTTON_ZR)
 #define GC_BUTTON_ATARI_PAUSE (PAD_TRIGGER_R)
 
+#define WII_BUTTON_ATARI_FAST_FORWARD (WPAD_CLASSIC_BUTTON_X)
+#define WII_BUTTON_ATARI_REWIND (WPAD_CLASSIC_BUTTON_Y)
+
 #define WII_BUTTON_ATARI_RIGHT (WPAD_BUTTON_DOWN | WPAD_CLASSIC_BUTTON_RIGHT)
 #define GC_BUTTON_ATARI_RIGHT (PAD_BUTTON_RIGHT)
 #define WII_BUTTON_ATARI_UP (WPAD_BUTTON_RIGHT)
@@ -36,7 +36,9 @@
 #include <sys/iosupport.h>
 
 #include "Cartridge.h"
+#include "Movie.h"
 #include "Region.h"
+#include "Rewind.h"
 
 #include "wii_app_common.h"
 #include "wii_main.h"
@@ -152,6 +154,15 @@ void wii_atari_menu_init() {
     child = wii_create_tree_node(NODETYPE_DELETE_STATE, "Delete state");
     wii_add_child(states, child);    
 
+    child = wii_create_tree_node(NODETYPE_SPACER, "");
+    wii_add_child(states, child);
+
+    child = wii_create_tree_node(NODETYPE_MOVIE_RECORD, "Movie recording");
+    wii_add_child(states, child);
+
+    child = wii_create_tree_node(NODETYPE_MOVIE_PLAY, "Play movie");
+    wii_add_child(states, child);
+
     //
     // Cartridge settings
     //
@@ -191,6 +202,10 @@ void wii_atari_menu_init() {
         wii_create_tree_node(NODETYPE_MAX_FRAME_RATE, "Maximum frame rate");
     wii_add_child(display, child);
 
+    child =
+        wii_create_tree_node(NODETYPE_FAST_FORWARD_SPEED, "Fast-forward speed");
+    wii_add_child(display, child);
+
     child = wii_create_tree_node(NODETYPE_FULL_WIDESCREEN, "Full widescreen");
     wii_add_child(display, child);
 
@@ -228,6 +243,12 @@ void wii_atari_menu_init() {
     child = wii_create_tree_node(NODETYPE_LIGHTGUN_FLASH, "Lightgun flash");
     wii_add_child(controls, child);
 
+    child = wii_create_tree_node(NODETYPE_REWIND, "Rewind");
+    wii_add_child(controls, child);
+
+    child = wii_create_tree_node(NODETYPE_RUN_AHEAD, "Run-ahead");
+    wii_add_child(controls, child);
+
     //
     // The diff switch settings
     //
@@ -424,11 +445,27 @@ void wii_menu_handle_get_node_name(TREENODE* node, char* buffer, char* value) {
                 snprintf(value, WII_MENU_BUFF_SIZE, "%d", wii_max_frame_rate);
             }
             break;
+        case NODETYPE_FAST_FORWARD_SPEED:
+            snprintf(value, WII_MENU_BUFF_SIZE, "%dx", wii_fast_forward_speed);
+            break;
+        case NODETYPE_MOVIE_RECORD:
+            snprintf(value, WII_MENU_BUFF_SIZE, "%s",
+                     movie_mode == MOVIE_MODE_RECORD ? "Recording" : "Stopped");
+            break;
+        case NODETYPE_RUN_AHEAD:
+            if (wii_run_ahead == 0) {
+                snprintf(value, WII_MENU_BUFF_SIZE, "(disabled)");
+            } else {
+                snprintf(value, WII_MENU_BUFF_SIZE, "%d frame%s", wii_run_ahead,
+                         wii_run_ahead > 1 ? "s" : "");
+            }
+            break;
         case NODETYPE_DEBUG_MODE:
         case NODETYPE_TOP_MENU_EXIT:
         case NODETYPE_DIFF_SWITCH_ENABLED:
         case NODETYPE_LIGHTGUN_CROSSHAIR:
         case NODETYPE_LIGHTGUN_FLASH: 
+        case NODETYPE_REWIND:
         case NODETYPE_DOUBLE_STRIKE:
         case NODETYPE_TRAP_FILTER:        
         case NODETYPE_FILTER: {
@@ -458,6 +495,9 @@ void wii_menu_handle_get_node_name(TREENODE* node, char* buffer, char* value) {
                 case NODETYPE_LIGHTGUN_FLASH:
                     enabled = wii_lightgun_flash;
                     break;
+                case NODETYPE_REWIND:
+                    enabled = wii_rewind;
+                    break;
                 default:
                     break;
             }
@@ -482,6 +522,7 @@ void wii_menu_handle_select_node(TREENODE* node) {
     if (node->node_type == NODETYPE_ROM || 
         node->node_type == NODETYPE_RESUME ||
         node->node_type == NODETYPE_LOAD_STATE ||
+        node->node_type == NODETYPE_MOVIE_PLAY ||
         node->node_type == NODETYPE_RESET) {
         char buff[WII_MAX_PATH];
 
@@ -514,6 +555,9 @@ void wii_menu_handle_select_node(TREENODE* node) {
                 }
                 loading_game = FALSE;
                 break;
+            case NODETYPE_MOVIE_PLAY:
+                wii_start_movie();
+                break;
         }
 
         wii_gx_pop_callback();
@@ -604,6 +648,14 @@ void wii_menu_handle_select_node(TREENODE* node) {
             case NODETYPE_LIGHTGUN_FLASH:
                 wii_lightgun_flash ^= 1;
                 break;
+            case NODETYPE_REWIND:
+                wii_rewind ^= 1;
+                if (wii_rewind) {
+                    rewind_Initialize(REWIND_DEFAULT_SIZE, 1);
+                } else {
+                    rewind_Release();
+                }
+                break;
             case NODETYPE_MAX_FRAME_RATE:
                 wii_max_frame_rate += 1;
                 if (wii_max_frame_rate > 70) {
@@ -612,6 +664,18 @@ void wii_menu_handle_select_node(TREENODE* node) {
                     wii_max_frame_rate = 30;
                 }
                 break;
+            case NODETYPE_RUN_AHEAD:
+                wii_run_ahead += 1;
+                if (wii_run_ahead > RUN_AHEAD_MAX) {
+                    wii_run_ahead = 0;
+                }
+                break;
+            case NODETYPE_FAST_FORWARD_SPEED:
+                wii_fast_forward_speed += 1;
+                if (wii_fast_forward_speed > FAST_FORWARD_SPEED_MAX) {
+                    wii_fast_forward_speed = FAST_FORWARD_SPEED_MIN;
+                }
+                break;
             case NODETYPE_DOUBLE_STRIKE:
                 wii_double_strike_mode ^= 1;
                 break;
@@ -656,6 +720,9 @@ void wii_menu_handle_select_node(TREENODE* node) {
                 wii_delete_snapshot();
                 wii_snapshot_refresh();
                 break;
+            case NODETYPE_MOVIE_RECORD:
+                wii_movie_record();
+                break;
             case NODETYPE_CARTRIDGE_SAVE_STATES_SLOT:
                 wii_snapshot_next();
                 break;
@@ -689,6 +756,8 @@ BOOL wii_menu_handle_is_node_visible(TREENODE* node) {
         case NODETYPE_DELETE_STATE:
         case NODETYPE_LOAD_STATE:
             return wii_snapshot_current_exists();
+        case NODETYPE_MOVIE_PLAY:
+            return wii_movie_exists() && movie_mode != MOVIE_MODE_RECORD;
         case NODETYPE_GX_VI_SCALER:
             return !wii_double_strike_mode;
         case NODETYPE_FILTER:
@@ -35,7 +35,10 @@
 #include <sys/stat.h>
 #include <time.h>
 
+#include "Movie.h"
 #include "ProSystem.h"
+#include "Profile.h"
+#include "Rewind.h"
 
 #include "wii_app_common.h"
 #include "wii_app.h"
@@ -58,6 +61,8 @@ static int ss_latest = -1;
 static char savename[WII_MAX_PATH] = "";
 /** The file name */
 static char filename[WII_MAX_PATH] = "";
+/** Whether the movie of the current rom exists */
+static int movie_exists = -1;
 
 /**
  * Returns the name of the snapshot associated with the specified romfile and
@@ -81,6 +86,7 @@ static void get_snapshot_name(const char* romfile, int index, char* buffer) {
 void wii_snapshot_refresh() {
     ss_exists = -1;
     ss_latest = -1;
+    movie_exists = -1;
 }
 
 /**
@@ -209,3 +215,109 @@ BOOL wii_start_snapshot() {
     return wii_start_emulation(wii_last_rom, savename, FALSE, FALSE);
 }
 
+/**
+ * Returns the name of the movie associated with the specified romfile
+ *
+ * @param   romfile The rom file
+ * @param   buffer The output buffer to receive the name of the movie file
+ *              (length must be WII_MAX_PATH)
+ */
+static void get_movie_name(const char* romfile, char* buffer) {
+    filename[0] = '\0';
+    Util_splitpath(romfile, NULL, filename);
+    snprintf(buffer, WII_MAX_PATH, "%s%s.%s", wii_get_saves_dir(), filename,
+             WII_MOVIE_EXT);
+}
+
+/**
+ * Returns whether a movie exists for the current rom
+ *
+ * @return  Whether a movie exists for the current rom
+ */
+BOOL wii_movie_exists() {
+    if (movie_exists == -1) {
+        if (!wii_last_rom) {
+            movie_exists = FALSE;
+        } else {
+            savename[0] = '\0';
+            get_movie_name(wii_last_rom, savename);
+            movie_exists = Util_fileexists(savename);
+        }
+    }
+
+    return movie_exists;
+}
+
+/**
+ * Starts recording a movie from the current state or, if a movie is being
+ * recorded, stops recording and saves it
+ */
+void wii_movie_record() {
+    if (!wii_last_rom) {
+        return;
+    }
+
+    if (movie_mode != MOVIE_MODE_RECORD) {
+        if (!movie_Record(MOVIE_DEFAULT_INTERVAL)) {
+            wii_set_status_message(
+                "An error occurred attempting to record the movie.");
+        }
+        return;
+    }
+
+    movie_Stop();
+    savename[0] = '\0';
+    get_movie_name(wii_last_rom, savename);
+    if (movie_Save(savename)) {
+        wii_set_status_message("The movie was saved.");
+    } else {
+        wii_set_status_message(
+            "An error occurred attempting to save the movie.");
+    }
+    movie_Release();
+    movie_exists = -1;  // force recheck
+}
+
+/**
+ * Starts emulation playing the movie of the current rom
+ *
+ * @return  Whether emulation was successfully started
+ */
+BOOL wii_start_movie() {
+    if (!wii_last_rom) {
+        return FALSE;
+    }
+
+    savename[0] = '\0';
+    get_movie_name(wii_last_rom, savename);
+    if (!movie_Load(savename) || !movie_Play()) {
+        movie_Release();
+        wii_set_status_message(
+            "An error occurred attempting to play the movie.");
+        return FALSE;
+    }
+
+    // The history precedes the start of the movie
+    rewind_Reset();
+    wii_resume_emulation();
+    return TRUE;
+}
+
+/**
+ * Writes the CPU profile and call stacks of the current rom to the saves
+ * directory (PROFILE=1 builds)
+ */
+void wii_write_profile() {
+    if (!wii_last_rom) {
+        return;
+    }
+
+    filename[0] = '\0';
+    Util_splitpath(wii_last_rom, NULL, filename);
+    snprintf(savename, WII_MAX_PATH, "%s%s.%s", wii_get_saves_dir(), filename,
+             WII_PROFILE_EXT);
+    profile_Write(savename);
+    snprintf(savename, WII_MAX_PATH, "%s%s.%s", wii_get_saves_dir(), filename,
+             WII_FOLDED_EXT);
+    profile_WriteFolded(savename);
+}
@@ -80,4 +80,30 @@ BOOL wii_snapshot_current_exists();
  */
 int wii_snapshot_next();
 
+/**
+ * Returns whether a movie exists for the current rom
+ *
+ * @return  Whether a movie exists for the current rom
+ */
+BOOL wii_movie_exists();
+
+/**
+ * Starts recording a movie from the current state or, if a movie is being
+ * recorded, stops recording and saves it
+ */
+void wii_movie_record();
+
+/**
+ * Starts emulation playing the movie of the current rom
+ *
+ * @return  Whether emulation was successfully started
+ */
+BOOL wii_start_movie();
+
+/**
+ * Writes the CPU profile and call stacks of the current rom to the saves
+ * directory (PROFILE=1 builds)
+ */
+void wii_write_profile();
+
 #endif
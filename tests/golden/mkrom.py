@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+#
+# Builds the synthetic ROMs used by the golden-frame regression suite
+# (make -f Makefile.host check). The ROMs exercise the CPU, Maria (every
+# read mode, both write modes, kangaroo mode and holey DMA), the RIOT
+# timers, TIA and POKEY audio, bank switching, cartridge RAM and the
+# expansion module;
+# they are generated rather than stored so the suite has no dependencies on
+# commercial ROMs.
+#
+#   mkrom.py <output directory>
+#
+import os
+import sys
+
+# A tiny two-pass 6502 assembler
+OPS = {
+ # mnemonic: {mode: opcode}
+ 'ADC': {'imm':0x69,'zp':0x65,'zpx':0x75,'abs':0x6D,'absx':0x7D,'absy':0x79,'indx':0x61,'indy':0x71},
+ 'AND': {'imm':0x29,'zp':0x25,'zpx':0x35,'abs':0x2D,'absx':0x3D,'absy':0x39,'indx':0x21,'indy':0x31},
+ 'ASL': {'acc':0x0A,'zp':0x06,'zpx':0x16,'abs':0x0E,'absx':0x1E},
+ 'BCC': {'rel':0x90},'BCS': {'rel':0xB0},'BEQ': {'rel':0xF0},'BMI': {'rel':0x30},
+ 'BNE': {'rel':0xD0},'BPL': {'rel':0x10},'BVC': {'rel':0x50},'BVS': {'rel':0x70},
+ 'BIT': {'zp':0x24,'abs':0x2C},
+ 'BRK': {'imp':0x00},'CLC': {'imp':0x18},'CLD': {'imp':0xD8},'CLI': {'imp':0x58},'CLV': {'imp':0xB8},
+ 'CMP': {'imm':0xC9,'zp':0xC5,'zpx':0xD5,'abs':0xCD,'absx':0xDD,'absy':0xD9,'indx':0xC1,'indy':0xD1},
+ 'CPX': {'imm':0xE0,'zp':0xE4,'abs':0xEC},'CPY': {'imm':0xC0,'zp':0xC4,'abs':0xCC},
+ 'DEC': {'zp':0xC6,'zpx':0xD6,'abs':0xCE,'absx':0xDE},'DEX': {'imp':0xCA},'DEY': {'imp':0x88},
+ 'EOR': {'imm':0x49,'zp':0x45,'zpx':0x55,'abs':0x4D,'absx':0x5D,'absy':0x59,'indx':0x41,'indy':0x51},
+ 'INC': {'zp':0xE6,'zpx':0xF6,'abs':0xEE,'absx':0xFE},'INX': {'imp':0xE8},'INY': {'imp':0xC8},
+ 'JMP': {'abs':0x4C,'ind':0x6C},'JSR': {'abs':0x20},
+ 'LDA': {'imm':0xA9,'zp':0xA5,'zpx':0xB5,'abs':0xAD,'absx':0xBD,'absy':0xB9,'indx':0xA1,'indy':0xB1},
+ 'LDX': {'imm':0xA2,'zp':0xA6,'zpy':0xB6,'abs':0xAE,'absy':0xBE},
+ 'LDY': {'imm':0xA0,'zp':0xA4,'zpx':0xB4,'abs':0xAC,'absx':0xBC},
+ 'LSR': {'acc':0x4A,'zp':0x46,'zpx':0x56,'abs':0x4E,'absx':0x5E},
+ 'NOP': {'imp':0xEA},
+ 'ORA': {'imm':0x09,'zp':0x05,'zpx':0x15,'abs':0x0D,'absx':0x1D,'absy':0x19,'indx':0x01,'indy':0x11},
+ 'PHA': {'imp':0x48},'PHP': {'imp':0x08},'PLA': {'imp':0x68},'PLP': {'imp':0x28},
+ 'ROL': {'acc':0x2A,'zp':0x26,'zpx':0x36,'abs':0x2E,'absx':0x3E},
+ 'ROR': {'acc':0x6A,'zp':0x66,'zpx':0x76,'abs':0x6E,'absx':0x7E},
+ 'RTI': {'imp':0x40},'RTS': {'imp':0x60},
+ 'SBC': {'imm':0xE9,'zp':0xE5,'zpx':0xF5,'abs':0xED,'absx':0xFD,'absy':0xF9,'indx':0xE1,'indy':0xF1},
+ 'SEC': {'imp':0x38},'SED': {'imp':0xF8},'SEI': {'imp':0x78},
+ 'STA': {'zp':0x85,'zpx':0x95,'abs':0x8D,'absx':0x9D,'absy':0x99,'indx':0x81,'indy':0x91},
+ 'STX': {'zp':0x86,'zpy':0x96,'abs':0x8E},'STY': {'zp':0x84,'zpx':0x94,'abs':0x8C},
+ 'TAX': {'imp':0xAA},'TAY': {'imp':0xA8},'TSX': {'imp':0xBA},'TXA': {'imp':0x8A},'TXS': {'imp':0x9A},'TYA': {'imp':0x98},
+}
+SIZE = {'imp':1,'acc':1,'imm':2,'zp':2,'zpx':2,'zpy':2,'rel':2,'indx':2,'indy':2,'abs':3,'absx':3,'absy':3,'ind':3}
+
+class Asm:
+    def __init__(self, org):
+        self.org = org
+        self.items = []   # (pc, kind, data)
+        self.labels = {}
+        self.pc = org
+    def label(self, name):
+        self.labels[name] = self.pc
+    def at(self, addr):
+        self.pc = addr
+    def op(self, mn, mode='imp', arg=None):
+        self.items.append((self.pc, 'op', (mn, mode, arg)))
+        self.pc += SIZE[mode]
+    def byte(self, *vals):
+        for v in vals:
+            self.items.append((self.pc, 'byte', v))
+            self.pc += 1
+    def word(self, *vals):
+        for v in vals:
+            self.items.append((self.pc, 'word', v))
+            self.pc += 2
+    def val(self, a):
+        if isinstance(a, str):
+            if a.startswith('<'): return self.labels[a[1:]] & 0xFF
+            if a.startswith('>'): return self.labels[a[1:]] >> 8
+            return self.labels[a]
+        return a
+    def emit(self, mem, base):
+        for pc, kind, data in self.items:
+            o = pc - base
+            if kind == 'byte':
+                mem[o] = self.val(data) & 0xFF
+            elif kind == 'word':
+                v = self.val(data); mem[o] = v & 0xFF; mem[o+1] = v >> 8
+            else:
+                mn, mode, arg = data
+                mem[o] = OPS[mn][mode]
+                if mode == 'rel':
+                    d = self.val(arg) - (pc + 2)
+                    assert -128 <= d <= 127, (mn, arg, d)
+                    mem[o+1] = d & 0xFF
+                elif SIZE[mode] == 2:
+                    mem[o+1] = self.val(arg) & 0xFF
+                elif SIZE[mode] == 3:
+                    v = self.val(arg); mem[o+1] = v & 0xFF; mem[o+2] = v >> 8
+
+# The synthetic ROMs:
+#   normal  direct/indirect Maria DMA, DLIs, TIA audio, RIOT timers, WSYNC
+#   pokey   as normal, plus POKEY audio and RANDOM
+#   sg      128K SuperGame cartridge with bank switching
+#   lg      lightgun hit detection loop
+#   cpu     a longer ALU workout (decimal mode, shifts, indexed modes)
+#   320ac   as normal in the 320A/C read mode
+#   320bd   as normal in the 320B/D read mode, with 2 byte characters
+#   kangaroo  as normal in kangaroo mode, cycling through the read modes
+#   xm      as normal with an expansion module: banked RAM and POKEY
+#   ram     as normal with RAM at $4000-$7FFF
+KINDS = ('normal', 'pokey', 'sg', 'lg', 'cpu', '320ac', '320bd', 'kangaroo', 'xm',
+         'ram')
+
+# The CTRL of each ROM (DMA on)
+CTRL = {'320ac': 0x43, '320bd': 0x52, 'kangaroo': 0x44}
+# The ROMs that change CTRL at each VBLANK, indexed by the frame counter
+# shifted right: the kangaroo ROM cycles through the read modes every 32
+# frames, the lightgun ROM turns DMA off every other frame (the lightgun
+# is only emulated while DMA is off)
+CTRLTAB = {'kangaroo': (5, (0x44, 0x46, 0x47, 0x44)), 'lg': (0, (0x40, 0x60))}
+
+def build(kind):
+    supergame = (kind == 'sg')
+    pokey = (kind == 'pokey')
+    lg = (kind == 'lg')
+    cpu = (kind == 'cpu')
+    xm = (kind == 'xm')
+    ram = (kind == 'ram')
+    a = Asm(0xC000 if supergame else 0x8000)
+    L = a.label; O = a.op
+    # ---- graphics in 16 consecutive pages (h16 zones) ----
+    gfx_base = 0xD000 if supergame else 0x9000
+    a.at(gfx_base)
+    L('gfx')
+    for page in range(16):
+        for i in range(256):
+            a.byte(((page * 37) ^ (i * 11) ^ (i >> 3)) & 0xFF)
+    # character map for indirect mode (row of char indexes)
+    a.at(gfx_base + 0x1000)
+    L('chars')
+    for i in range(32):
+        a.byte((i * 7) & 0xFF)
+    L('emptydl')
+    a.byte(0, 0)
+    # static DL: two 4-byte objects + one 5-byte indirect + terminator
+    L('dl_static')
+    a.byte(0x00, (1 << 5) | ((32 - 8) & 31), (gfx_base >> 8), 10)     # 8 bytes, palette 1
+    a.byte(0x40, (2 << 5) | ((32 - 4) & 31), (gfx_base >> 8), 90)     # 4 bytes, palette 2
+    a.byte('<chars', 0x60, '>chars', (3 << 5) | ((32 - 6) & 31), 120)  # indirect
+    a.byte(0x20, 0xC0, (gfx_base >> 8), (6 << 5) | ((32 - 5) & 31), 60)   # write mode 1
+    a.byte('<chars', 0xE0, '>chars', (7 << 5) | ((32 - 4) & 31), 140)  # indirect, write mode 1
+    a.byte(0, 0)
+    # DLL: 16 zones of 16 lines
+    L('dll')
+    a.byte(0x80 | 15, '>emptydl', '<emptydl')     # DLI on first zone
+    for z in range(1, 16):
+        if z % 3 == 0:
+            a.byte(0x00 | 15 | (0x80 if z == 8 else 0), 0x22, 0x00)  # RAM DL at $2200
+        elif z % 3 == 1:
+            a.byte(15 | (0x20 if z == 4 else 0), '>dl_static', '<dl_static')  # holey DMA (8 lines) in zone 4
+        else:
+            a.byte(15, '>emptydl', '<emptydl')
+    a.byte(15, '>emptydl', '<emptydl')
+    # RAM DL template (sprite moved each frame) + terminator
+    L('dltemplate')
+    a.byte(0x80, (4 << 5) | ((32 - 2) & 31), (gfx_base >> 8), 0)
+    a.byte(0x10, 0x40, (gfx_base >> 8), (5 << 5) | ((32 - 3) & 31), 40)
+    a.byte(0, 0)
+    L('paltab')
+    for i in range(32):
+        a.byte((i * 13 + 5) & 0xFF)
+    # CTRL of the ROMs that change it (see CTRLTAB)
+    if kind in CTRLTAB:
+        L('ctrltab')
+        a.byte(*CTRLTAB[kind][1])
+
+    # ---- code ----
+    L('reset')
+    O('SEI'); O('CLD')
+    O('LDA','imm',0x07); O('STA','zp',0x01)
+    O('LDA','imm',0x7F); O('STA','zp',0x3C)
+    O('LDX','imm',0xFF); O('TXS')
+    O('LDA','imm',0); O('LDX','imm',0x40)
+    L('clr'); O('STA','zpx',0x00); O('INX'); O('BNE','rel','clr')
+    O('LDA','imm',0x00); O('STA','zp',0x80); O('LDA','imm',0x18); O('STA','zp',0x81)
+    O('LDY','imm',0); O('LDA','imm',0)
+    L('clr2'); O('STA','indy',0x80); O('INY'); O('BNE','rel','clr2')
+    O('INC','zp',0x81); O('LDX','zp',0x81); O('CPX','imm',0x20); O('BNE','rel','clr2')
+    O('LDX','imm',14)
+    L('cp'); O('LDA','absx','dltemplate'); O('STA','absx',0x2200); O('DEX'); O('BPL','rel','cp')
+    O('LDX','imm',0)
+    L('pal'); O('LDA','absx','paltab'); O('STA','zpx',0x20); O('INX'); O('CPX','imm',0x20); O('BNE','rel','pal')
+    O('LDA','imm','<dll'); O('STA','zp',0x30)
+    O('LDA','imm','>dll'); O('STA','zp',0x2C)
+    O('LDA','imm','>chars'); O('STA','zp',0x34)
+    if pokey:
+        O('LDA','imm',0x03); O('STA','abs',0x400F)   # SKCTL
+        O('LDA','imm',0x00); O('STA','abs',0x4008)   # AUDCTL
+    if xm:
+        O('LDA','imm',0x18); O('STA','abs',0x470)    # XCTRL: RAM and POKEY
+        O('LDA','imm',0x03); O('STA','abs',0x45F)    # SKCTL
+        O('LDA','imm',0x00); O('STA','abs',0x458)    # AUDCTL
+    L('wvb'); O('BIT','zp',0x28); O('BPL','rel','wvb')
+    O('LDA','imm',CTRL.get(kind, 0x40)); O('STA','zp',0x3C)
+    O('LDA','imm',0x14); O('STA','abs',0x283)      # CTLSWB (2 button mode)
+
+    L('main')
+    L('wv0'); O('BIT','zp',0x28); O('BMI','rel','wv0')
+    L('wv1'); O('BIT','zp',0x28); O('BPL','rel','wv1')
+    O('INC','zp',0x40)
+    if kind in CTRLTAB:
+        shift, values = CTRLTAB[kind]
+        O('LDA','zp',0x40)
+        for _ in range(shift): O('LSR','acc')
+        O('AND','imm',len(values) - 1); O('TAY')
+        O('LDA','absy','ctrltab'); O('STA','zp',0x3C)
+    O('INC','abs',0x2203)
+    O('LDA','zp',0x40); O('AND','imm',0x3F); O('STA','abs',0x2208)
+    O('LDA','abs',0x280); O('STA','zp',0x41)
+    O('LDA','zp',0x0C); O('STA','zp',0x42)
+    O('LDA','zp',0x08); O('STA','zp',0x43)
+    O('LDA','abs',0x282); O('STA','zp',0x45)
+    # joystick moves sprite vertically: right -> faster hpos
+    O('LDA','zp',0x41); O('AND','imm',0x80); O('BNE','rel','nojr'); O('INC','abs',0x2203)
+    L('nojr')
+    # TIA sound
+    O('LDA','zp',0x40); O('AND','imm',0x1F); O('STA','zp',0x17)
+    O('LDA','imm',0x04); O('STA','zp',0x15)
+    O('LDA','imm',0x0F); O('STA','zp',0x19)
+    O('LDA','zp',0x40); O('LSR','acc'); O('AND','imm',0x0F); O('STA','zp',0x18)
+    O('LDA','imm',0x08); O('STA','zp',0x16)
+    O('LDA','zp',0x40); O('AND','imm',0x07); O('STA','zp',0x1A)
+    if pokey:
+        O('LDA','zp',0x40); O('STA','abs',0x4000)
+        O('LDA','imm',0xA8); O('STA','abs',0x4001)
+        O('LDA','zp',0x40); O('ASL','acc'); O('STA','abs',0x4002)
+        O('LDA','imm',0x46); O('STA','abs',0x4003)
+        O('LDA','abs',0x400A); O('STA','zp',0x46)
+    if xm:
+        O('LDA','zp',0x40); O('STA','abs',0x450)
+        O('LDA','imm',0xA8); O('STA','abs',0x451)
+        O('LDA','zp',0x40); O('LSR','acc'); O('STA','abs',0x452)
+        O('LDA','imm',0x2C); O('STA','abs',0x453)
+        O('LDA','abs',0x45A); O('STA','zp',0x46)
+        # fill a page of the RAM bank of the frame, sum it from the next bank
+        O('LDA','zp',0x40); O('AND','imm',0x07); O('ORA','imm',0x18); O('STA','abs',0x470)
+        O('LDY','imm',0x1F)
+        L('xw'); O('LDA','absy','gfx'); O('EOR','zp',0x40); O('STA','absy',0x4100); O('DEY'); O('BPL','rel','xw')
+        O('LDA','zp',0x40); O('CLC'); O('ADC','imm',1); O('AND','imm',0x07); O('ORA','imm',0x18); O('STA','abs',0x470)
+        O('LDY','imm',0x1F); O('LDA','imm',0); O('CLC')
+        L('xr'); O('ADC','absy',0x4100); O('DEY'); O('BPL','rel','xr')
+        O('STA','zp',0x4A)
+        # with the RAM disabled, $4000-$7FFF is no longer mapped to it
+        O('LDA','imm',0x10); O('STA','abs',0x470)
+        O('LDA','zp',0x40); O('STA','abs',0x4100); O('LDA','abs',0x4100); O('STA','zp',0x4B)
+    if ram:
+        # fill a page of the cartridge RAM each frame, sum the page filled
+        # 63 frames earlier (the RAM must survive the keyframes)
+        O('LDA','zp',0x40); O('AND','imm',0x3F); O('ORA','imm',0x40); O('STA','zp',0x85)
+        O('LDA','imm',0); O('STA','zp',0x84)
+        O('LDY','imm',0x3F)
+        L('rw'); O('LDA','absy','gfx'); O('EOR','zp',0x40); O('STA','indy',0x84); O('DEY'); O('BPL','rel','rw')
+        O('LDA','zp',0x85); O('CLC'); O('ADC','imm',1); O('AND','imm',0x3F); O('ORA','imm',0x40); O('STA','zp',0x85)
+        O('LDY','imm',0x3F); O('LDA','imm',0); O('CLC')
+        L('rr'); O('ADC','indy',0x84); O('DEY'); O('BPL','rel','rr')
+        O('STA','zp',0x4C)
+    if lg:
+        # lightgun hit detection loop (BIT INPT4 takes a half cycle)
+        O('LDY','imm',8); O('LDX','imm',0)
+        L('lgl'); O('BIT','zp',0x0C); O('BPL','rel','lghit'); O('INX'); O('BNE','rel','lgl')
+        O('DEY'); O('BNE','rel','lgl')
+        L('lghit'); O('STX','zp',0x48); O('STY','zp',0x49)
+        O('LDA','zp',0x40); O('AND','imm',0x3F); O('TAY'); O('TXA'); O('STA','absy',0x1B00)
+    # RIOT timer wait (TIM64T) then TIM8T + INTFLG poll
+    O('LDA','imm',0x10); O('STA','abs',0x296)
+    L('tl'); O('LDA','abs',0x284); O('BNE','rel','tl')
+    O('LDA','imm',0x30); O('STA','abs',0x295)
+    L('tl2'); O('LDA','abs',0x285); O('BPL','rel','tl2')
+    O('LDA','abs',0x284); O('STA','zp',0x47)
+    # short timers read back after a delay (expiry inside a CPU run)
+    for (reg, val, pad) in ((0x294, 3, 4), (0x294, 0, 2), (0x295, 2, 9), (0x294, 7, 1), (0x296, 1, 40)):
+        O('LDA','imm',val); O('STA','abs',reg)
+        for _ in range(pad): O('NOP')
+        O('LDA','abs',0x285); O('STA','absx',0x1C00); O('INX')
+        O('LDA','abs',0x284); O('STA','absx',0x1C00); O('INX')
+        for _ in range(pad): O('NOP')
+        O('LDA','abs',0x284); O('STA','absx',0x1C00); O('INX')
+    # WSYNCs
+    O('STA','zp',0x24); O('STA','zp',0x24); O('STA','zp',0x24)
+    # ALU workout: sum/eor/rol across 64 bytes of ROM gfx with decimal mode
+    O('LDY','imm',0); O('LDA','imm',0); O('CLC')
+    if cpu: O('LDX','imm',40)
+    L('alu')
+    O('ADC','absy','gfx'); O('EOR','zp',0x40); O('ROL','acc'); O('STA','zp',0x50)
+    O('SED'); O('ADC','imm',0x15); O('CLD'); O('SBC','zp',0x50); O('ROR','zp',0x51)
+    O('INY'); O('CPY','imm',0x40); O('BNE','rel','alu')
+    if cpu: O('LDY','imm',0); O('DEX'); O('BNE','rel','alu')
+    O('STA','zp',0x52)
+    O('LDA','zp',0x51); O('STA','abs',0x1900)
+    # indirect indexed RAM updates
+    O('LDA','imm',0x00); O('STA','zp',0x82); O('LDA','imm',0x19); O('STA','zp',0x83)
+    O('LDY','zp',0x40); O('LDA','zp',0x52); O('STA','indy',0x82)
+    if supergame:
+        O('LDA','zp',0x40); O('LSR','acc'); O('LSR','acc'); O('AND','imm',0x07)
+        O('STA','abs',0x8000)          # select bank
+        O('JSR','abs',0x8000)          # call bank routine
+    # stack workout
+    O('PHP'); O('PHA'); O('TXA'); O('PHA'); O('PLA'); O('TAX'); O('PLA'); O('PLP')
+    O('JMP','abs','main')
+
+    L('nmi')
+    O('PHA'); O('TXA'); O('PHA')
+    O('INC','zp',0x44); O('LDA','zp',0x44); O('STA','zp',0x21)
+    O('STA','zp',0x24)
+    O('PLA'); O('TAX'); O('PLA')
+    O('RTI')
+    L('irq'); O('RTI')
+
+    a.at(0xFFFA)
+    a.word('nmi', 'reset', 'irq')
+
+    if supergame:
+        size = 0x20000
+        rom = bytearray(size)
+        last = bytearray(0x4000)
+        a.emit(last, 0xC000)
+        for b in range(8):
+            bank = bytearray(0x4000)
+            ba = Asm(0x8000)
+            ba.op('LDA','imm',0x30 + b); ba.op('STA','abs',0x1A00 + b)
+            ba.op('LDA','zp',0x40); ba.op('CLC'); ba.op('ADC','imm',b); ba.op('STA','abs',0x1A10)
+            ba.op('RTS')
+            ba.emit(bank, 0x8000)
+            rom[b*0x4000:(b+1)*0x4000] = bank
+        rom[7*0x4000:8*0x4000] = last
+        ct = 2
+    else:
+        size = 0x8000
+        rom = bytearray(size)
+        a.emit(rom, 0x8000)
+        ct = 1 if pokey else 4 if ram else 0
+    hdr = bytearray(128)
+    hdr[0] = 1
+    hdr[1:10] = b'ATARI7800'
+    title = ('synthetic ' + kind).encode()
+    hdr[17:17+len(title)] = title
+    hdr[49:53] = size.to_bytes(4, 'big')
+    hdr[53] = 0
+    hdr[54] = ct
+    hdr[55] = 2 if lg else 1; hdr[56] = 1
+    hdr[57] = 0
+    hdr[63] = 1 if xm else 0
+    hdr[100:128] = b'ACTUAL CART DATA STARTS HERE'
+    return bytes(hdr) + bytes(rom)
+
+if __name__ == '__main__':
+    out = sys.argv[1] if len(sys.argv) > 1 else '.'
+    if not os.path.isdir(out):
+        os.makedirs(out)
+    for kind in KINDS:
+        path = os.path.join(out, 'synth_%s.a78' % kind)
+        with open(path, 'wb') as f:
+            f.write(build(kind))